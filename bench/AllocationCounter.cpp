@@ -0,0 +1,47 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Relaxed atomics: the benchmarks run on one thread, but the code under test
+// may start others, and a count that is off by a race would be worse than
+// the nanosecond this costs.
+static std::atomic<uint64_t> allocationCount{ 0 };
+static std::atomic<uint64_t> allocatedBytes{ 0 };
+
+AllocationCounts getAllocationCounts() {
+    AllocationCounts counts;
+    counts.allocations = allocationCount.load(std::memory_order_relaxed);
+    counts.bytes = allocatedBytes.load(std::memory_order_relaxed);
+    return counts;
+}
+
+static void* allocate(std::size_t size, std::size_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    void* memory = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        memory = std::malloc(size);
+    } else {
+        // aligned_alloc wants a multiple of the alignment.
+        memory = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+// The array and nothrow forms forward to these two in libstdc++ and libc++,
+// so they are counted too.
+void* operator new(std::size_t size) { return allocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocate(size, (std::size_t)alignment); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts every heap allocation the program makes, through replacements of the
+// global operator new (AllocationCounter.cpp, which every benchmark links).
+// The harness reads the counts around each timed loop to report allocations
+// and allocated bytes per operation.
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+AllocationCounts getAllocationCounts();
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "AllocationCounter.h"
+
+// A minimal in-tree benchmark harness: no framework, just enough to compare
+// two implementations of the same operation on the same input, and to compare
+// one commit with another. Every benchmark reports time, heap allocations and
+// allocated bytes per operation. With --json=PATH the results are saved, and
+// with --baseline=PATH a saved run is shown next to the current one:
+//   ./parser_bench --json=before.json
+//   (change something, rebuild)
+//   ./parser_bench --baseline=before.json
+
+// Keeps the compiler from discarding a result that is otherwise unused.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#ifdef _MSC_VER
+    static const void* volatile sink;
+    sink = &value;
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+struct BenchmarkResult {
+    std::string name; // "group/name"
+    double nanosecondsPerOp = 0;
+    double allocationsPerOp = 0;
+    double allocatedBytesPerOp = 0;
+    size_t bytesPerOp = 0; // Input processed per op, for MB/s; 0 if not meaningful
+    size_t iterations = 0;
+};
+
+struct BenchmarkSession {
+    std::string group;
+    std::string jsonPath;
+    double minSeconds = 0; // --min-time; 0 keeps each benchmark's own
+    std::map<std::string, BenchmarkResult> baseline;
+    std::vector<BenchmarkResult> results;
+};
+
+inline BenchmarkSession& getBenchmarkSession() {
+    static BenchmarkSession session;
+    return session;
+}
+
+// Reads a file written by writeBenchmarkJson(): one benchmark object per line.
+inline bool loadBenchmarkBaseline(const std::string& path, std::map<std::string, BenchmarkResult>& baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    auto readNumber = [](const std::string& line, const char* key) {
+        size_t position = line.find(key);
+        return position == std::string::npos ? 0.0 : std::strtod(line.c_str() + position + std::strlen(key), nullptr);
+    };
+    std::string line;
+    while (std::getline(in, line)) {
+        const std::string nameKey = "\"name\": \"";
+        size_t start = line.find(nameKey);
+        if (start == std::string::npos) {
+            continue;
+        }
+        start += nameKey.length();
+        BenchmarkResult result;
+        for (size_t i = start; i < line.length() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.length()) {
+                i++;
+            }
+            result.name += line[i];
+        }
+        result.nanosecondsPerOp = readNumber(line, "\"ns_per_op\": ");
+        result.allocationsPerOp = readNumber(line, "\"allocs_per_op\": ");
+        result.allocatedBytesPerOp = readNumber(line, "\"alloc_bytes_per_op\": ");
+        baseline[result.name] = result;
+    }
+    return true;
+}
+
+// Handles the options every benchmark executable takes. False (with the
+// usage printed) if one is not understood.
+inline bool parseBenchmarkOptions(int argc, char* argv[]) {
+    BenchmarkSession& session = getBenchmarkSession();
+    const std::string jsonOption = "--json=";
+    const std::string baselineOption = "--baseline=";
+    const std::string minTimeOption = "--min-time=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind(jsonOption, 0) == 0) {
+            // Absolute, in case the benchmark changes directory.
+            session.jsonPath = std::filesystem::absolute(arg.substr(jsonOption.length())).string();
+        } else if (arg.rfind(baselineOption, 0) == 0) {
+            if (!loadBenchmarkBaseline(arg.substr(baselineOption.length()), session.baseline)) {
+                std::cout << "Cannot read " << arg.substr(baselineOption.length()) << std::endl;
+                return false;
+            }
+        } else if (arg.rfind(minTimeOption, 0) == 0) {
+            session.minSeconds = std::atof(arg.c_str() + minTimeOption.length());
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--json=PATH] [--baseline=PATH] [--min-time=SECONDS]" << std::endl
+                      << "  --json saves the results; --baseline shows the change from results saved earlier." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Starts a titled section; results are named "title/name" in the JSON.
+inline void beginBenchmarkGroup(const std::string& title) {
+    getBenchmarkSession().group = title;
+    std::cout << "--- " << title << " ---" << std::endl;
+}
+
+inline std::string escapeBenchmarkJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+// Writes the session's results to --json, if given. One benchmark per line,
+// so two runs can also be compared with diff.
+inline bool writeBenchmarkJson() {
+    const BenchmarkSession& session = getBenchmarkSession();
+    if (session.jsonPath.empty()) {
+        return true;
+    }
+    std::ofstream out(session.jsonPath);
+    if (!out) {
+        std::cout << "Cannot write " << session.jsonPath << std::endl;
+        return false;
+    }
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+#ifdef __VERSION__
+    const char* compiler = __VERSION__;
+#else
+    const char* compiler = "unknown";
+#endif
+    out << "{\n  \"context\": {\"date\": \"" << date << "\", \"compiler\": \"" << escapeBenchmarkJson(compiler) << "\"},\n"
+        << "  \"benchmarks\": [\n";
+    out << std::fixed;
+    for (size_t i = 0; i < session.results.size(); i++) {
+        const BenchmarkResult& result = session.results[i];
+        out << "    {\"name\": \"" << escapeBenchmarkJson(result.name) << "\", \"iterations\": " << result.iterations
+            << std::setprecision(2) << ", \"ns_per_op\": " << result.nanosecondsPerOp
+            << ", \"allocs_per_op\": " << result.allocationsPerOp
+            << ", \"alloc_bytes_per_op\": " << result.allocatedBytesPerOp
+            << ", \"bytes_per_op\": " << result.bytesPerOp << "}" << (i + 1 < session.results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    std::cout << "Results written to " << session.jsonPath << std::endl;
+    return true;
+}
+
+// Runs op until at least minSeconds have passed (and at least once), then
+// prints the mean time, allocations and allocated bytes per call, the
+// throughput if bytesPerOp is set, and the change from the baseline if one
+// was loaded.
+template <typename Op>
+BenchmarkResult runBenchmark(const std::string& name, size_t bytesPerOp, Op op, double minSeconds = 0.5) {
+    using Clock = std::chrono::steady_clock;
+    BenchmarkSession& session = getBenchmarkSession();
+    if (session.minSeconds > 0) {
+        minSeconds = session.minSeconds;
+    }
+
+    op(); // Warm-up: page in buffers and let allocations settle.
+
+    BenchmarkResult result;
+    result.name = session.group.empty() ? name : session.group + "/" + name;
+    result.bytesPerOp = bytesPerOp;
+    AllocationCounts allocationsBefore = getAllocationCounts();
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        op();
+        result.iterations++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    AllocationCounts allocationsAfter = getAllocationCounts();
+
+    result.nanosecondsPerOp = elapsed * 1e9 / result.iterations;
+    result.allocationsPerOp = (double)(allocationsAfter.allocations - allocationsBefore.allocations) / result.iterations;
+    result.allocatedBytesPerOp = (double)(allocationsAfter.bytes - allocationsBefore.bytes) / result.iterations;
+
+    std::cout << std::left << std::setw(40) << name << std::right
+              << std::setw(14) << std::fixed << std::setprecision(0) << result.nanosecondsPerOp << " ns/op"
+              << std::setw(10) << std::setprecision(1) << result.allocationsPerOp << " allocs/op"
+              << std::setw(10) << std::setprecision(0) << result.allocatedBytesPerOp << " B/op";
+    if (bytesPerOp > 0) {
+        double megabytesPerSecond = bytesPerOp / (result.nanosecondsPerOp / 1e9) / (1024.0 * 1024.0);
+        std::cout << std::setw(12) << std::setprecision(1) << megabytesPerSecond << " MB/s";
+    }
+    std::cout << std::setw(10) << result.iterations << " iterations";
+
+    auto baseline = session.baseline.find(result.name);
+    if (baseline != session.baseline.end() && baseline->second.nanosecondsPerOp > 0) {
+        double change = (result.nanosecondsPerOp / baseline->second.nanosecondsPerOp - 1.0) * 100.0;
+        std::cout << std::showpos << std::setw(9) << std::setprecision(1) << change << "%" << std::noshowpos;
+        if (result.allocationsPerOp != baseline->second.allocationsPerOp) {
+            std::cout << " (allocs " << std::setprecision(1) << baseline->second.allocationsPerOp << " -> "
+                      << result.allocationsPerOp << ")";
+        }
+    }
+    std::cout << std::endl;
+
+    session.results.push_back(result);
+    return result;
+}
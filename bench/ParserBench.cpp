@@ -0,0 +1,126 @@
+// Compares the resumable HttpRequest parser with the original whole-buffer
+// parser. Each request arrives in RECEIVE_BUFFER_SIZE chunks, the way
+// SocketManager::receiveData() appends to messageData, and the parser is
+// called after every chunk. Header-heavy requests are also parsed with each
+// scanning kernel level (scalar, SSE4.2, AVX2) the CPU supports.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -o parser_bench bench/ParserBench.cpp bench/AllocationCounter.cpp server/http/HttpRequest.cpp server/http/HttpScan.cpp
+
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "LegacyHttpRequest.h"
+#include "../server/http/HttpRequest.h"
+#include "../server/http/HttpScan.h"
+
+static const size_t CHUNK_SIZE = 16 * 1024; // SocketManager's RECEIVE_BUFFER_SIZE
+
+static std::string makeRequest(size_t totalSize) {
+    std::string headers =
+        "PUT /file/bench.txt?overwrite=1 HTTP/1.1\r\n"
+        "Host: localhost:8080\r\n"
+        "User-Agent: parser-bench/1.0\r\n"
+        "Accept: */*\r\n"
+        "Content-Type: application/octet-stream\r\n";
+    size_t bodySize = totalSize > headers.size() + 64 ? totalSize - headers.size() - 64 : 0;
+    headers += "Content-Length: " + std::to_string(bodySize) + "\r\n\r\n";
+    return headers + std::string(bodySize, 'x');
+}
+
+// A browser-style GET behind a chain of proxies: many X-Forwarded-* headers
+// and a cookie of the given size.
+static std::string makeHeaderHeavyRequest(size_t cookieSize) {
+    std::string request =
+        "GET /home?lang=en HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/126.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: en-US,en;q=0.9,he;q=0.8,fr;q=0.7\r\n";
+    for (int hop = 0; hop < 8; hop++) {
+        std::string address = "10.0." + std::to_string(hop) + "." + std::to_string(100 + hop);
+        request += "X-Forwarded-For: 203.0.113.7, " + address + "\r\n";
+        request += "X-Forwarded-Proto: https\r\n";
+        request += "Via: 1.1 proxy-" + std::to_string(hop) + ".example.net\r\n";
+    }
+    std::string cookie = "Cookie: ";
+    for (size_t i = 0; cookie.size() < cookieSize; i++) {
+        cookie += "session_" + std::to_string(i) + "=a3f9c2e17b5d4c08e6f1a2b3c4d5e6f7; ";
+    }
+    request += cookie + "\r\n\r\n";
+    return request;
+}
+
+template <typename Parser>
+static void parseInChunks(const std::string& request, std::string& buffer, Parser& parser) {
+    buffer.clear();
+    parser.clear();
+    ParseResult result = ParseResult::Incomplete;
+    for (size_t offset = 0; offset < request.size(); offset += CHUNK_SIZE) {
+        size_t length = request.size() - offset < CHUNK_SIZE ? request.size() - offset : CHUNK_SIZE;
+        buffer.append(request, offset, length);
+        result = parser.parse(buffer);
+    }
+    if (result != ParseResult::Success) {
+        std::cout << "Parse failed" << std::endl;
+    }
+    doNotOptimize(parser.getBody().size());
+}
+
+int main(int argc, char* argv[]) {
+    if (!parseBenchmarkOptions(argc, argv)) {
+        return 1;
+    }
+
+    const std::vector<std::pair<const char*, size_t>> sizes = {
+        {"1 KB", 1024},
+        {"64 KB", 64 * 1024},
+        {"16 MB", 16 * 1024 * 1024}
+    };
+
+    for (const auto& size : sizes) {
+        std::string request = makeRequest(size.second);
+        std::string buffer;
+        buffer.reserve(request.size());
+
+        HttpRequest resumable;
+        LegacyHttpRequest legacy;
+
+        beginBenchmarkGroup(std::string(size.first) + " request, " + std::to_string(CHUNK_SIZE / 1024) + " KB chunks");
+        BenchmarkResult incremental = runBenchmark("resumable parser", request.size(),
+            [&]() { parseInChunks(request, buffer, resumable); });
+        BenchmarkResult baseline = runBenchmark("original parser", request.size(),
+            [&]() { parseInChunks(request, buffer, legacy); });
+        std::cout << "speedup: " << std::setprecision(1) << baseline.nanosecondsPerOp / incremental.nanosecondsPerOp << "x" << std::endl << std::endl;
+    }
+
+    const ScanLevel defaultLevel = getScanLevel();
+    const std::vector<std::pair<const char*, size_t>> cookieSizes = {
+        {"header-heavy, 256 B cookie", 256},
+        {"header-heavy, 4 KB cookie", 4 * 1024},
+        {"header-heavy, 16 KB cookie", 16 * 1024}
+    };
+
+    for (const auto& size : cookieSizes) {
+        std::string request = makeHeaderHeavyRequest(size.second);
+        std::string buffer;
+        buffer.reserve(request.size());
+
+        HttpRequest resumable;
+        LegacyHttpRequest legacy;
+
+        beginBenchmarkGroup(std::string(size.first) + ", " + std::to_string(request.size()) + " bytes");
+        for (ScanLevel level : {ScanLevel::Scalar, ScanLevel::Sse42, ScanLevel::Avx2}) {
+            if (!setScanLevel(level)) {
+                continue;
+            }
+            runBenchmark(std::string("resumable parser, ") + scanLevelToString(level), request.size(),
+                [&]() { parseInChunks(request, buffer, resumable); });
+        }
+        setScanLevel(defaultLevel);
+        runBenchmark("original parser", request.size(), [&]() { parseInChunks(request, buffer, legacy); });
+        std::cout << std::endl;
+    }
+    return writeBenchmarkJson() ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+// Compares the compiled route trie with the route table it replaced: a
+// std::map from path to a std::map from method to endpoint, behind a
+// hand-written check for the "/file/{name}.txt" pattern. Both are loaded with
+// the server's own routes and resolve the same mix of request paths. The last
+// case routes a parsed request the way the reactor does, where the old code
+// also copied the whole HttpRequest to rewrite HEAD as GET.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -o router_bench bench/RouterBench.cpp bench/AllocationCounter.cpp server/http/Router.cpp server/http/HttpRequest.cpp server/http/HttpScan.cpp
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "../server/http/Router.h"
+
+class NullEndpoint final : public IEndpoint {
+public:
+    HttpResponse handle(const HttpRequest&) override { return HttpResponse(HttpStatusCode::Ok); }
+    std::string getDescription() const override { return ""; }
+};
+
+// The lookup the server used before the Router.
+class LegacyRouter {
+public:
+    void add(const std::string& path, HttpMethod method, IEndpoint* endpoint) { m_routes[path][method] = endpoint; }
+
+    IEndpoint* find(HttpMethod method, std::string_view path) const {
+        const std::string_view fileRoutePrefix = "/file/";
+        if (path.compare(0, fileRoutePrefix.length(), fileRoutePrefix) == 0) {
+            if (path.find('/', fileRoutePrefix.length()) != std::string_view::npos ||
+                (path.length() < 5 || path.substr(path.length() - 4) != ".txt")) {
+                return nullptr;
+            }
+            path = fileRoutePrefix;
+        }
+        auto route = m_routes.find(path);
+        if (route != m_routes.end()) {
+            auto handler = route->second.find(method);
+            if (handler != route->second.end()) {
+                return handler->second;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    std::map<std::string, std::map<HttpMethod, IEndpoint*>, std::less<>> m_routes;
+};
+
+static const int REPEAT = 1000;
+
+struct Lookup {
+    HttpMethod method;
+    std::string_view path;
+};
+
+int main(int argc, char* argv[]) {
+    if (!parseBenchmarkOptions(argc, argv)) {
+        return 1;
+    }
+
+    NullEndpoint endpoint;
+    const std::vector<std::pair<const char*, std::vector<HttpMethod>>> routes = {
+        {"/home", {HttpMethod::GET, HttpMethod::OPTIONS}},
+        {"/postmessage", {HttpMethod::POST, HttpMethod::OPTIONS}},
+        {"/trace", {HttpMethod::TRACE, HttpMethod::OPTIONS}},
+        {"/metrics", {HttpMethod::GET, HttpMethod::OPTIONS}}
+    };
+    const std::vector<HttpMethod> fileMethods = {HttpMethod::GET, HttpMethod::PUT, HttpMethod::DELETE_0, HttpMethod::OPTIONS};
+
+    Router router;
+    LegacyRouter legacy;
+    for (const auto& route : routes) {
+        for (HttpMethod method : route.second) {
+            router.add(route.first, method, &endpoint);
+            legacy.add(route.first, method, &endpoint);
+        }
+    }
+    for (HttpMethod method : fileMethods) {
+        router.add("/file/{name}.txt", method, &endpoint);
+        legacy.add("/file/", method, &endpoint);
+    }
+    router.compile();
+
+    const std::vector<std::pair<const char*, std::vector<Lookup>>> mixes = {
+        {"/home", {{HttpMethod::GET, "/home"}}},
+        {"/file/{name}.txt", {{HttpMethod::GET, "/file/quarterly-report-2024.txt"}}},
+        {"miss", {{HttpMethod::GET, "/favicon.ico"}}},
+        {"mix of 8", {
+            {HttpMethod::GET, "/home"},
+            {HttpMethod::GET, "/file/a.txt"},
+            {HttpMethod::PUT, "/file/upload-0001.txt"},
+            {HttpMethod::POST, "/postmessage"},
+            {HttpMethod::GET, "/metrics"},
+            {HttpMethod::OPTIONS, "/trace"},
+            {HttpMethod::GET, "/file/nested/a.txt"},
+            {HttpMethod::DELETE_0, "/home"}
+        }}
+    };
+
+    for (const auto& mix : mixes) {
+        for (const Lookup& lookup : mix.second) {
+            if (router.find(lookup.method, lookup.path) != legacy.find(lookup.method, lookup.path)) {
+                std::cout << "Routers disagree on " << lookup.path << std::endl;
+                return 1;
+            }
+        }
+
+        // Each op resolves the mix many times over, so reading the clock does not dominate.
+        const double count = (double)mix.second.size() * REPEAT;
+        beginBenchmarkGroup(mix.first);
+        BenchmarkResult compiled = runBenchmark("route trie", 0, [&]() {
+            for (int i = 0; i < REPEAT; i++) {
+                for (const Lookup& lookup : mix.second) {
+                    doNotOptimize(router.find(lookup.method, lookup.path));
+                }
+            }
+        });
+        BenchmarkResult baseline = runBenchmark("nested std::map", 0, [&]() {
+            for (int i = 0; i < REPEAT; i++) {
+                for (const Lookup& lookup : mix.second) {
+                    doNotOptimize(legacy.find(lookup.method, lookup.path));
+                }
+            }
+        });
+        std::cout << "per lookup: " << std::setprecision(1) << compiled.nanosecondsPerOp / count << " ns vs "
+                  << baseline.nanosecondsPerOp / count << " ns, speedup "
+                  << baseline.nanosecondsPerOp / compiled.nanosecondsPerOp << "x" << std::endl << std::endl;
+    }
+
+    const std::string rawRequest =
+        "HEAD /file/quarterly-report-2024.txt HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: router-bench/1.0\r\n"
+        "Accept: */*\r\n\r\n";
+    HttpRequest request;
+    if (request.parse(rawRequest) != ParseResult::Success) {
+        std::cout << "Parse failed" << std::endl;
+        return 1;
+    }
+
+    beginBenchmarkGroup("HEAD request, as the reactor routes it");
+    std::cout << "(a " << sizeof(HttpRequest) << "-byte HttpRequest)" << std::endl;
+    BenchmarkResult compiled = runBenchmark("route trie", 0, [&]() {
+        for (int i = 0; i < REPEAT; i++) {
+            HttpMethod method = request.getMethod();
+            doNotOptimize(router.find(method == HttpMethod::HEAD ? HttpMethod::GET : method, request.getPath()));
+        }
+    });
+    BenchmarkResult baseline = runBenchmark("copy + nested std::map", 0, [&]() {
+        for (int i = 0; i < REPEAT; i++) {
+            HttpRequest routingRequest = request;
+            if (routingRequest.getMethod() == HttpMethod::HEAD) {
+                routingRequest.setMethod(HttpMethod::GET);
+            }
+            doNotOptimize(routingRequest); // The server handed the copy to a separate function, so it was made.
+            doNotOptimize(legacy.find(routingRequest.getMethod(), routingRequest.getPath()));
+        }
+    });
+    std::cout << "per request: " << std::setprecision(1) << compiled.nanosecondsPerOp / REPEAT << " ns vs "
+              << baseline.nanosecondsPerOp / REPEAT << " ns, speedup "
+              << baseline.nanosecondsPerOp / compiled.nanosecondsPerOp << "x" << std::endl;
+    return writeBenchmarkJson() ? 0 : 1;
+}
@@ -0,0 +1,388 @@
+// The CPU-bound steps of a request's path through the server, each timed on
+// its own with the allocations it makes:
+//   - HttpRequest::parse on a corpus of realistic requests, each in one read;
+//   - HttpResponse::serializeHeaders, which replaced toString(): the reactor
+//     appends the headers to a reused buffer and sends the body from its own;
+//   - Router::find over the server's route table, as Reactor::findHandler
+//     calls it (the old findEndpoint);
+//   - every endpoint's handle(), or its body sink for PUT;
+//   - a streamed body (IBodySource), drained in the server's 64 KB pieces.
+// The file endpoints touch the disk, in a scratch directory of their own, so
+// their numbers include system calls. Save a run with --json and compare a
+// later one with --baseline (see Benchmark.h).
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -o server_bench bench/ServerBench.cpp bench/AllocationCounter.cpp server/http/*.cpp
+//       server/Metrics.cpp server/AccessLog.cpp server/RequestTrace.cpp server/TimerWheel.cpp -lz -lbrotlienc
+
+#include <filesystem>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "Benchmark.h"
+#include "../server/AccessLog.h"
+#include "../server/Metrics.h"
+#include "../server/http/Endpoints.h"
+#include "../server/http/FileCache.h"
+#include "../server/http/Router.h"
+
+static const std::string_view DATE_LINE = "Date: Sat, 17 Oct 2026 04:00:00 GMT\r\n";
+static const int ROUTER_REPEAT = 100;
+
+// A request parsed from a buffer it keeps, since the request's views point there.
+struct ParsedRequest {
+    explicit ParsedRequest(std::string raw) : buffer(std::move(raw)) {
+        if (request.parse(buffer) != ParseResult::Success) {
+            std::cout << "Parse failed: " << buffer.substr(0, buffer.find('\r')) << std::endl;
+            std::exit(1);
+        }
+    }
+    ParsedRequest(const ParsedRequest&) = delete;
+    ParsedRequest& operator=(const ParsedRequest&) = delete;
+
+    std::string buffer;
+    HttpRequest request;
+};
+
+// The endpoints read and write files/ under the working directory, so the
+// benchmark moves to a scratch directory and removes it afterwards.
+class ScratchDirectory {
+public:
+    ScratchDirectory()
+        : m_previous(std::filesystem::current_path()),
+          m_path(std::filesystem::temp_directory_path() / ("server_bench." + std::to_string(getpid()))) {
+        std::filesystem::create_directories(m_path / "files");
+        std::filesystem::current_path(m_path);
+    }
+    ~ScratchDirectory() {
+        std::error_code error;
+        std::filesystem::current_path(m_previous, error);
+        std::filesystem::remove_all(m_path, error);
+    }
+
+private:
+    std::filesystem::path m_previous;
+    std::filesystem::path m_path;
+};
+
+// Swallows what PostMessageEndpoint prints, so the benchmark times the
+// endpoint rather than the terminal.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+static std::string makeBody(size_t size) {
+    std::string body(size, 'x');
+    for (size_t i = 63; i < size; i += 64) {
+        body[i] = '\n';
+    }
+    return body;
+}
+
+static std::string makePut(const std::string& target, const std::string& body) {
+    return "PUT " + target + " HTTP/1.1\r\n"
+           "Host: localhost:8080\r\n"
+           "User-Agent: curl/8.5.0\r\n"
+           "Accept: */*\r\n"
+           "Content-Type: text/plain\r\n"
+           "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+// Streams the body through the endpoint's sink, as the reactor does for PUT.
+static HttpResponse upload(IEndpoint& endpoint, const HttpRequest& request) {
+    HttpResponse refusal;
+    std::unique_ptr<IBodySink> sink = endpoint.openBodySink(request, refusal);
+    if (!sink || !sink->write(request.getBody())) {
+        return refusal;
+    }
+    return sink->finish(request);
+}
+
+// One "name size" line per file in a directory, read as the body is drained.
+// The server has no streaming route, so this stands in for one.
+class DirectoryListingSource final : public IBodySource {
+public:
+    explicit DirectoryListingSource(const std::string& directory)
+        : m_iterator(directory, m_error) {}
+
+    BodySourceResult read(std::string& out, size_t maxBytes) override {
+        size_t start = out.length();
+        for (; !m_error && m_iterator != std::filesystem::directory_iterator(); m_iterator.increment(m_error)) {
+            const std::filesystem::directory_entry& entry = *m_iterator;
+            std::string name = entry.path().filename().string();
+            std::error_code entryError;
+            uintmax_t size = entry.file_size(entryError);
+            if (entryError || !entry.is_regular_file(entryError) ||
+                (name.size() > 7 && name.compare(name.size() - 7, 7, ".upload") == 0)) {
+                continue; // Unreadable entries, and uploads still in progress
+            }
+            std::string line = name + " " + std::to_string(size) + "\n";
+            if (out.length() - start + line.length() > maxBytes) {
+                if (out.length() == start) {
+                    continue; // A line that could never fit
+                }
+                return BodySourceResult::More;
+            }
+            out.append(line);
+        }
+        return m_error ? BodySourceResult::Error : BodySourceResult::Done;
+    }
+
+private:
+    std::error_code m_error;
+    std::filesystem::directory_iterator m_iterator;
+};
+
+static void drainBody(const HttpResponse& response, std::string& out) {
+    out.clear();
+    if (response.getBodySource()) {
+        while (response.getBodySource()->read(out, 64 * 1024) == BodySourceResult::More) {
+        }
+    }
+}
+
+static void benchmarkParser() {
+    const std::vector<std::pair<const char*, std::string>> corpus = {
+        {"curl GET", "GET /home?lang=fr HTTP/1.1\r\n"
+                     "Host: localhost:8080\r\n"
+                     "User-Agent: curl/8.5.0\r\n"
+                     "Accept: */*\r\n\r\n"},
+        {"browser GET, revalidating",
+         "GET /file/quarterly-report-2024.txt HTTP/1.1\r\n"
+         "Host: www.example.com\r\n"
+         "Connection: keep-alive\r\n"
+         "sec-ch-ua: \"Chromium\";v=\"126\", \"Google Chrome\";v=\"126\", \"Not-A.Brand\";v=\"8\"\r\n"
+         "sec-ch-ua-mobile: ?0\r\n"
+         "sec-ch-ua-platform: \"Linux\"\r\n"
+         "Upgrade-Insecure-Requests: 1\r\n"
+         "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/126.0 Safari/537.36\r\n"
+         "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+         "Sec-Fetch-Site: same-origin\r\n"
+         "Sec-Fetch-Mode: navigate\r\n"
+         "Sec-Fetch-Dest: document\r\n"
+         "Referer: https://www.example.com/files\r\n"
+         "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+         "Accept-Language: en-US,en;q=0.9,he;q=0.8\r\n"
+         "Cookie: session=a3f9c2e17b5d4c08e6f1a2b3c4d5e6f7; theme=dark; consent=1\r\n"
+         "If-None-Match: \"1a2b3c-65f0e1d2-400\"\r\n"
+         "If-Modified-Since: Fri, 16 Oct 2026 09:30:00 GMT\r\n\r\n"},
+        {"CORS preflight", "OPTIONS /file/a.txt HTTP/1.1\r\n"
+                           "Host: api.example.com\r\n"
+                           "Origin: https://www.example.com\r\n"
+                           "Access-Control-Request-Method: PUT\r\n"
+                           "Access-Control-Request-Headers: content-type\r\n"
+                           "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/126.0 Safari/537.36\r\n"
+                           "Accept: */*\r\n\r\n"},
+        {"POST form", "POST /postmessage HTTP/1.1\r\n"
+                      "Host: localhost:8080\r\n"
+                      "User-Agent: python-requests/2.31.0\r\n"
+                      "Accept: */*\r\n"
+                      "Content-Type: application/x-www-form-urlencoded\r\n"
+                      "Content-Length: 61\r\n\r\n"
+                      "name=Ada+Lovelace&message=Hello%2C+server%21&reply=no&page=12"},
+        {"PUT, 4 KB body", makePut("/file/upload.txt", makeBody(4096))},
+    };
+
+    beginBenchmarkGroup("parse, one request per read");
+    HttpRequest request;
+    for (const auto& entry : corpus) {
+        runBenchmark(entry.first, entry.second.size(), [&]() {
+            request.clear();
+            doNotOptimize(request.parse(entry.second));
+        });
+    }
+
+    // Requests pipelined in one read, each parsed from where the last one
+    // ended, as the reactor walks them.
+    std::string pipelined;
+    for (int i = 0; i < 8; i++) {
+        pipelined += corpus[i % 2].second;
+    }
+    runBenchmark("8 pipelined GETs", pipelined.size(), [&]() {
+        size_t start = 0;
+        while (start < pipelined.size()) {
+            request.clear(start);
+            if (request.parse(pipelined) != ParseResult::Success) {
+                break;
+            }
+            start += request.getConsumedBytes();
+        }
+        doNotOptimize(start);
+    });
+    std::cout << std::endl;
+}
+
+static void benchmarkSerializer(HomeEndpoint& home, GetFileEndpoint& getFile) {
+    ParsedRequest homeRequest("GET /home?lang=fr HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ParsedRequest fileRequest("GET /file/bench-0.txt HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    const HttpResponse homePage = home.handle(homeRequest.request);
+    const HttpResponse file = getFile.handle(fileRequest.request);
+
+    HttpResponse custom(HttpStatusCode::Ok, "{\"status\":\"ok\"}");
+    custom.addHeader("Content-Type", "application/json");
+    custom.addHeader("Cache-Control", "no-store");
+    custom.addHeader("Set-Cookie", "session=a3f9c2e17b5d4c08e6f1a2b3c4d5e6f7; Path=/; HttpOnly");
+    custom.addHeader("X-Request-Id", "6f1a2b3c-4d5e-6f70-8192-a3b4c5d6e7f8");
+    custom.addHeader("Access-Control-Allow-Origin", "https://www.example.com");
+    custom.addHeader("Vary", "Origin");
+    custom.addHeader("X-Content-Type-Options", "nosniff");
+    custom.addHeader("Strict-Transport-Security", "max-age=31536000");
+
+    beginBenchmarkGroup("serialize headers");
+    std::string out;
+    runBenchmark("home page", 0, [&]() {
+        out.clear();
+        homePage.serializeHeaders(out, DATE_LINE);
+        doNotOptimize(out.size());
+    });
+    runBenchmark("file, pre-rendered headers", 0, [&]() {
+        out.clear();
+        file.serializeHeaders(out, DATE_LINE);
+        doNotOptimize(out.size());
+    });
+    runBenchmark("8 custom headers", 0, [&]() {
+        out.clear();
+        custom.serializeHeaders(out, DATE_LINE);
+        doNotOptimize(out.size());
+    });
+    runBenchmark("404, built and serialized", 0, [&]() {
+        HttpResponse response(HttpStatusCode::NotFound, "File not found.");
+        out.clear();
+        response.serializeHeaders(out, DATE_LINE);
+        doNotOptimize(out.size());
+    });
+    std::cout << std::endl;
+}
+
+static void benchmarkRouter(const Router& router) {
+    std::unique_ptr<ParsedRequest> mix[] = {
+        std::make_unique<ParsedRequest>("GET /home?lang=he HTTP/1.1\r\nHost: a\r\n\r\n"),
+        std::make_unique<ParsedRequest>("HEAD /file/quarterly-report-2024.txt HTTP/1.1\r\nHost: a\r\n\r\n"),
+        std::make_unique<ParsedRequest>("GET /file/a.txt HTTP/1.1\r\nHost: a\r\n\r\n"),
+        std::make_unique<ParsedRequest>("PUT /file/upload-0001.txt HTTP/1.1\r\nHost: a\r\nContent-Length: 0\r\n\r\n"),
+        std::make_unique<ParsedRequest>("POST /postmessage HTTP/1.1\r\nHost: a\r\nContent-Length: 0\r\n\r\n"),
+        std::make_unique<ParsedRequest>("GET /metrics HTTP/1.1\r\nHost: a\r\n\r\n"),
+        std::make_unique<ParsedRequest>("OPTIONS /trace HTTP/1.1\r\nHost: a\r\n\r\n"),
+        std::make_unique<ParsedRequest>("GET /favicon.ico HTTP/1.1\r\nHost: a\r\n\r\n"),
+    };
+
+    beginBenchmarkGroup("route, server table");
+    runBenchmark("mix of 8, x" + std::to_string(ROUTER_REPEAT), 0, [&]() {
+        for (int i = 0; i < ROUTER_REPEAT; i++) {
+            for (const std::unique_ptr<ParsedRequest>& parsed : mix) {
+                HttpMethod method = parsed->request.getMethod();
+                int route = -1;
+                doNotOptimize(router.find(method == HttpMethod::HEAD ? HttpMethod::GET : method, parsed->request.getPath(), &route));
+                doNotOptimize(route);
+            }
+        }
+    });
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (!parseBenchmarkOptions(argc, argv)) {
+        return 1;
+    }
+    ScratchDirectory scratch;
+
+    const int FILE_COUNT = 16;
+    const std::string fileBody = makeBody(4096);
+    FileCache fileCache(DEFAULT_FILE_CACHE_BYTES);
+    FileCache noCache(0);
+    AccessLog accessLog("", 1, 1, DEFAULT_ACCESS_LOG_MAX_BYTES);
+    Metrics metrics(1, fileCache, accessLog);
+
+    HomeEndpoint home;
+    PostMessageEndpoint postMessage;
+    TraceEndpoint trace;
+    PutFileEndpoint putFile(fileCache);
+    GetFileEndpoint getFile(fileCache);
+    GetFileEndpoint getUncachedFile(noCache);
+    DeleteFileEndpoint deleteFile(fileCache);
+    MetricsEndpoint metricsEndpoint(metrics);
+    OptionsEndpoint fileOptions({
+        {HttpMethod::GET, getFile.getDescription()},
+        {HttpMethod::PUT, putFile.getDescription()},
+        {HttpMethod::DELETE_0, deleteFile.getDescription()}
+    });
+
+    // The reactor's route table; here every OPTIONS route shares one endpoint.
+    Router router;
+    router.add("/home", HttpMethod::GET, &home);
+    router.add("/home", HttpMethod::OPTIONS, &fileOptions);
+    router.add("/postmessage", HttpMethod::POST, &postMessage);
+    router.add("/postmessage", HttpMethod::OPTIONS, &fileOptions);
+    router.add("/trace", HttpMethod::TRACE, &trace);
+    router.add("/trace", HttpMethod::OPTIONS, &fileOptions);
+    router.add("/file/{name}.txt", HttpMethod::GET, &getFile);
+    router.add("/file/{name}.txt", HttpMethod::PUT, &putFile);
+    router.add("/file/{name}.txt", HttpMethod::DELETE_0, &deleteFile);
+    router.add("/file/{name}.txt", HttpMethod::OPTIONS, &fileOptions);
+    router.add("/metrics", HttpMethod::GET, &metricsEndpoint);
+    router.add("/metrics", HttpMethod::OPTIONS, &fileOptions);
+    router.compile();
+
+    // Something for /metrics to render: every route with a spread of latencies.
+    ReactorMetrics& reactorMetrics = metrics.attach(0, router);
+    for (int route = -1; route < (int)router.getRouteCount(); route++) {
+        for (uint64_t i = 1; i <= 1000; i++) {
+            reactorMetrics.recordRequest(route, i % 50 == 0 ? HttpStatusCode::NotFound : HttpStatusCode::Ok, i * 100, i * 2000, i * 2500);
+        }
+    }
+
+    for (int i = 0; i < FILE_COUNT; i++) {
+        ParsedRequest put(makePut("/file/bench-" + std::to_string(i) + ".txt", fileBody));
+        upload(putFile, put.request);
+    }
+
+    benchmarkParser();
+    benchmarkSerializer(home, getFile);
+    benchmarkRouter(router);
+
+    ParsedRequest homeRequest("GET /home?lang=fr HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip, br\r\n\r\n");
+    ParsedRequest optionsRequest("OPTIONS /file/a.txt HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ParsedRequest traceRequest("TRACE /trace HTTP/1.1\r\nHost: localhost\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n");
+    ParsedRequest postRequest("POST /postmessage HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\nContent-Length: 13\r\n\r\nHello, server");
+    ParsedRequest getRequest("GET /file/bench-3.txt HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip, br\r\n\r\n");
+    ParsedRequest missingRequest("GET /file/missing.txt HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ParsedRequest putRequest(makePut("/file/scratch.txt", fileBody));
+    ParsedRequest deleteRequest("DELETE /file/scratch.txt HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ParsedRequest metricsRequest("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+    beginBenchmarkGroup("endpoint handle");
+    runBenchmark("home", 0, [&]() { doNotOptimize(home.handle(homeRequest.request)); });
+    runBenchmark("options", 0, [&]() { doNotOptimize(fileOptions.handle(optionsRequest.request)); });
+    runBenchmark("trace", 0, [&]() { doNotOptimize(trace.handle(traceRequest.request)); });
+    NullBuffer nullBuffer;
+    runBenchmark("post message, output discarded", 0, [&]() {
+        std::streambuf* console = std::cout.rdbuf(&nullBuffer);
+        doNotOptimize(postMessage.handle(postRequest.request));
+        std::cout.rdbuf(console);
+    });
+    runBenchmark("get file, 4 KB, cached", 0, [&]() { doNotOptimize(getFile.handle(getRequest.request)); });
+    runBenchmark("get file, 4 KB, no cache", 0, [&]() { doNotOptimize(getUncachedFile.handle(getRequest.request)); });
+    runBenchmark("get missing file", 0, [&]() { doNotOptimize(getFile.handle(missingRequest.request)); });
+    runBenchmark("put then delete file, 4 KB", 0, [&]() {
+        doNotOptimize(upload(putFile, putRequest.request));
+        doNotOptimize(deleteFile.handle(deleteRequest.request));
+    });
+    std::string listing;
+    runBenchmark("streamed listing of " + std::to_string(FILE_COUNT) + " files, body drained", 0, [&]() {
+        HttpResponse response(HttpStatusCode::Ok);
+        response.addHeader("Content-Type", "text/plain");
+        response.setBodySource(std::make_shared<DirectoryListingSource>("files"));
+        drainBody(response, listing);
+        doNotOptimize(listing.size());
+    });
+    runBenchmark("metrics, " + std::to_string(router.getRouteCount()) + " routes", 0, [&]() {
+        doNotOptimize(metricsEndpoint.handle(metricsRequest.request));
+    });
+    std::cout << std::endl;
+
+    return writeBenchmarkJson() ? 0 : 1;
+}
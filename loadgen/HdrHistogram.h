@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// A latency histogram in the manner of HdrHistogram: exact below 256 ns, then
+// 128 buckets per power of two, so every recorded value is kept to within
+// 0.8% up to 2^40 ns (about 18 minutes). Recording is a shift and an
+// increment, so it can sit on the load generator's hot path. Finer than the
+// server's LatencyHistogram (Metrics.h), which trades precision for memory
+// across every route.
+class HdrHistogram {
+public:
+    static constexpr int LINEAR_BITS = 8;
+    static constexpr int SUB_BUCKET_BITS = 7;
+    static constexpr int MAX_BITS = 40;
+    static constexpr int BUCKET_COUNT = (1 << LINEAR_BITS) + (MAX_BITS - LINEAR_BITS) * (1 << SUB_BUCKET_BITS);
+
+    HdrHistogram() : m_buckets(BUCKET_COUNT, 0) {}
+
+    void record(uint64_t value, uint64_t count = 1) {
+        m_buckets[getBucket(value)] += count;
+        m_count += count;
+        m_sum += (double)value * (double)count;
+        if (value > m_max) {
+            m_max = value;
+        }
+        if (value < m_min) {
+            m_min = value;
+        }
+    }
+
+    // Records value, plus the values a closed-loop client would have seen had
+    // it kept sending every expectedInterval while this request stalled it:
+    // value - interval, value - 2 * interval, ... down to the interval.
+    void recordCorrected(uint64_t value, uint64_t expectedInterval, uint64_t count = 1) {
+        record(value, count);
+        if (expectedInterval == 0 || value <= expectedInterval) {
+            return;
+        }
+        for (uint64_t missing = value - expectedInterval; missing >= expectedInterval; missing -= expectedInterval) {
+            record(missing, count);
+        }
+    }
+
+    // A copy with every recorded value corrected as by recordCorrected(), for
+    // when the expected interval is only known once the run is over.
+    HdrHistogram corrected(uint64_t expectedInterval) const {
+        HdrHistogram result;
+        for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+            if (m_buckets[bucket] != 0) {
+                result.recordCorrected(getLowest(bucket), expectedInterval, m_buckets[bucket]);
+            }
+        }
+        result.m_max = m_max > result.m_max ? m_max : result.m_max;
+        return result;
+    }
+
+    void reset() { *this = HdrHistogram(); }
+
+    static int getBucket(uint64_t value) {
+        if (value < (1u << LINEAR_BITS)) {
+            return (int)value;
+        }
+        int topBit = 63 - __builtin_clzll(value);
+        if (topBit >= MAX_BITS) {
+            return BUCKET_COUNT - 1;
+        }
+        int shift = topBit - SUB_BUCKET_BITS;
+        int subBucket = (int)(value >> shift) & ((1 << SUB_BUCKET_BITS) - 1);
+        return (1 << LINEAR_BITS) + (topBit - LINEAR_BITS) * (1 << SUB_BUCKET_BITS) + subBucket;
+    }
+
+    // The smallest value that lands in the bucket.
+    static uint64_t getLowest(int bucket) {
+        if (bucket < (1 << LINEAR_BITS)) {
+            return (uint64_t)bucket;
+        }
+        int octave = (bucket - (1 << LINEAR_BITS)) >> SUB_BUCKET_BITS;
+        int subBucket = (bucket - (1 << LINEAR_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+        return (uint64_t)((1 << SUB_BUCKET_BITS) + subBucket) << (octave + LINEAR_BITS - SUB_BUCKET_BITS);
+    }
+
+    // The largest value that lands in the bucket; what percentiles report,
+    // so a percentile is never understated.
+    static uint64_t getHighest(int bucket) {
+        if (bucket < (1 << LINEAR_BITS)) {
+            return (uint64_t)bucket;
+        }
+        int octave = (bucket - (1 << LINEAR_BITS)) >> SUB_BUCKET_BITS;
+        return getLowest(bucket) + ((uint64_t)1 << (octave + LINEAR_BITS - SUB_BUCKET_BITS)) - 1;
+    }
+
+    // The value at or below which percentile% of the recorded values fall.
+    uint64_t getPercentile(double percentile) const {
+        if (m_count == 0) {
+            return 0;
+        }
+        uint64_t target = (uint64_t)(percentile / 100.0 * (double)m_count + 0.5);
+        if (target < 1) {
+            target = 1;
+        }
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+            seen += m_buckets[bucket];
+            if (seen >= target) {
+                uint64_t value = getHighest(bucket);
+                return value < m_max ? value : m_max;
+            }
+        }
+        return m_max;
+    }
+
+    uint64_t getCount() const { return m_count; }
+    uint64_t getMax() const { return m_max; }
+    uint64_t getMin() const { return m_count == 0 ? 0 : m_min; }
+    double getMean() const { return m_count == 0 ? 0 : m_sum / (double)m_count; }
+
+    // The percentile distribution in HdrHistogram's .hgrm text format, values
+    // in milliseconds, which its plotter and wrk2's tooling read. Each halving
+    // of the distance to 100% gets ticksPerHalfDistance lines.
+    void writePercentiles(FILE* out, int ticksPerHalfDistance = 5) const {
+        std::fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+        if (m_count == 0) {
+            return;
+        }
+        double percentile = 0;
+        for (int halvings = 0; ; halvings++) {
+            double step = 50.0 / (double)(1ull << halvings) / ticksPerHalfDistance;
+            for (int tick = 0; tick < ticksPerHalfDistance; tick++, percentile += step) {
+                uint64_t value = getPercentile(percentile);
+                uint64_t below = countAtOrBelow(value);
+                double reached = 100.0 * (double)below / (double)m_count;
+                if (below == m_count) {
+                    std::fprintf(out, "%12.3f %2.12f %10llu\n", (double)m_max / 1e6, 1.0, (unsigned long long)m_count);
+                    writeSummary(out);
+                    return;
+                }
+                std::fprintf(out, "%12.3f %2.12f %10llu %14.2f\n", (double)value / 1e6, percentile / 100.0,
+                             (unsigned long long)below, 100.0 / (100.0 - reached));
+            }
+        }
+    }
+
+private:
+    uint64_t countAtOrBelow(uint64_t value) const {
+        uint64_t count = 0;
+        int last = getBucket(value);
+        for (int bucket = 0; bucket <= last; bucket++) {
+            count += m_buckets[bucket];
+        }
+        return count;
+    }
+
+    void writeSummary(FILE* out) const {
+        std::fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", getMean() / 1e6, getStdDeviation() / 1e6);
+        std::fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n", (double)m_max / 1e6, (unsigned long long)m_count);
+        std::fprintf(out, "#[Buckets = %12d, SubBuckets     = %12d]\n", MAX_BITS - LINEAR_BITS, 1 << SUB_BUCKET_BITS);
+    }
+
+    double getStdDeviation() const {
+        double mean = getMean();
+        double squares = 0;
+        for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+            if (m_buckets[bucket] != 0) {
+                double delta = (double)getLowest(bucket) - mean;
+                squares += delta * delta * (double)m_buckets[bucket];
+            }
+        }
+        return m_count == 0 ? 0 : std::sqrt(squares / (double)m_count);
+    }
+
+    std::vector<uint64_t> m_buckets;
+    uint64_t m_count = 0;
+    uint64_t m_max = 0;
+    uint64_t m_min = UINT64_MAX;
+    double m_sum = 0;
+};
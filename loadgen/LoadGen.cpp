@@ -0,0 +1,297 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <netdb.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "LoadGenerator.h"
+
+static void printUsage() {
+    std::cout << "Usage: loadgen [--host=ADDRESS] [--port=N] [--connections=N] [--depth=N] [--rate=N] [--duration=S] [--warmup=S]" << std::endl
+              << "               [--no-keep-alive] [--mix=KIND:WEIGHT,...] [--files=N] [--body-size=N] [--expected-interval-us=N]" << std::endl
+              << "               [--hdr-out=PATH] [--seed=N]" << std::endl
+              << "  --rate=N sends N requests per second in total, whatever the server does (open loop); without it," << std::endl
+              << "  every connection keeps --depth requests in flight (closed loop, default depth 1)." << std::endl
+              << "  --mix weights the kinds home, get, put, delete and post (default " << RequestMix::DEFAULT_SPEC << ")." << std::endl
+              << "  --files=N GETs read N files of --body-size bytes, created before the run (default 16 of 1024)." << std::endl
+              << "  --expected-interval-us sets the interval between requests on each of a connection's --depth in-flight" << std::endl
+              << "  slots that the closed-loop correction assumes (default: measured)." << std::endl
+              << "  --hdr-out writes the corrected latency distribution in HdrHistogram's .hgrm format." << std::endl;
+}
+
+static bool parseArguments(int argc, char* argv[], LoadConfig& config) {
+    const std::string hostOption = "--host=";
+    const std::string portOption = "--port=";
+    const std::string connectionsOption = "--connections=";
+    const std::string depthOption = "--depth=";
+    const std::string rateOption = "--rate=";
+    const std::string durationOption = "--duration=";
+    const std::string warmupOption = "--warmup=";
+    const std::string mixOption = "--mix=";
+    const std::string filesOption = "--files=";
+    const std::string bodySizeOption = "--body-size=";
+    const std::string intervalOption = "--expected-interval-us=";
+    const std::string hdrOption = "--hdr-out=";
+    const std::string seedOption = "--seed=";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        try {
+            if (arg.rfind(hostOption, 0) == 0) {
+                config.host = arg.substr(hostOption.length());
+            } else if (arg.rfind(portOption, 0) == 0) {
+                config.port = std::stoi(arg.substr(portOption.length()));
+            } else if (arg.rfind(connectionsOption, 0) == 0) {
+                config.connections = std::stoi(arg.substr(connectionsOption.length()));
+                if (config.connections < 1) {
+                    return false;
+                }
+            } else if (arg.rfind(depthOption, 0) == 0) {
+                config.depth = std::stoi(arg.substr(depthOption.length()));
+                if (config.depth < 1) {
+                    return false;
+                }
+            } else if (arg.rfind(rateOption, 0) == 0) {
+                config.rate = std::stod(arg.substr(rateOption.length()));
+                if (config.rate < 0) {
+                    return false;
+                }
+            } else if (arg.rfind(durationOption, 0) == 0) {
+                config.durationSeconds = std::stod(arg.substr(durationOption.length()));
+                if (config.durationSeconds <= 0) {
+                    return false;
+                }
+            } else if (arg.rfind(warmupOption, 0) == 0) {
+                config.warmupSeconds = std::stod(arg.substr(warmupOption.length()));
+                if (config.warmupSeconds < 0) {
+                    return false;
+                }
+            } else if (arg == "--no-keep-alive") {
+                config.keepAlive = false;
+            } else if (arg.rfind(mixOption, 0) == 0) {
+                config.mix = arg.substr(mixOption.length());
+            } else if (arg.rfind(filesOption, 0) == 0) {
+                config.fileCount = std::stoi(arg.substr(filesOption.length()));
+                if (config.fileCount < 1) {
+                    return false;
+                }
+            } else if (arg.rfind(bodySizeOption, 0) == 0) {
+                long long bytes = std::stoll(arg.substr(bodySizeOption.length()));
+                if (bytes < 0) {
+                    return false;
+                }
+                config.bodySize = (size_t)bytes;
+            } else if (arg.rfind(intervalOption, 0) == 0) {
+                config.expectedIntervalNs = (uint64_t)std::stoull(arg.substr(intervalOption.length())) * 1000;
+            } else if (arg.rfind(hdrOption, 0) == 0) {
+                config.hdrPath = arg.substr(hdrOption.length());
+            } else if (arg.rfind(seedOption, 0) == 0) {
+                config.seed = std::stoull(arg.substr(seedOption.length()));
+            } else {
+                return false;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool resolve(const LoadConfig& config, sockaddr_in& address) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(config.host.c_str(), std::to_string(config.port).c_str(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    std::memcpy(&address, result->ai_addr, sizeof(address));
+    freeaddrinfo(result);
+    return true;
+}
+
+// Sends each request on a blocking connection and waits for its answer;
+// false unless every one gets a 2xx.
+static bool runSetup(const sockaddr_in& address, const std::vector<std::string>& requests) {
+    int fd = -1;
+    ResponseReader reader;
+    std::vector<char> buffer(64 * 1024);
+    for (const std::string& request : requests) {
+        if (fd < 0) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+                std::cerr << "Cannot connect: " << std::strerror(errno) << std::endl;
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return false;
+            }
+        }
+        if (send(fd, request.data(), request.length(), MSG_NOSIGNAL) != (ssize_t)request.length()) {
+            close(fd);
+            return false;
+        }
+        ResponseReader::Result result = ResponseReader::Result::NeedMore;
+        while (result == ResponseReader::Result::NeedMore) {
+            ssize_t received = recv(fd, buffer.data(), buffer.size(), 0);
+            if (received <= 0) {
+                result = received == 0 && reader.finishAtClose() ? ResponseReader::Result::Complete : ResponseReader::Result::Malformed;
+                break;
+            }
+            size_t consumed = 0;
+            result = reader.read(buffer.data(), (size_t)received, consumed);
+        }
+        if (result != ResponseReader::Result::Complete || reader.getStatus() / 100 != 2) {
+            std::cerr << "Setup request failed (status " << reader.getStatus() << "): " << request.substr(0, request.find('\r')) << std::endl;
+            close(fd);
+            return false;
+        }
+        if (reader.isClose()) {
+            close(fd);
+            fd = -1;
+            reader = ResponseReader();
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return true;
+}
+
+static std::string formatLatency(uint64_t nanoseconds) {
+    char text[32];
+    if (nanoseconds < 1000000) {
+        std::snprintf(text, sizeof(text), "%.1f us", (double)nanoseconds / 1e3);
+    } else if (nanoseconds < 1000000000) {
+        std::snprintf(text, sizeof(text), "%.2f ms", (double)nanoseconds / 1e6);
+    } else {
+        std::snprintf(text, sizeof(text), "%.3f s", (double)nanoseconds / 1e9);
+    }
+    return text;
+}
+
+static void printReport(const LoadConfig& config, const LoadResults& results) {
+    std::printf("  %llu requests in %.1f s: %.1f requests/s, %.2f MB/s of bodies\n", (unsigned long long)results.completed,
+                results.elapsedSeconds, (double)results.completed / results.elapsedSeconds,
+                (double)results.bodyBytes / results.elapsedSeconds / (1024.0 * 1024.0));
+
+    std::printf("  requests:");
+    for (int kind = 0; kind < (int)RequestKind::Count; kind++) {
+        if (results.kindCounts[kind] > 0) {
+            std::printf(" %s %llu", RequestMix::getName((RequestKind)kind), (unsigned long long)results.kindCounts[kind]);
+        }
+    }
+    std::printf("\n  status:");
+    for (int status = 0; status < 600; status++) {
+        if (results.statusCounts[status] > 0) {
+            std::printf(" %d x %llu", status, (unsigned long long)results.statusCounts[status]);
+        }
+    }
+    std::printf("\n  errors: %llu failed, %llu unfinished, %llu failed connects, %llu reconnects\n\n",
+                (unsigned long long)results.failed, (unsigned long long)results.unfinished,
+                (unsigned long long)results.connectErrors, (unsigned long long)results.reconnects);
+
+    if (config.rate > 0) {
+        std::printf("  Latency from each request's scheduled send time (corrected) and from its actual send (measured):\n");
+    } else {
+        std::printf("  Latency as measured, and corrected as if each in-flight request slot sent every %s:\n",
+                    formatLatency(results.expectedIntervalNs).c_str());
+    }
+    std::printf("  %10s %14s %14s\n", "", "corrected", "measured");
+    const double percentiles[] = { 50, 75, 90, 99, 99.9, 99.99, 99.999 };
+    bool correctedBelowMeasured = false;
+    for (double percentile : percentiles) {
+        char label[16];
+        std::snprintf(label, sizeof(label), "p%g", percentile);
+        uint64_t corrected = results.corrected.getPercentile(percentile);
+        uint64_t measured = results.measured.getPercentile(percentile);
+        correctedBelowMeasured |= corrected < measured;
+        std::printf("  %10s %14s %14s\n", label, formatLatency(corrected).c_str(), formatLatency(measured).c_str());
+    }
+    std::printf("  %10s %14s %14s\n", "max", formatLatency(results.corrected.getMax()).c_str(),
+                formatLatency(results.measured.getMax()).c_str());
+    std::printf("  %10s %14s %14s\n", "mean", formatLatency((uint64_t)results.corrected.getMean()).c_str(),
+                formatLatency((uint64_t)results.measured.getMean()).c_str());
+
+    // The closed-loop correction only adds the requests a stall held back, so
+    // it should never bring a percentile down. If it does, the interval it
+    // assumed is shorter than a request normally takes (e.g. counted per
+    // connection when --depth keeps several in flight).
+    if (config.rate <= 0 && correctedBelowMeasured) {
+        std::printf("\n  Warning: corrected latencies fall below measured ones; the expected interval of %s is too short.\n",
+                    formatLatency(results.expectedIntervalNs).c_str());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig config;
+    if (!parseArguments(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+
+    RequestMix mix;
+    if (!mix.parse(config.mix)) {
+        std::cerr << "Invalid --mix: " << config.mix << std::endl;
+        return 1;
+    }
+    mix.build(config.host + ":" + std::to_string(config.port), config.fileCount, config.bodySize, config.keepAlive, config.seed);
+
+    sockaddr_in address;
+    if (!resolve(config, address)) {
+        std::cerr << "Cannot resolve " << config.host << std::endl;
+        return 1;
+    }
+
+    // One descriptor per connection, plus a few.
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)config.connections + 16) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    // Open-loop sends are timed by a timerfd, which the default 50 us timer
+    // slack would otherwise let the kernel fire late.
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+    if (!runSetup(address, mix.buildSetupRequests())) {
+        return 1;
+    }
+
+    std::printf("Running %.0f s %s test against %s:%d after %.0f s of warm-up\n", config.durationSeconds,
+                config.rate > 0 ? "open-loop" : "closed-loop", config.host.c_str(), config.port, config.warmupSeconds);
+    if (config.rate > 0) {
+        std::printf("  %.0f requests/s over %d connections, up to %d in flight each, %s\n", config.rate, config.connections,
+                    config.keepAlive ? config.depth : 1, config.keepAlive ? "keep-alive" : "a connection per request");
+    } else {
+        std::printf("  %d connections, %d in flight each, %s\n", config.connections, config.keepAlive ? config.depth : 1,
+                    config.keepAlive ? "keep-alive" : "a connection per request");
+    }
+    std::printf("  mix: %s\n\n", mix.describe().c_str());
+    std::fflush(stdout);
+
+    LoadResults results;
+    LoadGenerator generator(config, mix, address);
+    if (!generator.run(results)) {
+        std::cerr << "Cannot create the event loop: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    printReport(config, results);
+
+    if (!config.hdrPath.empty()) {
+        FILE* out = std::fopen(config.hdrPath.c_str(), "w");
+        if (!out) {
+            std::cerr << "Cannot write " << config.hdrPath << std::endl;
+            return 1;
+        }
+        results.corrected.writePercentiles(out);
+        std::fclose(out);
+    }
+    return 0;
+}
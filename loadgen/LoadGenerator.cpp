@@ -0,0 +1,389 @@
+#include "LoadGenerator.h"
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static uint64_t getMonotonicTimeNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+LoadGenerator::LoadGenerator(const LoadConfig& config, RequestMix& mix, const sockaddr_in& address)
+    : m_config(config), m_mix(mix), m_address(address), m_connections((size_t)config.connections), m_buffer(64 * 1024) {}
+
+LoadGenerator::~LoadGenerator() {
+    for (Connection& connection : m_connections) {
+        if (connection.fd >= 0) {
+            close(connection.fd);
+        }
+    }
+    if (m_timer >= 0) {
+        close(m_timer);
+    }
+    if (m_epoll >= 0) {
+        close(m_epoll);
+    }
+}
+
+uint64_t LoadGenerator::getIntendedNs(uint64_t sequence) const {
+    return m_startNs + (uint64_t)((double)sequence * 1e9 / m_config.rate);
+}
+
+void LoadGenerator::connect(uint32_t index, uint64_t now) {
+    Connection& connection = m_connections[index];
+    connection.retryAtNs = 0;
+    connection.connectStartNs = now;
+    connection.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (connection.fd < 0) {
+        m_results->connectErrors++;
+        connection.retryAtNs = now + RETRY_DELAY_NS;
+        m_retrying++;
+        return;
+    }
+    int enable = 1;
+    setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    if (::connect(connection.fd, (const sockaddr*)&m_address, sizeof(m_address)) < 0 && errno != EINPROGRESS) {
+        close(connection.fd);
+        connection.fd = -1;
+        m_results->connectErrors++;
+        connection.retryAtNs = now + RETRY_DELAY_NS;
+        m_retrying++;
+        return;
+    }
+    connection.connecting = true;
+
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u32 = index;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, connection.fd, &event);
+}
+
+// Closes the connection. Requests in flight on it are lost; requests still
+// in the open-loop backlog stay there and go out on the next connection.
+void LoadGenerator::disconnect(uint32_t index, uint64_t now, bool reconnect) {
+    Connection& connection = m_connections[index];
+    if (connection.fd >= 0) {
+        close(connection.fd); // Also leaves the epoll set
+        connection.fd = -1;
+    }
+    connection.connecting = false;
+    for (const InFlight& request : connection.inFlight) {
+        if (isMeasured(request.intendedNs)) {
+            m_results->failed++;
+        }
+    }
+    m_outstanding -= connection.inFlight.size();
+    connection.inFlight.clear();
+    connection.output.clear();
+    connection.outputSent = 0;
+    connection.reader = ResponseReader();
+
+    // After the run only a backlog still needs a connection.
+    if (reconnect && (now < m_endNs || connection.backlog > 0)) {
+        if (now >= m_measureStartNs) {
+            m_results->reconnects++;
+        }
+        connect(index, now);
+    }
+}
+
+// Without keep-alive a request is taken to start when its connection was
+// opened, or when it fell due if that was later: opening the connection is
+// part of what it costs.
+void LoadGenerator::issue(Connection& connection, uint64_t intendedNs, uint64_t now) {
+    const PreparedRequest& request = m_mix.next();
+    connection.output.append(request.bytes);
+    uint64_t sentNs = now;
+    if (!m_config.keepAlive) {
+        sentNs = connection.connectStartNs > intendedNs ? connection.connectStartNs : intendedNs;
+    }
+    connection.inFlight.push_back({ intendedNs, sentNs, request.kind });
+}
+
+// Sends what the connection may: up to depth requests in flight, drawn from
+// the backlog in open loop, or new ones until the end of the run in closed loop.
+void LoadGenerator::fill(Connection& connection, uint64_t now) {
+    if (connection.fd < 0 || connection.connecting) {
+        return;
+    }
+    const size_t depth = m_config.keepAlive ? (size_t)m_config.depth : 1;
+    while (connection.inFlight.size() < depth) {
+        if (m_config.rate > 0) {
+            if (connection.backlog == 0) {
+                break;
+            }
+            issue(connection, getIntendedNs(connection.backlogFirst), now);
+            connection.backlogFirst += m_connections.size();
+            connection.backlog--;
+        } else {
+            if (now >= m_endNs) {
+                break;
+            }
+            issue(connection, m_config.keepAlive ? now : connection.connectStartNs, now);
+            m_outstanding++;
+        }
+    }
+}
+
+// Writes the pending requests until the socket would block. False if the
+// connection failed and was closed.
+bool LoadGenerator::flush(uint32_t index) {
+    Connection& connection = m_connections[index];
+    while (connection.outputSent < connection.output.length()) {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.outputSent,
+                            connection.output.length() - connection.outputSent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            disconnect(index, getMonotonicTimeNs(), true);
+            return false;
+        }
+        connection.outputSent += (size_t)sent;
+    }
+    connection.output.clear();
+    connection.outputSent = 0;
+    return true;
+}
+
+// Accounts for the response to the oldest request in flight. False if there
+// was no such request.
+bool LoadGenerator::complete(Connection& connection, uint64_t now) {
+    if (connection.inFlight.empty()) {
+        return false;
+    }
+    InFlight request = connection.inFlight.front();
+    connection.inFlight.pop_front();
+    m_outstanding--;
+
+    if (isMeasured(request.intendedNs)) {
+        m_results->corrected.record(now - request.intendedNs);
+        m_results->measured.record(now - request.sentNs);
+        m_results->completed++;
+        m_results->bodyBytes += connection.reader.getBodyLength();
+        m_results->statusCounts[connection.reader.getStatus()]++;
+        m_results->kindCounts[(int)request.kind]++;
+    }
+    return true;
+}
+
+void LoadGenerator::receive(uint32_t index) {
+    Connection& connection = m_connections[index];
+    while (true) {
+        ssize_t received = recv(connection.fd, m_buffer.data(), m_buffer.size(), 0);
+        uint64_t now = getMonotonicTimeNs();
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            // A response delimited by the close has now ended.
+            if (received == 0 && connection.reader.finishAtClose()) {
+                complete(connection, now);
+            }
+            disconnect(index, now, true);
+            return;
+        }
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        size_t offset = 0;
+        while (offset < (size_t)received) {
+            size_t consumed = 0;
+            ResponseReader::Result result = connection.reader.read(m_buffer.data() + offset, (size_t)received - offset, consumed);
+            offset += consumed;
+            if (result == ResponseReader::Result::NeedMore) {
+                break;
+            }
+            if (result == ResponseReader::Result::Malformed || !complete(connection, now)) {
+                disconnect(index, now, true);
+                return;
+            }
+            // Without keep-alive the client hangs up once it has its answer,
+            // whether or not the server would have.
+            if (connection.reader.isClose() || !m_config.keepAlive) {
+                disconnect(index, now, true);
+                return;
+            }
+        }
+    }
+
+    uint64_t now = getMonotonicTimeNs();
+    fill(connection, now);
+    flush(index);
+}
+
+void LoadGenerator::onEvent(uint32_t index, uint32_t events) {
+    Connection& connection = m_connections[index];
+    if (connection.connecting) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            uint64_t now = getMonotonicTimeNs();
+            close(connection.fd);
+            connection.fd = -1;
+            connection.connecting = false;
+            m_results->connectErrors++;
+            connection.retryAtNs = now + RETRY_DELAY_NS;
+            m_retrying++;
+            return;
+        }
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+        connection.connecting = false;
+        fill(connection, getMonotonicTimeNs());
+        if (!flush(index)) {
+            return;
+        }
+    }
+
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        receive(index);
+    } else if (events & EPOLLOUT) {
+        flush(index);
+    }
+}
+
+// Open loop: hands every request that has fallen due to its connection.
+void LoadGenerator::schedule(uint64_t now) {
+    const uint64_t connectionCount = m_connections.size();
+    while (true) {
+        uint64_t intended = getIntendedNs(m_nextSequence);
+        if (intended > now || intended >= m_endNs) {
+            break;
+        }
+        uint32_t index = (uint32_t)(m_nextSequence % connectionCount);
+        Connection& connection = m_connections[index];
+        if (connection.backlog++ == 0) {
+            connection.backlogFirst = m_nextSequence;
+        }
+        m_nextSequence++;
+        m_outstanding++;
+        fill(connection, now);
+        flush(index);
+    }
+}
+
+void LoadGenerator::armTimer(uint64_t atNs) {
+    itimerspec timer = {};
+    timer.it_value.tv_sec = (time_t)(atNs / 1000000000ull);
+    timer.it_value.tv_nsec = (long)(atNs % 1000000000ull);
+    timerfd_settime(m_timer, TFD_TIMER_ABSTIME, &timer, nullptr);
+}
+
+bool LoadGenerator::run(LoadResults& results) {
+    m_results = &results;
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_epoll < 0 || m_timer < 0) {
+        return false;
+    }
+    epoll_event timerEvent = {};
+    timerEvent.events = EPOLLIN;
+    timerEvent.data.u32 = TIMER_ID;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_timer, &timerEvent);
+
+    m_startNs = getMonotonicTimeNs();
+    m_measureStartNs = m_startNs + (uint64_t)(m_config.warmupSeconds * 1e9);
+    m_endNs = m_measureStartNs + (uint64_t)(m_config.durationSeconds * 1e9);
+    const uint64_t drainEndNs = m_endNs + DRAIN_NS;
+
+    for (uint32_t i = 0; i < m_connections.size(); i++) {
+        connect(i, m_startNs);
+    }
+
+    std::vector<epoll_event> events(1024);
+    uint64_t armedNs = 0;
+    while (true) {
+        uint64_t now = getMonotonicTimeNs();
+        if (m_config.rate > 0) {
+            schedule(now);
+            uint64_t due = getIntendedNs(m_nextSequence);
+            if (due < m_endNs && due != armedNs) {
+                armTimer(due);
+                armedNs = due;
+            }
+        }
+        if (m_retrying > 0) {
+            for (uint32_t i = 0; i < m_connections.size(); i++) {
+                uint64_t retryAt = m_connections[i].retryAtNs;
+                if (retryAt != 0 && retryAt <= now) {
+                    m_retrying--;
+                    if (now < m_endNs || m_connections[i].backlog > 0) {
+                        connect(i, now);
+                    } else {
+                        m_connections[i].retryAtNs = 0;
+                    }
+                }
+            }
+        }
+        if ((now >= m_endNs && m_outstanding == 0) || now >= drainEndNs) {
+            break;
+        }
+
+        // Wake at the end of the run and of the drain even if nothing happens.
+        uint64_t wakeNs = now < m_endNs ? m_endNs : drainEndNs;
+        int timeoutMs = (int)((wakeNs - now + 999999) / 1000000);
+        if (m_retrying > 0 && timeoutMs > 10) {
+            timeoutMs = 10;
+        }
+        int count = epoll_wait(m_epoll, events.data(), (int)events.size(), timeoutMs);
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.u32 == TIMER_ID) {
+                uint64_t expirations;
+                (void)!read(m_timer, &expirations, sizeof(expirations));
+                continue;
+            }
+            onEvent(events[i].data.u32, events[i].events);
+        }
+    }
+
+    // Whatever is left never got an answer; it is recorded as taking at
+    // least until now, which understates it rather than dropping it.
+    uint64_t now = getMonotonicTimeNs();
+    for (Connection& connection : m_connections) {
+        for (const InFlight& request : connection.inFlight) {
+            if (isMeasured(request.intendedNs)) {
+                results.corrected.record(now - request.intendedNs);
+                results.measured.record(now - request.sentNs);
+                results.unfinished++;
+            }
+        }
+        for (uint64_t i = 0; i < connection.backlog; i++) {
+            uint64_t intended = getIntendedNs(connection.backlogFirst + i * m_connections.size());
+            if (isMeasured(intended)) {
+                results.corrected.record(now - intended);
+                results.unfinished++;
+            }
+        }
+    }
+    results.elapsedSeconds = m_config.durationSeconds;
+
+    if (m_config.rate <= 0) {
+        // Closed loop has no schedule to measure against, so the correction
+        // assumes each in-flight slot (depth of them per connection) would
+        // have kept sending at the pace it averaged (Little's law:
+        // slots * duration / completed). A request normally takes about that
+        // long; per connection it would be depth times too short, and every
+        // request would be credited with depth - 1 made-up faster ones.
+        results.expectedIntervalNs = m_config.expectedIntervalNs;
+        if (results.expectedIntervalNs == 0 && results.completed > 0) {
+            const double slots = (double)m_connections.size() * (m_config.keepAlive ? m_config.depth : 1);
+            results.expectedIntervalNs = (uint64_t)(m_config.durationSeconds * 1e9 * slots / (double)results.completed);
+        }
+        results.corrected = results.measured.corrected(results.expectedIntervalNs);
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include "HdrHistogram.h"
+#include "RequestMix.h"
+#include "ResponseReader.h"
+
+struct LoadConfig {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 64;
+    int depth = 1;              // Requests in flight per connection
+    double rate = 0;            // Requests per second over all connections; 0 runs closed-loop
+    double durationSeconds = 10;
+    double warmupSeconds = 1;
+    bool keepAlive = true;
+    int fileCount = 16;
+    size_t bodySize = 1024;
+    std::string mix = RequestMix::DEFAULT_SPEC;
+    uint64_t expectedIntervalNs = 0; // Closed loop, per in-flight slot; 0 = measured from the run
+    std::string hdrPath;
+    uint64_t seed = 1;
+};
+
+struct LoadResults {
+    // Open loop: from each request's scheduled send time, so time spent
+    // waiting behind a stalled connection counts. Closed loop: the measured
+    // latencies, each stall filled in with the requests it held back.
+    HdrHistogram corrected;
+    // From the moment each request was actually sent, or its connection
+    // opened when there is no keep-alive.
+    HdrHistogram measured;
+    uint64_t expectedIntervalNs = 0; // Closed loop: what the correction assumed, per in-flight slot
+
+    uint64_t completed = 0;
+    uint64_t bodyBytes = 0;
+    uint64_t failed = 0;      // Lost to a closed or broken connection
+    uint64_t unfinished = 0;  // Still queued or in flight at the drain deadline
+    uint64_t connectErrors = 0;
+    uint64_t reconnects = 0;
+    uint64_t statusCounts[600] = {};
+    uint64_t kindCounts[(int)RequestKind::Count] = {};
+    double elapsedSeconds = 0;
+};
+
+// Drives many connections from one epoll loop. Closed loop keeps depth
+// requests in flight on every connection. Open loop sends at a fixed rate
+// whatever the server does: request n is due at start + n / rate on
+// connection n % connections, and when that connection is still busy the
+// request waits, its latency counted from when it was due. This is what
+// keeps a stalled server from hiding its own stall (coordinated omission).
+// Linux only.
+class LoadGenerator {
+public:
+    LoadGenerator(const LoadConfig& config, RequestMix& mix, const sockaddr_in& address);
+    ~LoadGenerator();
+
+    // Warm-up, then the measured run, then up to DRAIN_NS for the last responses.
+    bool run(LoadResults& results);
+
+private:
+    static constexpr uint64_t DRAIN_NS = 2000000000ull;
+    static constexpr uint64_t RETRY_DELAY_NS = 100000000ull;
+    static const uint32_t TIMER_ID = UINT32_MAX;
+
+    struct InFlight {
+        uint64_t intendedNs;
+        uint64_t sentNs;
+        RequestKind kind;
+    };
+
+    struct Connection {
+        int fd = -1;
+        bool connecting = false;
+        std::string output;
+        size_t outputSent = 0;
+        std::deque<InFlight> inFlight;
+        ResponseReader reader;
+        // Open loop: requests due but not yet sent, backlogFirst being the
+        // first one's sequence number; the others follow every connections.
+        uint64_t backlogFirst = 0;
+        uint64_t backlog = 0;
+        uint64_t connectStartNs = 0;
+        uint64_t retryAtNs = 0; // Reconnect time after a failed connect; 0 if none
+    };
+
+    uint64_t getIntendedNs(uint64_t sequence) const;
+    bool isMeasured(uint64_t intendedNs) const { return intendedNs >= m_measureStartNs && intendedNs < m_endNs; }
+
+    void connect(uint32_t index, uint64_t now);
+    void disconnect(uint32_t index, uint64_t now, bool reconnect);
+    void onEvent(uint32_t index, uint32_t events);
+    void receive(uint32_t index);
+    bool complete(Connection& connection, uint64_t now);
+    void fill(Connection& connection, uint64_t now);
+    void issue(Connection& connection, uint64_t intendedNs, uint64_t now);
+    bool flush(uint32_t index);
+    void schedule(uint64_t now);
+    void armTimer(uint64_t atNs);
+
+    const LoadConfig& m_config;
+    RequestMix& m_mix;
+    sockaddr_in m_address;
+    LoadResults* m_results = nullptr;
+
+    int m_epoll = -1;
+    int m_timer = -1;
+    std::vector<Connection> m_connections;
+    std::vector<char> m_buffer;
+
+    uint64_t m_startNs = 0;
+    uint64_t m_measureStartNs = 0;
+    uint64_t m_endNs = 0;
+    uint64_t m_nextSequence = 0;  // Open loop: the next request to fall due
+    uint64_t m_outstanding = 0;   // Requests queued or in flight
+    uint64_t m_retrying = 0;      // Connections waiting to reconnect
+};
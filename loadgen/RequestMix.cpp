@@ -0,0 +1,129 @@
+#include "RequestMix.h"
+#include <sstream>
+
+const char* RequestMix::DEFAULT_SPEC = "home:60,get:25,put:5,delete:5,post:5";
+
+static const char* const KIND_NAMES[] = { "home", "get", "put", "delete", "post" };
+
+const char* RequestMix::getName(RequestKind kind) {
+    return KIND_NAMES[(int)kind];
+}
+
+bool RequestMix::parse(const std::string& spec) {
+    for (uint32_t& weight : m_weights) {
+        weight = 0;
+    }
+    m_totalWeight = 0;
+
+    std::stringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        std::string name = item.substr(0, colon);
+        int kind = 0;
+        while (kind < (int)RequestKind::Count && name != KIND_NAMES[kind]) {
+            kind++;
+        }
+        if (kind == (int)RequestKind::Count) {
+            return false;
+        }
+        try {
+            int weight = std::stoi(item.substr(colon + 1));
+            if (weight < 0) {
+                return false;
+            }
+            m_weights[kind] = (uint32_t)weight;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    for (uint32_t weight : m_weights) {
+        m_totalWeight += weight;
+    }
+    return m_totalWeight > 0;
+}
+
+std::string RequestMix::renderRequest(const char* method, const std::string& target, size_t bodyLength) const {
+    std::string request = std::string(method) + " " + target + " HTTP/1.1\r\nHost: " + m_host + "\r\n";
+    if (!m_keepAlive) {
+        request += "Connection: close\r\n";
+    }
+    if (bodyLength > 0) {
+        request += "Content-Type: text/plain\r\nContent-Length: " + std::to_string(bodyLength) + "\r\n\r\n";
+        request.append(m_body, 0, bodyLength);
+    } else {
+        request += "\r\n";
+    }
+    return request;
+}
+
+void RequestMix::build(const std::string& host, int fileCount, size_t bodySize, bool keepAlive, uint64_t seed) {
+    m_host = host;
+    m_fileCount = fileCount;
+    m_keepAlive = keepAlive;
+    m_random = seed | 1;
+    m_body.resize(bodySize);
+    for (size_t i = 0; i < bodySize; i++) {
+        m_body[i] = i % 64 == 63 ? '\n' : (char)('a' + i % 26);
+    }
+
+    for (std::vector<PreparedRequest>& requests : m_requests) {
+        requests.clear();
+    }
+    for (const char* lang : { "en", "he", "fr" }) {
+        m_requests[(int)RequestKind::Home].push_back({ renderRequest("GET", std::string("/home?lang=") + lang, 0), RequestKind::Home });
+    }
+    for (int i = 0; i < fileCount; i++) {
+        std::string readTarget = "/file/loadgen-" + std::to_string(i) + ".txt";
+        std::string writeTarget = "/file/loadgen-w" + std::to_string(i) + ".txt";
+        m_requests[(int)RequestKind::GetFile].push_back({ renderRequest("GET", readTarget, 0), RequestKind::GetFile });
+        m_requests[(int)RequestKind::PutFile].push_back({ renderRequest("PUT", writeTarget, bodySize), RequestKind::PutFile });
+        m_requests[(int)RequestKind::DeleteFile].push_back({ renderRequest("DELETE", writeTarget, 0), RequestKind::DeleteFile });
+    }
+    m_requests[(int)RequestKind::PostMessage].push_back({ renderRequest("POST", "/postmessage", bodySize < 256 ? bodySize : 256),
+                                                          RequestKind::PostMessage });
+}
+
+const PreparedRequest& RequestMix::next() {
+    // xorshift64: fast, and a fixed seed replays the same sequence.
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 7;
+    m_random ^= m_random << 17;
+
+    uint32_t draw = (uint32_t)(m_random % m_totalWeight);
+    int kind = 0;
+    while (draw >= m_weights[kind]) {
+        draw -= m_weights[kind];
+        kind++;
+    }
+    const std::vector<PreparedRequest>& requests = m_requests[kind];
+    return requests[(m_random >> 32) % requests.size()];
+}
+
+std::vector<std::string> RequestMix::buildSetupRequests() const {
+    std::vector<std::string> requests;
+    if (m_weights[(int)RequestKind::GetFile] == 0) {
+        return requests;
+    }
+    for (int i = 0; i < m_fileCount; i++) {
+        requests.push_back(renderRequest("PUT", "/file/loadgen-" + std::to_string(i) + ".txt", m_body.size()));
+    }
+    return requests;
+}
+
+std::string RequestMix::describe() const {
+    std::string text;
+    for (int kind = 0; kind < (int)RequestKind::Count; kind++) {
+        if (m_weights[kind] == 0) {
+            continue;
+        }
+        if (!text.empty()) {
+            text += ", ";
+        }
+        text += std::string(KIND_NAMES[kind]) + " " + std::to_string(m_weights[kind] * 100 / m_totalWeight) + "%";
+    }
+    return text;
+}
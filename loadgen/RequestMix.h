@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The kinds of request the load generator sends, one per server route.
+enum class RequestKind {
+    Home,        // GET /home?lang=en|he|fr
+    GetFile,     // GET /file/loadgen-N.txt, from the files created before the run
+    PutFile,     // PUT /file/loadgen-wN.txt
+    DeleteFile,  // DELETE /file/loadgen-wN.txt; a 404 when no PUT came first
+    PostMessage, // POST /postmessage
+    Count
+};
+
+struct PreparedRequest {
+    std::string bytes;
+    RequestKind kind;
+};
+
+// A weighted mix of requests, all rendered once before the run, so picking
+// the next one is a random draw and nothing is formatted on the hot path.
+// GETs read one set of files and PUT/DELETE write another, so deletes never
+// turn reads into 404s.
+class RequestMix {
+public:
+    static const char* DEFAULT_SPEC;
+
+    // spec is "kind:weight,..." with the names from getName(), e.g.
+    // "home:60,get:25,put:5,delete:5,post:5". False if malformed.
+    bool parse(const std::string& spec);
+
+    void build(const std::string& host, int fileCount, size_t bodySize, bool keepAlive, uint64_t seed);
+
+    const PreparedRequest& next();
+
+    // The PUTs that create the files GETs read, to be sent before the run.
+    std::vector<std::string> buildSetupRequests() const;
+
+    // e.g. "home 60%, get 25%, ..."
+    std::string describe() const;
+
+    static const char* getName(RequestKind kind);
+
+private:
+    std::string renderRequest(const char* method, const std::string& target, size_t bodyLength) const;
+
+    uint32_t m_weights[(int)RequestKind::Count] = {};
+    uint32_t m_totalWeight = 0;
+    std::vector<PreparedRequest> m_requests[(int)RequestKind::Count];
+
+    std::string m_host;
+    int m_fileCount = 0;
+    std::string m_body;
+    bool m_keepAlive = true;
+    uint64_t m_random = 0;
+};
@@ -0,0 +1,182 @@
+#include "ResponseReader.h"
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+static bool containsToken(const char* value, size_t length, const char* token) {
+    size_t tokenLength = std::strlen(token);
+    for (size_t i = 0; i + tokenLength <= length; i++) {
+        if (strncasecmp(value + i, token, tokenLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses the status line and the headers that frame the body, and picks the
+// state that reads it.
+bool ResponseReader::parseHead() {
+    const char* head = m_head.c_str();
+    if (std::strncmp(head, "HTTP/1.", 7) != 0 || m_head.length() < 12) {
+        return false;
+    }
+    m_status = std::atoi(head + 9);
+    if (m_status < 100 || m_status > 599) {
+        return false;
+    }
+    // HTTP/1.0 closes unless told otherwise.
+    m_close = head[7] == '0';
+
+    bool chunked = false;
+    bool hasLength = false;
+    uint64_t contentLength = 0;
+    const char* line = std::strstr(head, "\r\n") + 2;
+    while (*line != '\r') {
+        const char* end = std::strstr(line, "\r\n");
+        const char* colon = static_cast<const char*>(std::memchr(line, ':', (size_t)(end - line)));
+        if (!colon) {
+            return false;
+        }
+        size_t nameLength = (size_t)(colon - line);
+        const char* value = colon + 1;
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        size_t valueLength = (size_t)(end - value);
+        if (nameLength == 14 && strncasecmp(line, "Content-Length", 14) == 0) {
+            hasLength = true;
+            contentLength = std::strtoull(value, nullptr, 10);
+        } else if (nameLength == 17 && strncasecmp(line, "Transfer-Encoding", 17) == 0) {
+            chunked = containsToken(value, valueLength, "chunked");
+        } else if (nameLength == 10 && strncasecmp(line, "Connection", 10) == 0) {
+            if (containsToken(value, valueLength, "close")) {
+                m_close = true;
+            } else if (containsToken(value, valueLength, "keep-alive")) {
+                m_close = false;
+            }
+        }
+        line = end + 2;
+    }
+
+    m_bodyLength = 0;
+    if (m_status < 200 || m_status == 204 || m_status == 304) {
+        m_remaining = 0;
+        m_state = State::Body;
+    } else if (chunked) {
+        m_state = State::ChunkSize;
+    } else if (hasLength) {
+        m_remaining = contentLength;
+        m_state = State::Body;
+    } else {
+        m_close = true;
+        m_state = State::BodyUntilClose;
+    }
+    return true;
+}
+
+bool ResponseReader::readLine(const char* data, size_t length, size_t& used) {
+    const char* newline = static_cast<const char*>(std::memchr(data, '\n', length));
+    used = newline ? (size_t)(newline - data) + 1 : length;
+    m_line.append(data, used);
+    return newline != nullptr;
+}
+
+ResponseReader::Result ResponseReader::read(const char* data, size_t length, size_t& consumed) {
+    consumed = 0;
+    while (true) {
+        const char* input = data + consumed;
+        size_t available = length - consumed;
+        size_t used = 0;
+
+        switch (m_state) {
+        case State::Head: {
+            if (available == 0) {
+                return Result::NeedMore;
+            }
+            // The terminator may straddle two reads.
+            size_t searchFrom = m_head.length() < 3 ? 0 : m_head.length() - 3;
+            m_head.append(input, available);
+            size_t end = m_head.find("\r\n\r\n", searchFrom);
+            if (end == std::string::npos) {
+                consumed = length;
+                return m_head.length() > MAX_HEAD_LENGTH ? Result::Malformed : Result::NeedMore;
+            }
+            consumed += end + 4 - (m_head.length() - available);
+            m_head.resize(end + 4);
+            if (!parseHead()) {
+                return Result::Malformed;
+            }
+            m_head.clear();
+            if (m_status < 200) {
+                m_state = State::Head; // Interim; the final response follows
+            }
+            break;
+        }
+        case State::Body:
+            used = (size_t)(available < m_remaining ? available : m_remaining);
+            m_remaining -= used;
+            m_bodyLength += used;
+            consumed += used;
+            if (m_remaining > 0) {
+                return Result::NeedMore;
+            }
+            m_state = State::Head;
+            return Result::Complete;
+        case State::BodyUntilClose:
+            m_bodyLength += available;
+            consumed = length;
+            return Result::NeedMore;
+        case State::ChunkSize:
+        case State::ChunkEnd:
+        case State::Trailers: {
+            if (available == 0) {
+                return Result::NeedMore;
+            }
+            bool complete = readLine(input, available, used);
+            consumed += used;
+            if (!complete) {
+                if (m_line.length() > MAX_HEAD_LENGTH) {
+                    return Result::Malformed;
+                }
+                return Result::NeedMore;
+            }
+            if (m_state == State::ChunkSize) {
+                char* end = nullptr;
+                m_remaining = std::strtoull(m_line.c_str(), &end, 16);
+                if (end == m_line.c_str()) {
+                    return Result::Malformed;
+                }
+                m_state = m_remaining == 0 ? State::Trailers : State::ChunkData;
+            } else if (m_state == State::ChunkEnd) {
+                m_state = State::ChunkSize;
+            } else if (m_line == "\r\n" || m_line == "\n") {
+                m_line.clear();
+                m_state = State::Head;
+                return Result::Complete;
+            }
+            m_line.clear();
+            break;
+        }
+        case State::ChunkData:
+            if (available == 0) {
+                return Result::NeedMore;
+            }
+            used = (size_t)(available < m_remaining ? available : m_remaining);
+            m_remaining -= used;
+            m_bodyLength += used;
+            consumed += used;
+            if (m_remaining == 0) {
+                m_state = State::ChunkEnd;
+            }
+            break;
+        }
+    }
+}
+
+bool ResponseReader::finishAtClose() {
+    if (m_state != State::BodyUntilClose) {
+        return false;
+    }
+    m_state = State::Head;
+    return true;
+}
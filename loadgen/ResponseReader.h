@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// An incremental HTTP/1.1 response reader for the load generator. It is fed
+// whatever the socket returned and stops at the end of each response, so
+// pipelined responses are told apart. Only the status line and headers are
+// buffered; bodies (Content-Length, chunked, or up to the close) are
+// counted and skipped, so a large file costs no memory.
+class ResponseReader {
+public:
+    enum class Result {
+        NeedMore,  // All of the input was consumed without finishing a response
+        Complete,  // A response ended; the rest of the input belongs to the next one
+        Malformed,
+    };
+
+    // Reads at most one response from data; consumed is how much of it was used.
+    // Interim 1xx responses are skipped over.
+    Result read(const char* data, size_t length, size_t& consumed);
+
+    // At end of stream: true if the response in progress was one delimited by
+    // the close, which has now ended.
+    bool finishAtClose();
+
+    // Whether nothing of the next response has been read yet.
+    bool isIdle() const { return m_state == State::Head && m_head.empty(); }
+
+    // Of the response last completed.
+    int getStatus() const { return m_status; }
+    bool isClose() const { return m_close; }
+    uint64_t getBodyLength() const { return m_bodyLength; }
+
+private:
+    static const size_t MAX_HEAD_LENGTH = 64 * 1024;
+
+    enum class State {
+        Head,
+        Body,          // m_remaining bytes left
+        BodyUntilClose,
+        ChunkSize,
+        ChunkData,     // m_remaining bytes left in the chunk
+        ChunkEnd,      // The CRLF after a chunk
+        Trailers,
+    };
+
+    bool parseHead();
+    // Collects a line into m_line; true once it is complete.
+    bool readLine(const char* data, size_t length, size_t& used);
+
+    State m_state = State::Head;
+    std::string m_head;
+    std::string m_line;
+    uint64_t m_remaining = 0;
+    uint64_t m_bodyLength = 0;
+    int m_status = 0;
+    bool m_close = false;
+};
@@ -0,0 +1,392 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "AccessLog.h"
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "Platform.h"
+
+AccessLog::AccessLog(const std::string& path, int reactorCount, int sampleEvery, uint64_t maxFileBytes)
+	: m_path(path), m_sampleEvery(sampleEvery > 0 ? sampleEvery : 1), m_maxFileBytes(maxFileBytes)
+{
+	if (!m_path.empty())
+	{
+		for (int i = 0; i < reactorCount; i++)
+		{
+			m_channels.push_back(std::make_unique<Channel>(ACCESS_LOG_RING_CAPACITY));
+		}
+	}
+}
+
+AccessLog::~AccessLog()
+{
+	if (m_running.exchange(false))
+	{
+		m_thread.join();
+	}
+	if (m_file)
+	{
+		fclose(m_file);
+	}
+}
+
+bool AccessLog::start()
+{
+	if (m_channels.empty())
+	{
+		return true;
+	}
+	if (!openFile())
+	{
+		std::cout << "Server: Could not open the access log " << m_path << "." << std::endl;
+		return false;
+	}
+	m_running = true;
+	m_thread = std::thread(&AccessLog::run, this);
+	return true;
+}
+
+void AccessLog::logRequest(int reactor, const HttpRequest& request, HttpStatusCode status, uint64_t bytes)
+{
+	if (!isSampled(reactor))
+	{
+		return;
+	}
+	AccessRecord record;
+	record.event = AccessEvent::Request;
+	record.socket = 0;
+	record.bytes = bytes;
+	record.peerAddress = 0;
+	record.peerPort = 0;
+	record.status = (uint16_t)status;
+	record.method = (uint8_t)request.getMethod();
+	std::string_view url = request.getRawUrl();
+	record.textLength = (uint8_t)(url.length() < sizeof(record.text) ? url.length() : sizeof(record.text));
+	std::memcpy(record.text, url.data(), record.textLength);
+	push(reactor, record);
+}
+
+void AccessLog::logConnection(int reactor, AccessEvent event, uint64_t socket, uint32_t peerAddress, uint16_t peerPort, std::string_view detail)
+{
+	if (!isSampled(reactor))
+	{
+		return;
+	}
+	AccessRecord record;
+	record.event = event;
+	record.socket = socket;
+	record.bytes = 0;
+	record.peerAddress = peerAddress;
+	record.peerPort = peerPort;
+	record.status = 0;
+	record.method = (uint8_t)HttpMethod::UNKNOWN;
+	record.textLength = (uint8_t)(detail.length() < sizeof(record.text) ? detail.length() : sizeof(record.text));
+	std::memcpy(record.text, detail.data(), record.textLength);
+	push(reactor, record);
+}
+
+void AccessLog::logSlowRequest(int reactor, uint64_t socket, const RequestTrace& trace)
+{
+	if (!isSampled(reactor))
+	{
+		return;
+	}
+	AccessRecord record;
+	record.event = AccessEvent::Slow;
+	record.socket = socket;
+	record.peerAddress = 0;
+	record.peerPort = 0;
+	record.status = trace.status;
+	record.method = trace.method;
+
+	// Each reached phase is timed from the one before it that was reached.
+	const uint64_t* at = trace.times.at;
+	uint64_t previous = at[(int)TracePhase::Accepted];
+	for (int i = 0; i < TRACE_INTERVAL_COUNT; i++)
+	{
+		uint64_t current = at[i + 1];
+		if (current == 0 || previous == 0)
+		{
+			record.phaseMicros[i] = UINT32_MAX;
+			previous = current != 0 ? current : previous;
+			continue;
+		}
+		uint64_t micros = traceTicksToMicros(current - previous);
+		record.phaseMicros[i] = micros < UINT32_MAX ? (uint32_t)micros : UINT32_MAX - 1;
+		previous = current;
+	}
+	record.bytes = traceTicksToMicros(at[(int)TracePhase::LastByteSent] - at[(int)TracePhase::FirstByte]);
+
+	record.textLength = (uint8_t)(trace.urlLength < sizeof(record.text) ? trace.urlLength : sizeof(record.text));
+	std::memcpy(record.text, trace.url, record.textLength);
+	push(reactor, record);
+}
+
+uint64_t AccessLog::getDroppedCount() const
+{
+	uint64_t dropped = 0;
+	for (const auto& channel : m_channels)
+	{
+		dropped += channel->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+// Every sampleEvery-th record of each reactor is kept; the first one always is.
+bool AccessLog::isSampled(int reactor)
+{
+	if (m_channels.empty())
+	{
+		return false;
+	}
+	Channel& channel = *m_channels[reactor];
+	return channel.sampleCounter++ % (uint64_t)m_sampleEvery == 0;
+}
+
+void AccessLog::push(int reactor, AccessRecord& record)
+{
+	record.reactor = (uint16_t)reactor;
+	record.timeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+
+	Channel& channel = *m_channels[reactor];
+	if (!channel.ring.tryPush(record))
+	{
+		channel.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+
+// --- Writer thread ---
+
+void AccessLog::run()
+{
+	std::string batch;
+	while (true)
+	{
+		// Read the flag first, so the final pass sees everything pushed before stop.
+		bool running = m_running.load(std::memory_order_acquire);
+		bool drained = drain(batch);
+		if (!running && !drained)
+		{
+			break;
+		}
+		if (!drained)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(ACCESS_LOG_IDLE_WAIT_MS));
+		}
+	}
+}
+
+// Formats everything currently in the rings and writes it out in batches of
+// up to 64 KB. Returns false if there was nothing to do.
+bool AccessLog::drain(std::string& batch)
+{
+	const size_t batchLimit = 64 * 1024;
+	bool any = false;
+	AccessRecord record;
+
+	for (const auto& channel : m_channels)
+	{
+		while (channel->ring.tryPop(record))
+		{
+			format(record, batch);
+			any = true;
+			if (batch.length() >= batchLimit)
+			{
+				write(batch);
+				batch.clear();
+			}
+		}
+	}
+
+	uint64_t dropped = getDroppedCount();
+	if (dropped != m_reportedDropped)
+	{
+		int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		appendTimestamp(now, batch);
+		batch.append("access log: ").append(std::to_string(dropped - m_reportedDropped)).append(" records dropped, ring full\n");
+		m_reportedDropped = dropped;
+		any = true;
+	}
+
+	if (!batch.empty())
+	{
+		write(batch);
+		batch.clear();
+	}
+	if (any && m_file)
+	{
+		fflush(m_file);
+	}
+	return any;
+}
+
+static void appendNumber(std::string& out, uint64_t value)
+{
+	char digits[24];
+	auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+	out.append(digits, end - digits);
+}
+
+void AccessLog::appendTimestamp(int64_t timeMicros, std::string& out)
+{
+	time_t second = (time_t)(timeMicros / 1000000);
+	if (second != m_formattedSecond)
+	{
+		std::tm tm_buf;
+		toLocalTime(second, tm_buf);
+		m_formattedLength = strftime(m_formattedTime, sizeof(m_formattedTime), "%Y-%m-%d %H:%M:%S", &tm_buf);
+		m_formattedSecond = second;
+	}
+
+	char millis[5] = { '.', '0', '0', '0', 0 };
+	int value = (int)(timeMicros / 1000 % 1000);
+	millis[1] = (char)('0' + value / 100);
+	millis[2] = (char)('0' + value / 10 % 10);
+	millis[3] = (char)('0' + value % 10);
+
+	out.append("[").append(m_formattedTime, m_formattedLength).append(millis, 4).append("] ");
+}
+
+// One line per record, e.g.
+//   [2026-10-17 02:56:07.123] #0 GET /home -> 200 OK, 1234 bytes
+//   [2026-10-17 02:56:07.125] #0 socket 12 connected from 127.0.0.1:50312
+void AccessLog::format(const AccessRecord& record, std::string& out)
+{
+	appendTimestamp(record.timeMicros, out);
+	out.append("#");
+	appendNumber(out, record.reactor);
+	out.append(" ");
+
+	std::string_view text(record.text, record.textLength);
+	if (record.event == AccessEvent::Request)
+	{
+		HttpStatusCode status = (HttpStatusCode)record.status;
+		out.append(httpMethodToString((HttpMethod)record.method)).append(" ").append(text).append(" -> ");
+		appendNumber(out, record.status);
+		out.append(" ").append(getReasonPhrase(status)).append(", ");
+		appendNumber(out, record.bytes);
+		out.append(" bytes\n");
+		return;
+	}
+	if (record.event == AccessEvent::Slow)
+	{
+		formatSlowRequest(record, out);
+		return;
+	}
+
+	out.append("socket ");
+	appendNumber(out, record.socket);
+	switch (record.event)
+	{
+	case AccessEvent::Connect:
+		out.append(" connected");
+		if (record.peerAddress != 0)
+		{
+			const uint8_t* octets = (const uint8_t*)&record.peerAddress;
+			out.append(" from ");
+			for (int i = 0; i < 4; i++)
+			{
+				appendNumber(out, octets[i]);
+				out.append(i < 3 ? "." : ":");
+			}
+			appendNumber(out, record.peerPort);
+		}
+		break;
+	case AccessEvent::Close:
+		out.append(" closed");
+		break;
+	case AccessEvent::Timeout:
+		out.append(" timed out (").append(text).append(")");
+		break;
+	case AccessEvent::Rejected:
+		out.append(" rejected: too many connections");
+		break;
+	default:
+		break;
+	}
+	out.append("\n");
+}
+
+// e.g. slow GET /file/a.txt -> 200 OK, 5210 us: receive 40, queue 12, handler 5100, send wait 8, send 50 (socket 12)
+// A connection's first request also shows how long after accept() it began.
+void AccessLog::formatSlowRequest(const AccessRecord& record, std::string& out)
+{
+	static const char* const INTERVALS[TRACE_INTERVAL_COUNT] = { "after accept", "receive", "queue", "handler", "send wait", "send" };
+
+	HttpStatusCode status = (HttpStatusCode)record.status;
+	out.append("slow ").append(httpMethodToString((HttpMethod)record.method)).append(" ");
+	out.append(record.text, record.textLength).append(" -> ");
+	appendNumber(out, record.status);
+	out.append(" ").append(getReasonPhrase(status)).append(", ");
+	appendNumber(out, record.bytes);
+	out.append(" us:");
+
+	const char* separator = " ";
+	for (int i = 1; i < TRACE_INTERVAL_COUNT; i++)
+	{
+		if (record.phaseMicros[i] != UINT32_MAX)
+		{
+			out.append(separator).append(INTERVALS[i]).append(" ");
+			appendNumber(out, record.phaseMicros[i]);
+			separator = ", ";
+		}
+	}
+	out.append(" (socket ");
+	appendNumber(out, record.socket);
+	if (record.phaseMicros[0] != UINT32_MAX)
+	{
+		out.append(", ");
+		appendNumber(out, record.phaseMicros[0]);
+		out.append(" us ").append(INTERVALS[0]);
+	}
+	out.append(")\n");
+}
+
+void AccessLog::write(const std::string& batch)
+{
+	if (m_fileBytes + batch.length() > m_maxFileBytes && m_fileBytes > 0)
+	{
+		rotate();
+	}
+	if (m_file && fwrite(batch.data(), 1, batch.length(), m_file) == batch.length())
+	{
+		m_fileBytes += batch.length();
+	}
+}
+
+bool AccessLog::openFile()
+{
+	m_file = fopen(m_path.c_str(), "ab");
+	if (!m_file)
+	{
+		return false;
+	}
+	fseek(m_file, 0, SEEK_END);
+	long size = ftell(m_file);
+	m_fileBytes = size > 0 ? (uint64_t)size : 0;
+	return true;
+}
+
+// access.log becomes access.log.1, access.log.1 becomes access.log.2, and so
+// on; the oldest is deleted.
+void AccessLog::rotate()
+{
+	fclose(m_file);
+	m_file = nullptr;
+
+	std::remove((m_path + "." + std::to_string(ACCESS_LOG_ROTATED_FILES)).c_str());
+	for (int i = ACCESS_LOG_ROTATED_FILES - 1; i >= 1; i--)
+	{
+		std::rename((m_path + "." + std::to_string(i)).c_str(), (m_path + "." + std::to_string(i + 1)).c_str());
+	}
+	std::rename(m_path.c_str(), (m_path + ".1").c_str());
+
+	if (!openFile())
+	{
+		std::cout << "Server: Could not reopen the access log " << m_path << "." << std::endl;
+	}
+}
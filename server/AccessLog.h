@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "RequestTrace.h"
+#include "SpscRing.h"
+#include "http/HttpRequest.h"
+#include "http/HttpStatusCodes.h"
+
+const size_t ACCESS_LOG_RING_CAPACITY = 4096; // Records buffered per reactor before new ones are dropped
+const int ACCESS_LOG_ROTATED_FILES = 4;       // access.log.1 ... access.log.4 are kept
+const int ACCESS_LOG_IDLE_WAIT_MS = 20;       // How long the writer sleeps when every ring is empty
+const uint64_t DEFAULT_ACCESS_LOG_MAX_BYTES = 64ull * 1024 * 1024;
+
+// What an access log record describes.
+enum class AccessEvent : uint8_t
+{
+	Request,
+	Connect,
+	Close,
+	Timeout,
+	Rejected, // Closed straight after accept(): the connection limit was reached
+	Slow      // A traced request that took longer than the threshold
+};
+
+// Intervals between consecutive TracePhases, as a slow request record keeps them.
+const int TRACE_INTERVAL_COUNT = (int)TracePhase::Count - 1;
+
+// One log entry. Fixed-size and trivially copyable, so a reactor logs with a
+// copy into a ring slot: no allocation, formatting or I/O on its thread.
+struct AccessRecord
+{
+	int64_t timeMicros;   // Wall clock, since the Unix epoch
+	uint64_t socket;
+	uint64_t bytes;       // Request: response body bytes (0 for streamed bodies); Slow: total microseconds
+	uint32_t peerAddress; // Connect: IPv4 address in network byte order, 0 if unknown
+	uint32_t phaseMicros[TRACE_INTERVAL_COUNT]; // Slow: time from the previous phase reached to each one; UINT32_MAX if skipped
+	uint16_t peerPort;    // Connect: host byte order
+	uint16_t status;
+	uint16_t reactor;
+	AccessEvent event;
+	uint8_t method;       // HttpMethod
+	uint8_t textLength;
+	char text[195];       // Request, Slow: the URL, truncated; Timeout: the phase that expired
+};
+static_assert(sizeof(AccessRecord) == 256, "AccessRecord should fill exactly four cache lines");
+
+// Structured access log. Each reactor pushes records into its own SPSC ring;
+// a background thread drains the rings, formats the records and appends them
+// to the file in batches, rotating it once it reaches its size limit. A full
+// ring drops the record and counts it instead of stalling the reactor.
+class AccessLog
+{
+public:
+	// An empty path disables the log. One record in sampleEvery is kept.
+	AccessLog(const std::string& path, int reactorCount, int sampleEvery, uint64_t maxFileBytes);
+
+	// Stops the writer after it has drained every ring.
+	~AccessLog();
+
+	// Opens the file and starts the writer thread.
+	bool start();
+
+	// Producer side: reactor i calls these only from its own thread.
+	void logRequest(int reactor, const HttpRequest& request, HttpStatusCode status, uint64_t bytes);
+	void logConnection(int reactor, AccessEvent event, uint64_t socket, uint32_t peerAddress = 0, uint16_t peerPort = 0, std::string_view detail = {});
+
+	// Used on the slow request log: the phase breakdown of a traced request.
+	void logSlowRequest(int reactor, uint64_t socket, const RequestTrace& trace);
+
+	// Records lost to full rings, across all reactors.
+	uint64_t getDroppedCount() const;
+
+private:
+	struct Channel
+	{
+		explicit Channel(size_t capacity) : ring(capacity) {}
+
+		SpscRing<AccessRecord> ring;
+		uint64_t sampleCounter = 0; // Producer only
+		std::atomic<uint64_t> dropped{ 0 };
+	};
+
+	bool isSampled(int reactor);
+	void push(int reactor, AccessRecord& record);
+
+	// Writer thread.
+	void run();
+	bool drain(std::string& batch);
+	void format(const AccessRecord& record, std::string& out);
+	void formatSlowRequest(const AccessRecord& record, std::string& out);
+	void appendTimestamp(int64_t timeMicros, std::string& out);
+	void write(const std::string& batch);
+	bool openFile();
+	void rotate();
+
+	std::string m_path;
+	int m_sampleEvery;
+	uint64_t m_maxFileBytes;
+	std::vector<std::unique_ptr<Channel>> m_channels;
+
+	std::thread m_thread;
+	std::atomic<bool> m_running{ false };
+	FILE* m_file = nullptr;
+	uint64_t m_fileBytes = 0;
+	uint64_t m_reportedDropped = 0;
+
+	// The local date and time of m_formattedSecond, rendered once per second.
+	time_t m_formattedSecond = -1;
+	char m_formattedTime[32] = {};
+	size_t m_formattedLength = 0;
+};
@@ -0,0 +1,150 @@
+#include "ConnectionPool.h"
+
+ConnectionPool::ConnectionPool(int maxConnections) : m_maxConnections(maxConnections > 0 ? maxConnections : 1)
+{
+}
+
+int ConnectionPool::acquire()
+{
+	if (m_freeList.empty() && !grow())
+	{
+		return -1;
+	}
+
+	int index = m_freeList.back();
+	m_freeList.pop_back();
+	m_activeCount++;
+	return index;
+}
+
+void ConnectionPool::release(int index)
+{
+	SocketState& socket = get(index);
+
+	socket.id = 0;
+	socket.status = SocketStatus::EMPTY;
+	socket.generation++;
+	socket.sendSegment = 0;
+	socket.segmentOffset = 0;
+	socket.bytesSent = 0;
+	socket.bytesToSend = 0;
+	socket.bytesReceived = 0;
+	socket.sendsInFlight = 0;
+	socket.parseOffset = 0;
+	socket.readPending = false;
+	socket.closeAfterSend = false;
+	socket.requestInFlight = false;
+	socket.requestStartNs = 0;
+	socket.trace = RequestTimes();
+	socket.sentTrace = 0;
+	socket.timeoutKind = TimeoutKind::None; // The owner cancels the timer before releasing the slot
+
+	// Give the buffers back to the allocator; an empty slot should cost no more than its struct.
+	std::string().swap(socket.messageData);
+	std::string().swap(socket.receiveBacklog);
+	std::string().swap(socket.responseData);
+	std::vector<SendSegment>().swap(socket.sendQueue);
+	std::vector<char>().swap(socket.fileChunk);
+	std::vector<RequestTrace>().swap(socket.sendTraces);
+	detachRequestState(index);
+
+	m_freeList.push_back(index);
+	m_activeCount--;
+}
+
+void ConnectionPool::attachRequestState(int index)
+{
+	SocketState& socket = get(index);
+	if (socket.requestState)
+	{
+		return;
+	}
+
+	if (m_spareRequestStates.empty())
+	{
+		socket.requestState.reset(new RequestState());
+		return;
+	}
+	socket.requestState = std::move(m_spareRequestStates.back());
+	m_spareRequestStates.pop_back();
+}
+
+void ConnectionPool::detachRequestState(int index)
+{
+	SocketState& socket = get(index);
+	if (!socket.requestState)
+	{
+		return;
+	}
+
+	RequestState& state = *socket.requestState;
+	state.request.clear();
+
+	// Dropping an unfinished upload's sink discards its partial file.
+	state.bodyMode = BodyMode::Unchecked;
+	state.bodySink.reset();
+	std::string().swap(state.requestBody);
+	state.chunkedDecoder.reset();
+	state.bodyBytesRead = 0;
+
+	if (m_spareRequestStates.size() < (size_t)SLAB_SIZE)
+	{
+		m_spareRequestStates.push_back(std::move(socket.requestState));
+	}
+	else
+	{
+		socket.requestState.reset();
+	}
+}
+
+ConnectionHandle ConnectionPool::getHandle(int index) const
+{
+	ConnectionHandle handle;
+	handle.index = index;
+	handle.generation = get(index).generation;
+	return handle;
+}
+
+bool ConnectionPool::isValid(const ConnectionHandle& handle) const
+{
+	return handle.index >= 0 && handle.index < m_capacity &&
+		get(handle.index).generation == handle.generation &&
+		get(handle.index).status != SocketStatus::EMPTY;
+}
+
+size_t ConnectionPool::getIdleConnectionBytes()
+{
+	// The slot itself plus its free-list entry, which stays reserved once the slab exists.
+	return sizeof(SocketState) + sizeof(int);
+}
+
+size_t ConnectionPool::getActiveRequestBytes()
+{
+	return sizeof(RequestState);
+}
+
+size_t ConnectionPool::getReservedBytes() const
+{
+	return (size_t)m_capacity * sizeof(SocketState) + m_freeList.capacity() * sizeof(int) +
+		m_spareRequestStates.size() * sizeof(RequestState);
+}
+
+bool ConnectionPool::grow()
+{
+	if (m_capacity >= m_maxConnections)
+	{
+		return false;
+	}
+
+	int slabSize = m_maxConnections - m_capacity < SLAB_SIZE ? m_maxConnections - m_capacity : SLAB_SIZE;
+	m_slabs.emplace_back(new SocketState[slabSize]);
+
+	// Pushed in reverse so the lowest index is handed out first.
+	for (int i = m_capacity + slabSize - 1; i >= m_capacity; i--)
+	{
+		m_freeList.push_back(i);
+		get(i).timer.owner = i;
+	}
+	m_capacity += slabSize;
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "SocketData.h"
+
+const int DEFAULT_MAX_CONNECTIONS = 100000;
+
+// A slot index plus the generation it was issued for. The generation changes
+// every time the slot is released, so a handle kept past the connection's
+// lifetime (or an event queued for it) is recognised as stale instead of
+// being applied to whichever connection reuses the slot.
+struct ConnectionHandle
+{
+    int index = -1;
+    uint32_t generation = 0;
+};
+
+// Connection table that grows in slabs of SLAB_SIZE up to a configured limit;
+// only the last slab is cut short to fit the limit.
+// Slabs are never moved or freed while the pool lives, so SocketState
+// references stay valid; free slots are kept on a LIFO list so acquire and
+// release are O(1) and recently used (cache-warm) slots are handed out first.
+class ConnectionPool
+{
+public:
+    static constexpr int SLAB_SIZE = 256;
+
+    explicit ConnectionPool(int maxConnections);
+
+    // Returns a free slot, growing by one slab if needed, or -1 when the limit is reached.
+    int acquire();
+
+    // Resets the slot, drops its buffers and invalidates outstanding handles.
+    void release(int index);
+
+    // Gives the connection the parser and body state for a request, from a
+    // list of spares when one is free. detachRequestState() resets it and
+    // takes it back once the connection has nothing left to parse.
+    void attachRequestState(int index);
+    void detachRequestState(int index);
+
+    SocketState& get(int index) { return m_slabs[index / SLAB_SIZE][index % SLAB_SIZE]; }
+    const SocketState& get(int index) const { return m_slabs[index / SLAB_SIZE][index % SLAB_SIZE]; }
+
+    ConnectionHandle getHandle(int index) const;
+    bool isValid(const ConnectionHandle& handle) const;
+
+    int getActiveCount() const { return m_activeCount; }
+    int getCapacity() const { return m_capacity; }
+    int getMaxConnections() const { return m_maxConnections; }
+
+    // Fixed cost of one connection that holds no request or response data.
+    static size_t getIdleConnectionBytes();
+
+    // Added for as long as a connection has a request in progress.
+    static size_t getActiveRequestBytes();
+
+    // Bytes reserved by the allocated slabs, the free list and the spare request states.
+    size_t getReservedBytes() const;
+
+private:
+    bool grow();
+
+    int m_maxConnections;
+    int m_capacity = 0;
+    int m_activeCount = 0;
+    std::vector<std::unique_ptr<SocketState[]>> m_slabs;
+    std::vector<int> m_freeList;
+
+    // Request states given back by connections that went idle, kept for
+    // reuse up to SLAB_SIZE so a burst does not pin its peak for good.
+    std::vector<std::unique_ptr<RequestState>> m_spareRequestStates;
+};
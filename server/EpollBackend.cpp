@@ -0,0 +1,99 @@
+#ifdef __linux__
+
+#include "EpollBackend.h"
+#include <iostream>
+
+EpollBackend::~EpollBackend()
+{
+	if (m_epollFd != -1)
+	{
+		close(m_epollFd);
+	}
+}
+
+bool EpollBackend::init(int maxSockets)
+{
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epollFd == -1)
+	{
+		std::cout << "Server: Error at epoll_create1(): " << errno << std::endl;
+		return false;
+	}
+
+	m_readyEvents.resize(maxSockets < MAX_EVENTS_PER_WAIT ? maxSockets : MAX_EVENTS_PER_WAIT);
+	return true;
+}
+
+bool EpollBackend::addSocket(SOCKET id, int socketIndex, uint32_t generation, bool)
+{
+	epoll_event event = {};
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.u64 = ((uint64_t)generation << 32) | (uint32_t)socketIndex;
+
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, id, &event) == -1)
+	{
+		std::cout << "Server: Error at epoll_ctl(ADD): " << errno << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void EpollBackend::removeSocket(SOCKET id, int)
+{
+	// Closing the descriptor would drop it from the interest list as well, but
+	// only once every duplicate is closed, so remove it explicitly.
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, id, nullptr);
+}
+
+bool EpollBackend::setWakeupEvent(int fd)
+{
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.u64 = WAKEUP_EVENT_DATA;
+
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == -1)
+	{
+		std::cout << "Server: Error at epoll_ctl(ADD): " << errno << std::endl;
+		return false;
+	}
+	m_wakeupFd = fd;
+	return true;
+}
+
+int EpollBackend::wait(std::vector<IoEvent>& events, int timeoutMs)
+{
+	events.clear();
+
+	int count = epoll_wait(m_epollFd, m_readyEvents.data(), (int)m_readyEvents.size(), timeoutMs);
+	if (count == -1)
+	{
+		if (errno == EINTR)
+		{
+			return 0;
+		}
+		std::cout << "Server: Error at epoll_wait(): " << errno << std::endl;
+		return SOCKET_ERROR;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		const epoll_event& ready = m_readyEvents[i];
+		if (ready.data.u64 == WAKEUP_EVENT_DATA)
+		{
+			clearWakeupEvent(m_wakeupFd);
+			continue;
+		}
+
+		IoEvent event;
+		event.socketIndex = (int)(uint32_t)ready.data.u64;
+		event.generation = (uint32_t)(ready.data.u64 >> 32);
+		// Errors and hang-ups surface through the next recv(), so report them as readable.
+		event.readable = (ready.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+		event.writable = (ready.events & EPOLLOUT) != 0;
+		events.push_back(event);
+	}
+
+	return (int)events.size();
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <vector>
+#include <sys/epoll.h>
+#include "IEventBackend.h"
+
+// Edge-triggered epoll backend. Every socket is registered once for both
+// directions; a wakeup costs O(ready sockets) and the caller drains each
+// ready socket until it would block.
+class EpollBackend final : public IEventBackend {
+public:
+    EpollBackend() = default;
+    ~EpollBackend() override;
+
+    bool init(int maxSockets) override;
+    bool addSocket(SOCKET id, int socketIndex, uint32_t generation, bool isListener) override;
+    void setInterest(SOCKET, int, bool, bool) override {}
+    void removeSocket(SOCKET id, int socketIndex) override;
+    int wait(std::vector<IoEvent>& events, int timeoutMs) override;
+    bool isEdgeTriggered() const override { return true; }
+    bool setWakeupEvent(int fd) override;
+    const char* getName() const override { return "epoll"; }
+
+private:
+    static constexpr int MAX_EVENTS_PER_WAIT = 256;
+    static constexpr uint64_t WAKEUP_EVENT_DATA = ~0ull; // Never a slot: socket indexes are below 2^31
+
+    int m_epollFd = -1;
+    int m_wakeupFd = -1;
+    std::vector<epoll_event> m_readyEvents;
+};
+
+#endif
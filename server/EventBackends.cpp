@@ -0,0 +1,56 @@
+#include "IEventBackend.h"
+#include "SelectBackend.h"
+#include "EpollBackend.h"
+#include "IoUringBackend.h"
+
+std::unique_ptr<IEventBackend> createEventBackend(EventBackendType type)
+{
+	switch (type)
+	{
+#ifdef __linux__
+	case EventBackendType::Epoll:
+		return std::make_unique<EpollBackend>();
+#endif
+#ifdef HAVE_IO_URING
+	case EventBackendType::IoUring:
+		return std::make_unique<IoUringBackend>();
+#endif
+	case EventBackendType::Select:
+		return std::make_unique<SelectBackend>();
+	default:
+		return nullptr;
+	}
+}
+
+EventBackendType getDefaultEventBackend()
+{
+#ifdef __linux__
+	return EventBackendType::Epoll;
+#else
+	return EventBackendType::Select;
+#endif
+}
+
+bool eventBackendFromString(const std::string& name, EventBackendType& type)
+{
+	if (name == "select")
+	{
+		type = EventBackendType::Select;
+		return true;
+	}
+#ifdef __linux__
+	if (name == "epoll")
+	{
+		type = EventBackendType::Epoll;
+		return true;
+	}
+#endif
+#ifdef HAVE_IO_URING
+	if (name == "io_uring")
+	{
+		type = EventBackendType::IoUring;
+		return true;
+	}
+#endif
+	return false;
+}
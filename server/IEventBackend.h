@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Platform.h"
+
+// The I/O engines SocketManager can run on.
+enum class EventBackendType {
+    Select,
+    Epoll,
+    IoUring
+};
+
+// What a completion-based backend finished on behalf of a socket.
+enum class IoCompletion {
+    None,
+    Accepted,
+    Received,
+    Sent,
+    Closed
+};
+
+// A single notification for one registered socket.
+struct IoEvent
+{
+    int socketIndex = -1;
+    uint32_t generation = 0; // The slot generation passed to addSocket()
+    bool readable = false;
+    bool writable = false;
+
+    // Completion-based backends perform the I/O themselves and report
+    // what finished rather than what is ready.
+    IoCompletion completion = IoCompletion::None;
+    SOCKET acceptedSocket = INVALID_SOCKET;
+    const char* data = nullptr; // Received bytes, valid until the next wait()
+    int result = 0;             // Byte count for Received/Sent
+};
+
+// A span of bytes handed to a completion-based send.
+struct IoBuffer
+{
+    const char* data;
+    int length;
+};
+
+// Abstracts the OS I/O API (select, epoll, io_uring) away from SocketManager.
+// Sockets are identified by their slot index in the connection table, so a wakeup
+// hands back exactly the slots that have work instead of the whole table.
+class IEventBackend {
+public:
+    virtual bool init(int maxSockets) = 0;
+
+    // Starts watching a socket. The initial interest is read-only. Every event
+    // for the socket carries the generation back, so events that were already
+    // queued when the slot changed hands can be told apart from fresh ones.
+    virtual bool addSocket(SOCKET id, int socketIndex, uint32_t generation, bool isListener) = 0;
+
+    // Updates which directions a socket is watched for. Edge-triggered backends
+    // watch both directions for the lifetime of the socket and may ignore this.
+    virtual void setInterest(SOCKET id, int socketIndex, bool wantRead, bool wantWrite) = 0;
+
+    virtual void removeSocket(SOCKET id, int socketIndex) = 0;
+
+    // Blocks for at most timeoutMs and fills events with the ready sockets.
+    // Returns the number of events, or SOCKET_ERROR on failure.
+    virtual int wait(std::vector<IoEvent>& events, int timeoutMs) = 0;
+
+    // Edge-triggered backends only report transitions, so callers must drain
+    // recv/accept/send until they would block.
+    virtual bool isEdgeTriggered() const = 0;
+
+    // Completion-based backends accept, receive and send on their own and
+    // report the results through IoEvent::completion.
+    virtual bool isCompletionBased() const { return false; }
+
+    // Queues the buffers as linked sends, in order. Only completion-based backends implement this.
+    virtual bool submitSend(SOCKET, int, const IoBuffer*, int) { return false; }
+
+    // Watches fd (from createWakeupEvent()) so that another thread signalling
+    // it cuts wait() short. The backend clears the signal itself and reports
+    // no event for it. Returns false if the backend cannot watch it.
+    virtual bool setWakeupEvent(int) { return false; }
+
+    virtual const char* getName() const = 0;
+
+    virtual ~IEventBackend() = default;
+};
+
+std::unique_ptr<IEventBackend> createEventBackend(EventBackendType type);
+
+// The best backend available on this platform.
+EventBackendType getDefaultEventBackend();
+
+// Parses a backend name ("select", "epoll", "io_uring"). Returns false for unknown or unsupported names.
+bool eventBackendFromString(const std::string& name, EventBackendType& type);
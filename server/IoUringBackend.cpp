@@ -0,0 +1,518 @@
+#include "IoUringBackend.h"
+
+#ifdef HAVE_IO_URING
+
+#include <iostream>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int ioUringSetup(unsigned entries, io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize)
+{
+	return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int ioUringRegister(int ringFd, unsigned opcode, void* arg, unsigned argCount)
+{
+	return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, argCount);
+}
+
+IoUringBackend::~IoUringBackend()
+{
+	if (m_bufferRing)
+	{
+		munmap(m_bufferRing, m_bufferRingSize);
+	}
+	if (m_sqes)
+	{
+		munmap(m_sqes, m_sqesSize);
+	}
+	if (m_cqRing && m_cqRing != m_sqRing)
+	{
+		munmap(m_cqRing, m_cqRingSize);
+	}
+	if (m_sqRing)
+	{
+		munmap(m_sqRing, m_sqRingSize);
+	}
+	if (m_ringFd != -1)
+	{
+		close(m_ringFd);
+	}
+}
+
+bool IoUringBackend::init(int maxSockets)
+{
+	m_socketIds.assign(maxSockets, INVALID_SOCKET);
+	m_generations.assign(maxSockets, 0);
+	m_receiveFlags.assign(maxSockets, 0);
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = QUEUE_DEPTH * 4;
+
+	m_ringFd = ioUringSetup(QUEUE_DEPTH, &params);
+	if (m_ringFd < 0)
+	{
+		std::cout << "Server: Error at io_uring_setup(): " << errno << std::endl;
+		return false;
+	}
+
+	// EXT_ARG (5.11) gives io_uring_enter() a timeout; provided buffer rings need 5.19.
+	if (!(params.features & IORING_FEAT_EXT_ARG))
+	{
+		std::cout << "Server: Kernel io_uring lacks IORING_FEAT_EXT_ARG." << std::endl;
+		return false;
+	}
+
+	m_sqEntries = params.sq_entries;
+	m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMmap)
+	{
+		m_sqRingSize = m_cqRingSize = (m_sqRingSize > m_cqRingSize ? m_sqRingSize : m_cqRingSize);
+	}
+
+	m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+	if (m_sqRing == MAP_FAILED)
+	{
+		m_sqRing = nullptr;
+		std::cout << "Server: Error mapping the io_uring submission queue: " << errno << std::endl;
+		return false;
+	}
+
+	m_cqRing = m_sqRing;
+	if (!singleMmap)
+	{
+		m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+		if (m_cqRing == MAP_FAILED)
+		{
+			m_cqRing = nullptr;
+			std::cout << "Server: Error mapping the io_uring completion queue: " << errno << std::endl;
+			return false;
+		}
+	}
+
+	m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+	if (m_sqes == MAP_FAILED)
+	{
+		m_sqes = nullptr;
+		std::cout << "Server: Error mapping the io_uring SQE array: " << errno << std::endl;
+		return false;
+	}
+
+	char* sq = (char*)m_sqRing;
+	m_sqHead = (unsigned*)(sq + params.sq_off.head);
+	m_sqTail = (unsigned*)(sq + params.sq_off.tail);
+	m_sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+	m_sqArray = (unsigned*)(sq + params.sq_off.array);
+	m_sqLocalTail = *m_sqTail;
+
+	char* cq = (char*)m_cqRing;
+	m_cqHead = (unsigned*)(cq + params.cq_off.head);
+	m_cqTail = (unsigned*)(cq + params.cq_off.tail);
+	m_cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+	m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	// Register the provided buffer ring that multishot recv picks buffers from.
+	m_bufferRingSize = PROVIDED_BUFFER_COUNT * sizeof(io_uring_buf);
+	void* ringMemory = mmap(nullptr, m_bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ringMemory == MAP_FAILED)
+	{
+		std::cout << "Server: Error allocating the io_uring buffer ring: " << errno << std::endl;
+		return false;
+	}
+	m_bufferRing = (io_uring_buf*)ringMemory;
+
+	io_uring_buf_reg registration;
+	memset(&registration, 0, sizeof(registration));
+	registration.ring_addr = (uint64_t)(uintptr_t)m_bufferRing;
+	registration.ring_entries = PROVIDED_BUFFER_COUNT;
+	registration.bgid = BUFFER_GROUP_ID;
+	if (ioUringRegister(m_ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) != 0)
+	{
+		std::cout << "Server: Error registering the io_uring buffer ring: " << errno << std::endl;
+		return false;
+	}
+
+	m_bufferPool.resize((size_t)PROVIDED_BUFFER_COUNT * PROVIDED_BUFFER_SIZE);
+	m_bufferRingTail = 0;
+	for (unsigned i = 0; i < PROVIDED_BUFFER_COUNT; i++)
+	{
+		provideBuffer((uint16_t)i);
+	}
+	publishBuffers();
+
+	return true;
+}
+
+bool IoUringBackend::addSocket(SOCKET id, int socketIndex, uint32_t generation, bool isListener)
+{
+	if (socketIndex >= (int)m_socketIds.size())
+	{
+		m_socketIds.resize(socketIndex + 1, INVALID_SOCKET);
+		m_generations.resize(socketIndex + 1, 0);
+		m_receiveFlags.resize(socketIndex + 1, 0);
+	}
+	m_socketIds[socketIndex] = id;
+	m_generations[socketIndex] = generation;
+	m_receiveFlags[socketIndex] = 0;
+
+	if (isListener)
+	{
+		armAccept(id, socketIndex);
+	}
+	else
+	{
+		armReceive(id, socketIndex);
+	}
+	return true;
+}
+
+void IoUringBackend::removeSocket(SOCKET, int socketIndex)
+{
+	if (socketIndex < 0 || socketIndex >= (int)m_socketIds.size())
+	{
+		return;
+	}
+
+	if (m_receiveFlags[socketIndex] & RECEIVE_ARMED)
+	{
+		cancelReceive(socketIndex);
+	}
+
+	m_socketIds[socketIndex] = INVALID_SOCKET;
+	m_generations[socketIndex]++;
+	m_receiveFlags[socketIndex] = 0;
+}
+
+// Pausing cancels the multishot recv, so input that arrives meanwhile stays in
+// the socket's receive buffer and TCP flow control holds the client back.
+// The recv is armed again once reads are wanted and the old one has ended.
+void IoUringBackend::setInterest(SOCKET id, int socketIndex, bool wantRead, bool)
+{
+	if (socketIndex < 0 || socketIndex >= (int)m_socketIds.size() || m_socketIds[socketIndex] == INVALID_SOCKET)
+	{
+		return;
+	}
+
+	uint8_t& flags = m_receiveFlags[socketIndex];
+	if (wantRead)
+	{
+		flags &= ~RECEIVE_PAUSED;
+		// A recv that is still being cancelled is re-armed by its final completion.
+		if (!(flags & RECEIVE_ARMED))
+		{
+			armReceive(id, socketIndex);
+		}
+	}
+	else
+	{
+		flags |= RECEIVE_PAUSED;
+		if ((flags & RECEIVE_ARMED) && !(flags & RECEIVE_CANCELLING))
+		{
+			cancelReceive(socketIndex);
+			flags |= RECEIVE_CANCELLING;
+		}
+	}
+}
+
+bool IoUringBackend::submitSend(SOCKET id, int socketIndex, const IoBuffer* buffers, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		io_uring_sqe* sqe = getSqe();
+		if (!sqe)
+		{
+			return false;
+		}
+
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = id;
+		sqe->addr = (uint64_t)(uintptr_t)buffers[i].data;
+		sqe->len = buffers[i].length;
+		// MSG_WAITALL makes the kernel retry short sends, so one SQE covers the whole buffer.
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		// Link the buffers so they reach the socket in order.
+		sqe->flags = (i + 1 < count) ? IOSQE_IO_LINK : 0;
+		sqe->user_data = makeUserData(OP_SEND, socketIndex);
+	}
+	return true;
+}
+
+bool IoUringBackend::setWakeupEvent(int fd)
+{
+	m_wakeupFd = fd;
+	armWakeup();
+	return true;
+}
+
+int IoUringBackend::wait(std::vector<IoEvent>& events, int timeoutMs)
+{
+	events.clear();
+
+	// Buffers handed out by the previous wait() have been copied by now.
+	recycleBuffers();
+
+	__kernel_timespec timeout;
+	io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	if (timeoutMs >= 0)
+	{
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_nsec = (long long)(timeoutMs % 1000) * 1000000;
+		arg.ts = (uint64_t)(uintptr_t)&timeout;
+	}
+
+	unsigned toSubmit = m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+	bool completionsReady = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) != *m_cqHead;
+	unsigned minComplete = completionsReady ? 0 : 1;
+
+	int ret = ioUringEnter(m_ringFd, toSubmit, minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+	{
+		std::cout << "Server: Error at io_uring_enter(): " << errno << std::endl;
+		return SOCKET_ERROR;
+	}
+
+	unsigned head = *m_cqHead;
+	unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++)
+	{
+		const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+		Operation op = (Operation)(cqe.user_data >> 56);
+		uint32_t generation = (uint32_t)((cqe.user_data >> 32) & 0xFFFFFF);
+		int socketIndex = (int)(uint32_t)cqe.user_data;
+		bool hasBuffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+		uint16_t bufferId = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+		bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+		if (hasBuffer)
+		{
+			m_buffersToRecycle.push_back(bufferId);
+		}
+
+		if (op == OP_WAKEUP)
+		{
+			clearWakeupEvent(m_wakeupFd);
+			armWakeup();
+			continue;
+		}
+
+		// Completions for a slot that has since been closed (and maybe reused) are dropped.
+		if (op == OP_CANCEL || socketIndex >= (int)m_generations.size() ||
+			generation != (m_generations[socketIndex] & 0xFFFFFF) || m_socketIds[socketIndex] == INVALID_SOCKET)
+		{
+			continue;
+		}
+
+		SOCKET id = m_socketIds[socketIndex];
+		IoEvent event;
+		event.socketIndex = socketIndex;
+		event.generation = m_generations[socketIndex];
+
+		if (op == OP_ACCEPT)
+		{
+			if (cqe.res >= 0)
+			{
+				event.completion = IoCompletion::Accepted;
+				event.acceptedSocket = cqe.res;
+				events.push_back(event);
+			}
+			else if (cqe.res != -EAGAIN && cqe.res != -ECANCELED)
+			{
+				std::cout << "Server: Error at accept(): " << -cqe.res << std::endl;
+			}
+			if (!more)
+			{
+				armAccept(id, socketIndex);
+			}
+		}
+		else if (op == OP_RECV)
+		{
+			if (!more)
+			{
+				m_receiveFlags[socketIndex] &= ~(RECEIVE_ARMED | RECEIVE_CANCELLING);
+			}
+
+			if (cqe.res > 0 && hasBuffer)
+			{
+				// Data that was already in flight when reads were paused is still delivered.
+				event.completion = IoCompletion::Received;
+				event.data = &m_bufferPool[(size_t)bufferId * PROVIDED_BUFFER_SIZE];
+				event.result = cqe.res;
+				events.push_back(event);
+			}
+			else if (cqe.res == 0 || (cqe.res < 0 && !more && cqe.res != -ENOBUFS && cqe.res != -ECANCELED))
+			{
+				if (cqe.res < 0 && cqe.res != -ECONNRESET)
+				{
+					std::cout << "Server: Error at recv(): " << -cqe.res << std::endl;
+				}
+				event.completion = IoCompletion::Closed;
+				events.push_back(event);
+				continue;
+			}
+
+			// The recv ended on its own, ran the ring dry (the buffers recycled on
+			// the next wait() refill it) or was cancelled by a pause since lifted.
+			if (!more && !(m_receiveFlags[socketIndex] & RECEIVE_PAUSED))
+			{
+				armReceive(id, socketIndex);
+			}
+		}
+		else if (op == OP_SEND)
+		{
+			if (cqe.res < 0)
+			{
+				if (cqe.res != -EPIPE && cqe.res != -ECONNRESET && cqe.res != -ECANCELED)
+				{
+					std::cout << "Server: Error at send(): " << -cqe.res << std::endl;
+				}
+				event.completion = IoCompletion::Closed;
+			}
+			else
+			{
+				event.completion = IoCompletion::Sent;
+				event.result = cqe.res;
+			}
+			events.push_back(event);
+		}
+	}
+
+	__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+	return (int)events.size();
+}
+
+io_uring_sqe* IoUringBackend::getSqe()
+{
+	unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+	if (m_sqLocalTail - head >= m_sqEntries)
+	{
+		// The queue is full: push what we have to the kernel without waiting.
+		ioUringEnter(m_ringFd, m_sqLocalTail - head, 0, 0, nullptr, 0);
+		head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+		if (m_sqLocalTail - head >= m_sqEntries)
+		{
+			std::cout << "Server: io_uring submission queue is full." << std::endl;
+			return nullptr;
+		}
+	}
+
+	unsigned index = m_sqLocalTail & *m_sqMask;
+	io_uring_sqe* sqe = &m_sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	m_sqArray[index] = index;
+	m_sqLocalTail++;
+	// Publishing the tail right away keeps the queue consistent if getSqe() has to flush it.
+	__atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+	return sqe;
+}
+
+void IoUringBackend::armAccept(SOCKET id, int socketIndex)
+{
+	io_uring_sqe* sqe = getSqe();
+	if (!sqe)
+	{
+		return;
+	}
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = id;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	sqe->user_data = makeUserData(OP_ACCEPT, socketIndex);
+}
+
+void IoUringBackend::armReceive(SOCKET id, int socketIndex)
+{
+	io_uring_sqe* sqe = getSqe();
+	if (!sqe)
+	{
+		return;
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = id;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUFFER_GROUP_ID;
+	sqe->user_data = makeUserData(OP_RECV, socketIndex);
+	m_receiveFlags[socketIndex] |= RECEIVE_ARMED;
+}
+
+// Cancels the multishot recv by its exact user_data; the descriptor number may
+// be reused before the cancel is submitted, so cancelling by fd is unsafe.
+void IoUringBackend::cancelReceive(int socketIndex)
+{
+	io_uring_sqe* sqe = getSqe();
+	if (!sqe)
+	{
+		return;
+	}
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = makeUserData(OP_RECV, socketIndex);
+	sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+	sqe->user_data = makeUserData(OP_CANCEL, socketIndex);
+}
+
+// A one-shot poll, re-armed after each signal: a read on the non-blocking
+// eventfd could complete with EAGAIN instead of waiting.
+void IoUringBackend::armWakeup()
+{
+	io_uring_sqe* sqe = getSqe();
+	if (!sqe)
+	{
+		return;
+	}
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = m_wakeupFd;
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = (uint64_t)OP_WAKEUP << 56;
+}
+
+void IoUringBackend::provideBuffer(uint16_t bufferId)
+{
+	io_uring_buf& entry = m_bufferRing[m_bufferRingTail & (PROVIDED_BUFFER_COUNT - 1)];
+	entry.addr = (uint64_t)(uintptr_t)&m_bufferPool[(size_t)bufferId * PROVIDED_BUFFER_SIZE];
+	entry.len = PROVIDED_BUFFER_SIZE;
+	entry.bid = bufferId;
+	m_bufferRingTail++;
+}
+
+void IoUringBackend::recycleBuffers()
+{
+	if (m_buffersToRecycle.empty())
+	{
+		return;
+	}
+	for (uint16_t bufferId : m_buffersToRecycle)
+	{
+		provideBuffer(bufferId);
+	}
+	m_buffersToRecycle.clear();
+	publishBuffers();
+}
+
+void IoUringBackend::publishBuffers()
+{
+	// The ring tail overlays the reserved field of the first entry.
+	__atomic_store_n(&m_bufferRing[0].resv, m_bufferRingTail, __ATOMIC_RELEASE);
+}
+
+uint64_t IoUringBackend::makeUserData(Operation op, int socketIndex) const
+{
+	uint64_t generation = m_generations[socketIndex] & 0xFFFFFF;
+	return (op << 56) | (generation << 32) | (uint32_t)socketIndex;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+#define HAVE_IO_URING 1
+
+#include <cstdint>
+#include <vector>
+#include <linux/io_uring.h>
+#include "IEventBackend.h"
+
+// Completion-based io_uring engine, driven through the raw syscalls so it has
+// no library dependency. The listener runs a multishot accept, every connection
+// runs a multishot recv into a kernel-provided buffer ring, and responses go out
+// as linked send submissions. A single io_uring_enter() per loop iteration
+// submits everything queued since the last one and reaps all completions.
+// setInterest() without read cancels the recv, so a connection that is sending
+// or processing leaves further input in the kernel, as the readiness backends do.
+class IoUringBackend final : public IEventBackend {
+public:
+    IoUringBackend() = default;
+    ~IoUringBackend() override;
+
+    bool init(int maxSockets) override;
+    bool addSocket(SOCKET id, int socketIndex, uint32_t generation, bool isListener) override;
+    void setInterest(SOCKET id, int socketIndex, bool wantRead, bool) override;
+    void removeSocket(SOCKET id, int socketIndex) override;
+    int wait(std::vector<IoEvent>& events, int timeoutMs) override;
+    bool isEdgeTriggered() const override { return true; }
+    bool isCompletionBased() const override { return true; }
+    bool submitSend(SOCKET id, int socketIndex, const IoBuffer* buffers, int count) override;
+    bool setWakeupEvent(int fd) override;
+    const char* getName() const override { return "io_uring"; }
+
+private:
+    enum Operation : uint64_t {
+        OP_ACCEPT = 1,
+        OP_RECV = 2,
+        OP_SEND = 3,
+        OP_CANCEL = 4,
+        OP_WAKEUP = 5
+    };
+
+    static constexpr unsigned QUEUE_DEPTH = 1024;
+    static constexpr unsigned PROVIDED_BUFFER_COUNT = 1024; // Must be a power of two
+    static constexpr unsigned PROVIDED_BUFFER_SIZE = 4096;
+    static constexpr uint16_t BUFFER_GROUP_ID = 0;
+
+    // Per-slot state of the multishot recv.
+    enum ReceiveFlags : uint8_t {
+        RECEIVE_ARMED = 1,      // A recv is in flight; its last completion lacks IORING_CQE_F_MORE
+        RECEIVE_CANCELLING = 2, // A cancel for it has been queued
+        RECEIVE_PAUSED = 4      // setInterest() turned reads off; the recv is not re-armed
+    };
+
+    io_uring_sqe* getSqe();
+    void armAccept(SOCKET id, int socketIndex);
+    void armReceive(SOCKET id, int socketIndex);
+    void cancelReceive(int socketIndex);
+    void armWakeup();
+    void provideBuffer(uint16_t bufferId);
+    void recycleBuffers();
+    void publishBuffers();
+    uint64_t makeUserData(Operation op, int socketIndex) const;
+
+    int m_ringFd = -1;
+    int m_wakeupFd = -1;
+
+    // Submission queue
+    void* m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqMask = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqEntries = 0;
+    unsigned m_sqLocalTail = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    // Completion queue
+    void* m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned* m_cqMask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+
+    // Provided buffer ring. Addressed as a plain io_uring_buf array: in C++ the
+    // header's flexible-array wrapper shifts io_uring_buf_ring::bufs by 8 bytes.
+    io_uring_buf* m_bufferRing = nullptr;
+    size_t m_bufferRingSize = 0;
+    uint16_t m_bufferRingTail = 0;
+    std::vector<char> m_bufferPool;
+    std::vector<uint16_t> m_buffersToRecycle;
+
+    // Per slot: the socket id and the generation it was registered with.
+    // removeSocket() bumps the generation straight away so completions still
+    // in flight are dropped even before the slot is reused.
+    std::vector<SOCKET> m_socketIds;
+    std::vector<uint32_t> m_generations;
+    std::vector<uint8_t> m_receiveFlags;
+};
+
+#endif
@@ -0,0 +1,361 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include "AccessLog.h"
+#include "http/FileCache.h"
+#include "http/Router.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Bucket bounds exported to Prometheus: powers of two from 1.024 us to 17.2 s.
+// They fall on octave boundaries, so each is an exact sum of fine buckets.
+static const int FIRST_EXPORTED_BIT = 10;
+static const int LAST_EXPORTED_BIT = 34;
+
+static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+static int findHighestBit(uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, word);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(word);
+#endif
+}
+
+int LatencyHistogram::getBucket(uint64_t nanoseconds)
+{
+	if (nanoseconds < LINEAR_BUCKETS)
+	{
+		return (int)nanoseconds;
+	}
+	int bit = findHighestBit(nanoseconds);
+	int bucket = LINEAR_BUCKETS + ((bit - 4) << SUB_BUCKET_BITS) +
+		(int)((nanoseconds >> (bit - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1));
+	return bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1;
+}
+
+uint64_t LatencyHistogram::getUpperBound(int bucket)
+{
+	if (bucket < LINEAR_BUCKETS)
+	{
+		return (uint64_t)bucket + 1;
+	}
+	int bit = 4 + ((bucket - LINEAR_BUCKETS) >> SUB_BUCKET_BITS);
+	uint64_t subBucket = (uint64_t)((bucket - LINEAR_BUCKETS) & ((1 << SUB_BUCKET_BITS) - 1));
+	return ((1ull << SUB_BUCKET_BITS) + subBucket + 1) << (bit - SUB_BUCKET_BITS);
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+	addSingleWriter(buckets[getBucket(nanoseconds)], 1);
+	addSingleWriter(sum, nanoseconds);
+}
+
+void ReactorMetrics::recordRequest(int route, HttpStatusCode status, uint64_t parseNs, uint64_t handlerNs, uint64_t totalNs)
+{
+	if (!m_routes)
+	{
+		return;
+	}
+	RouteMetrics& metrics = m_routes[route >= 0 && route < m_routeCount ? route : m_routeCount];
+	int slot = (int)status - FIRST_STATUS_CODE;
+	if (slot >= 0 && slot < STATUS_CODE_SLOTS)
+	{
+		addSingleWriter(metrics.requests[slot], 1);
+	}
+	metrics.latency[(int)RequestPhase::Parse].record(parseNs);
+	metrics.latency[(int)RequestPhase::Handler].record(handlerNs);
+	metrics.latency[(int)RequestPhase::Total].record(totalNs);
+}
+
+void ReactorMetrics::changeSocketStatus(SocketStatus from, SocketStatus to)
+{
+	if (from == to)
+	{
+		return;
+	}
+	if (from != SocketStatus::EMPTY)
+	{
+		addSingleWriter(m_connections[(int)from], (uint64_t)-1);
+	}
+	if (to != SocketStatus::EMPTY)
+	{
+		addSingleWriter(m_connections[(int)to], 1);
+	}
+}
+
+Metrics::Metrics(int reactorCount, const FileCache& fileCache, const AccessLog& accessLog)
+	: m_fileCache(fileCache), m_accessLog(accessLog)
+{
+	for (int i = 0; i < reactorCount; i++)
+	{
+		m_reactors.push_back(std::make_unique<ReactorMetrics>());
+	}
+}
+
+ReactorMetrics& Metrics::attach(int reactor, const Router& router)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_routes.empty())
+	{
+		for (int i = 0; i < router.getRouteCount(); i++)
+		{
+			m_routes.push_back("route=\"" + std::string(router.getRoutePattern(i)) + "\",method=\"" + httpMethodToString(router.getRouteMethod(i)) + "\"");
+		}
+	}
+
+	ReactorMetrics& metrics = *m_reactors[reactor];
+	metrics.m_routeCount = (int)m_routes.size();
+	metrics.m_routes = std::make_unique<ReactorMetrics::RouteMetrics[]>(m_routes.size() + 1);
+	return metrics;
+}
+
+static void appendNumber(std::string& out, uint64_t value)
+{
+	out.append(std::to_string(value));
+}
+
+static void appendSeconds(std::string& out, double nanoseconds)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.12g", nanoseconds / 1e9);
+	out.append(buffer);
+}
+
+static void appendHeader(std::string& out, const char* name, const char* type, const char* help)
+{
+	out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+	out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+static void appendSample(std::string& out, const char* name, const std::string& labels, uint64_t value)
+{
+	out.append(name);
+	if (!labels.empty())
+	{
+		out.append("{").append(labels).append("}");
+	}
+	out.append(" ");
+	appendNumber(out, value);
+	out.append("\n");
+}
+
+// Requests that matched no route share one series with a route label of
+// their own, rather than empty labels that Prometheus would drop.
+const std::string& Metrics::getRouteLabels(size_t route) const
+{
+	static const std::string UNMATCHED = "route=\"unmatched\",method=\"\"";
+	return route < m_routes.size() ? m_routes[route] : UNMATCHED;
+}
+
+// The le="..." text of each exported bucket bound, formatted once.
+static const std::vector<std::string>& getExportedBounds()
+{
+	static const std::vector<std::string> bounds = [] {
+		std::vector<std::string> result;
+		for (int bit = FIRST_EXPORTED_BIT; bit <= LAST_EXPORTED_BIT; bit++)
+		{
+			std::string bound;
+			appendSeconds(bound, (double)(1ull << bit));
+			result.push_back(bound);
+		}
+		return result;
+	}();
+	return bounds;
+}
+
+std::string Metrics::render() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::string out;
+	out.reserve(m_lastRenderBytes);
+
+	appendHeader(out, "http_requests_total", "counter", "Requests answered, by route and status code.");
+	for (size_t route = 0; route <= m_routes.size(); route++)
+	{
+		for (int slot = 0; slot < STATUS_CODE_SLOTS; slot++)
+		{
+			uint64_t count = 0;
+			for (const auto& reactor : m_reactors)
+			{
+				if (reactor->m_routes)
+				{
+					count += reactor->m_routes[route].requests[slot].load(std::memory_order_relaxed);
+				}
+			}
+			if (count == 0)
+			{
+				continue;
+			}
+			std::string labels = getRouteLabels(route);
+			labels.append(",code=\"").append(std::to_string(FIRST_STATUS_CODE + slot)).append("\"");
+			appendSample(out, "http_requests_total", labels, count);
+		}
+	}
+
+	renderLatency(out);
+
+	uint64_t received = 0;
+	uint64_t sent = 0;
+	uint64_t rejected = 0;
+	uint64_t connections[ReactorMetrics::STATUS_COUNT] = {};
+	uint64_t timeouts[ReactorMetrics::TIMEOUT_KIND_COUNT] = {};
+	for (const auto& reactor : m_reactors)
+	{
+		received += reactor->m_bytesReceived.load(std::memory_order_relaxed);
+		sent += reactor->m_bytesSent.load(std::memory_order_relaxed);
+		rejected += reactor->m_acceptsRejected.load(std::memory_order_relaxed);
+		for (int i = 0; i < ReactorMetrics::STATUS_COUNT; i++)
+		{
+			connections[i] += reactor->m_connections[i].load(std::memory_order_relaxed);
+		}
+		for (int i = 0; i < ReactorMetrics::TIMEOUT_KIND_COUNT; i++)
+		{
+			timeouts[i] += reactor->m_timeouts[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	appendHeader(out, "http_received_bytes_total", "counter", "Bytes read from client connections.");
+	appendSample(out, "http_received_bytes_total", "", received);
+	appendHeader(out, "http_sent_bytes_total", "counter", "Bytes written to client connections.");
+	appendSample(out, "http_sent_bytes_total", "", sent);
+
+	static const char* const STATES[] = { "empty", "listening", "receiving", "processing", "sending" };
+	appendHeader(out, "http_connections", "gauge", "Open sockets, by state.");
+	for (int i = (int)SocketStatus::LISTENING; i < ReactorMetrics::STATUS_COUNT; i++)
+	{
+		appendSample(out, "http_connections", std::string("state=\"") + STATES[i] + "\"", connections[i]);
+	}
+
+	appendHeader(out, "http_accepts_rejected_total", "counter", "Connections closed on accept because the connection table was full.");
+	appendSample(out, "http_accepts_rejected_total", "", rejected);
+
+	static const char* const TIMEOUT_KINDS[] = { "none", "idle", "header", "body", "send" };
+	appendHeader(out, "http_connection_timeouts_total", "counter", "Connections closed by a deadline, by the phase it guarded.");
+	for (int i = (int)TimeoutKind::Idle; i < ReactorMetrics::TIMEOUT_KIND_COUNT; i++)
+	{
+		appendSample(out, "http_connection_timeouts_total", std::string("phase=\"") + TIMEOUT_KINDS[i] + "\"", timeouts[i]);
+	}
+
+	FileCacheStats cache = m_fileCache.getStats();
+	appendHeader(out, "file_cache_hits_total", "counter", "File reads answered from the cache.");
+	appendSample(out, "file_cache_hits_total", "", cache.hits);
+	appendHeader(out, "file_cache_misses_total", "counter", "File reads that went to disk.");
+	appendSample(out, "file_cache_misses_total", "", cache.misses);
+	appendHeader(out, "file_cache_evictions_total", "counter", "Files evicted to stay within the cache budget.");
+	appendSample(out, "file_cache_evictions_total", "", cache.evictions);
+	appendHeader(out, "file_cache_invalidations_total", "counter", "Cached files dropped because they were written or deleted.");
+	appendSample(out, "file_cache_invalidations_total", "", cache.invalidations);
+	appendHeader(out, "file_cache_entries", "gauge", "Files in the cache.");
+	appendSample(out, "file_cache_entries", "", cache.entries);
+	appendHeader(out, "file_cache_bytes", "gauge", "Bytes held by the cache, against its budget.");
+	appendSample(out, "file_cache_bytes", "", cache.bytes);
+	appendHeader(out, "file_cache_capacity_bytes", "gauge", "The cache budget.");
+	appendSample(out, "file_cache_capacity_bytes", "", cache.capacityBytes);
+
+	appendHeader(out, "access_log_dropped_total", "counter", "Access log records dropped because a reactor's ring was full.");
+	appendSample(out, "access_log_dropped_total", "", m_accessLog.getDroppedCount());
+	m_lastRenderBytes = out.size();
+	return out;
+}
+
+// The fine buckets are summed across reactors, then exported twice: as a
+// Prometheus histogram over power-of-two bounds, which aggregates across
+// servers, and as quantiles read off the fine buckets, which are accurate to
+// their 12.5% width.
+void Metrics::renderLatency(std::string& out) const
+{
+	static const char* const PHASES[] = { "parse", "handler", "total" };
+	const std::vector<std::string>& bounds = getExportedBounds();
+	std::string& histograms = m_histograms;
+	std::string& quantiles = m_quantiles;
+	histograms.clear();
+	quantiles.clear();
+	std::string labels;
+	std::vector<uint64_t> buckets(LatencyHistogram::BUCKET_COUNT);
+
+	for (size_t route = 0; route <= m_routes.size(); route++)
+	{
+		const std::string& routeLabels = getRouteLabels(route);
+
+		for (int phase = 0; phase < (int)RequestPhase::Count; phase++)
+		{
+			uint64_t count = 0;
+			uint64_t sum = 0;
+			std::fill(buckets.begin(), buckets.end(), 0);
+			for (const auto& reactor : m_reactors)
+			{
+				if (!reactor->m_routes)
+				{
+					continue;
+				}
+				const LatencyHistogram& histogram = reactor->m_routes[route].latency[phase];
+				for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; i++)
+				{
+					uint64_t value = histogram.buckets[i].load(std::memory_order_relaxed);
+					buckets[i] += value;
+					count += value;
+				}
+				sum += histogram.sum.load(std::memory_order_relaxed);
+			}
+			if (count == 0)
+			{
+				continue;
+			}
+
+			labels.assign(routeLabels).append(",phase=\"").append(PHASES[phase]).append("\"");
+			uint64_t cumulative = 0;
+			int bucket = 0;
+			for (int bit = FIRST_EXPORTED_BIT; bit <= LAST_EXPORTED_BIT; bit++)
+			{
+				for (; bucket < LatencyHistogram::BUCKET_COUNT && LatencyHistogram::getUpperBound(bucket) <= (1ull << bit); bucket++)
+				{
+					cumulative += buckets[bucket];
+				}
+				histograms.append("http_request_duration_seconds_bucket{").append(labels).append(",le=\"");
+				histograms.append(bounds[bit - FIRST_EXPORTED_BIT]).append("\"} ");
+				appendNumber(histograms, cumulative);
+				histograms.append("\n");
+			}
+			histograms.append("http_request_duration_seconds_bucket{").append(labels).append(",le=\"+Inf\"} ");
+			appendNumber(histograms, count);
+			histograms.append("\n");
+			histograms.append("http_request_duration_seconds_sum{").append(labels).append("} ");
+			appendSeconds(histograms, (double)sum);
+			histograms.append("\n");
+			appendSample(histograms, "http_request_duration_seconds_count", labels, count);
+
+			// The upper bound of the bucket holding the rank-th value, as HdrHistogram reports it.
+			for (double quantile : QUANTILES)
+			{
+				uint64_t rank = (uint64_t)(quantile * (double)count + 0.999999);
+				uint64_t seen = 0;
+				int i = 0;
+				for (; i < LatencyHistogram::BUCKET_COUNT - 1; i++)
+				{
+					seen += buckets[i];
+					if (seen >= rank)
+					{
+						break;
+					}
+				}
+				char quantileText[16];
+				snprintf(quantileText, sizeof(quantileText), "%g", quantile);
+				quantiles.append("http_request_duration_quantile_seconds{").append(labels).append(",quantile=\"").append(quantileText).append("\"} ");
+				appendSeconds(quantiles, (double)LatencyHistogram::getUpperBound(i));
+				quantiles.append("\n");
+			}
+		}
+	}
+
+	appendHeader(out, "http_request_duration_seconds", "histogram", "Request latency by route and phase (parse, handler, total).");
+	out.append(histograms);
+	appendHeader(out, "http_request_duration_quantile_seconds", "gauge", "Request latency quantiles since startup, within 12.5%.");
+	out.append(quantiles);
+}
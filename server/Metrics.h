@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SocketData.h"
+#include "http/HttpStatusCodes.h"
+
+class Router;
+class FileCache;
+class AccessLog;
+
+// Status codes are counted in a slot per code from 100 to 599.
+const int FIRST_STATUS_CODE = 100;
+const int STATUS_CODE_SLOTS = 500;
+
+// The phases a request's latency is split into: parsing the read that
+// completed it, running its handler (cache lookup and queueing included),
+// and the whole span from its first byte being parsed to its response being queued.
+enum class RequestPhase
+{
+	Parse,
+	Handler,
+	Total,
+	Count
+};
+
+// Adds to a counter that only one thread writes. A relaxed load and store
+// instead of fetch_add: no locked instruction on the hot path, while a
+// scraper on another thread still reads whole values.
+inline void addSingleWriter(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Log-linear latency histogram in nanoseconds, in the manner of HdrHistogram:
+// exact below 16 ns, then 8 buckets per power of two, i.e. within 12.5% of
+// the recorded value up to 2^40 ns (about 18 minutes); longer values land in
+// the last bucket. Written by one thread, read by the scraper.
+class LatencyHistogram
+{
+public:
+	static constexpr int LINEAR_BUCKETS = 16;
+	static constexpr int SUB_BUCKET_BITS = 3;
+	static constexpr int MAX_BITS = 40;
+	static constexpr int BUCKET_COUNT = LINEAR_BUCKETS + (MAX_BITS - 4) * (1 << SUB_BUCKET_BITS);
+
+	void record(uint64_t nanoseconds);
+
+	static int getBucket(uint64_t nanoseconds);
+
+	// The smallest value past the bucket, so bucket b counts values below getUpperBound(b).
+	static uint64_t getUpperBound(int bucket);
+
+	std::atomic<uint64_t> buckets[BUCKET_COUNT];
+	std::atomic<uint64_t> sum; // Nanoseconds
+};
+
+// One reactor's counters. Only that reactor's thread writes them; the
+// scraper sums every reactor's copy when /metrics is requested.
+class ReactorMetrics
+{
+public:
+	// route is a Router route id, or -1 for a request no route matched.
+	void recordRequest(int route, HttpStatusCode status, uint64_t parseNs, uint64_t handlerNs, uint64_t totalNs);
+
+	void addBytesReceived(uint64_t bytes) { addSingleWriter(m_bytesReceived, bytes); }
+	void addBytesSent(uint64_t bytes) { addSingleWriter(m_bytesSent, bytes); }
+
+	// Moves a connection from one state's gauge to another's; EMPTY is not counted.
+	void changeSocketStatus(SocketStatus from, SocketStatus to);
+
+	// A connection closed straight after accept() because the table was full.
+	void addAcceptRejected() { addSingleWriter(m_acceptsRejected, 1); }
+	void addTimeout(TimeoutKind kind) { addSingleWriter(m_timeouts[(int)kind], 1); }
+
+private:
+	friend class Metrics;
+
+	static constexpr int STATUS_COUNT = (int)SocketStatus::SENDING + 1;
+	static constexpr int TIMEOUT_KIND_COUNT = (int)TimeoutKind::Send + 1;
+
+	struct RouteMetrics
+	{
+		std::atomic<uint64_t> requests[STATUS_CODE_SLOTS];
+		LatencyHistogram latency[(int)RequestPhase::Count];
+	};
+
+	// Routes plus a last slot for unmatched requests; zeroed by make_unique.
+	std::unique_ptr<RouteMetrics[]> m_routes;
+	int m_routeCount = 0;
+
+	std::atomic<uint64_t> m_bytesReceived{ 0 };
+	std::atomic<uint64_t> m_bytesSent{ 0 };
+	std::atomic<uint64_t> m_connections[STATUS_COUNT] = {};
+	std::atomic<uint64_t> m_acceptsRejected{ 0 };
+	std::atomic<uint64_t> m_timeouts[TIMEOUT_KIND_COUNT] = {};
+};
+
+// The registry behind /metrics: one ReactorMetrics per reactor, plus the
+// state shared between reactors (file cache, access log), rendered in the
+// Prometheus text exposition format. Recording never takes the lock; only
+// attach() and render() do.
+class Metrics
+{
+public:
+	Metrics(int reactorCount, const FileCache& fileCache, const AccessLog& accessLog);
+
+	// Called by reactor i once its routes are compiled. Every reactor builds
+	// the same route table, so the first one names the routes.
+	ReactorMetrics& attach(int reactor, const Router& router);
+
+	// Any thread.
+	std::string render() const;
+
+private:
+	const std::string& getRouteLabels(size_t route) const;
+	void renderLatency(std::string& out) const;
+
+	const FileCache& m_fileCache;
+	const AccessLog& m_accessLog;
+	std::vector<std::unique_ptr<ReactorMetrics>> m_reactors;
+	std::vector<std::string> m_routes; // Label text per route, e.g. route="/home",method="GET"
+	mutable std::mutex m_mutex;
+
+	// Kept between scrapes so rendering reuses their capacity instead of
+	// growing fresh strings every time. Guarded by m_mutex.
+	mutable std::string m_histograms;
+	mutable std::string m_quantiles;
+	mutable size_t m_lastRenderBytes = 0;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+
+// Unbounded multi-producer, single-consumer queue of intrusive nodes: T must
+// have a "T* next" member, so pushing allocates nothing. Producers push onto
+// a lock-free stack with one compare-and-swap; the consumer takes the whole
+// stack with a single exchange and reverses it, so items come out in the
+// order they were pushed.
+template <typename T>
+class MpscQueue
+{
+public:
+	// Any thread. Returns true if the queue was empty, i.e. the consumer may
+	// be asleep and needs waking.
+	bool push(T* item)
+	{
+		T* head = m_head.load(std::memory_order_relaxed);
+		do
+		{
+			item->next = head;
+		} while (!m_head.compare_exchange_weak(head, item, std::memory_order_release, std::memory_order_relaxed));
+		return head == nullptr;
+	}
+
+	// Consumer only. Returns the queued items as a list in push order, or null.
+	T* popAll()
+	{
+		T* item = m_head.exchange(nullptr, std::memory_order_acquire);
+		T* ordered = nullptr;
+		while (item)
+		{
+			T* next = item->next;
+			item->next = ordered;
+			ordered = item;
+			item = next;
+		}
+		return ordered;
+	}
+
+	bool isEmpty() const { return m_head.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+	std::atomic<T*> m_head{nullptr};
+};
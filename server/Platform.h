@@ -0,0 +1,296 @@
+#pragma once
+
+// Thin portability layer: the server is written against the WinSock names,
+// so on POSIX systems we map those names onto the BSD socket API.
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/eventfd.h>
+#endif
+
+typedef int SOCKET;
+typedef sockaddr SOCKADDR;
+
+const SOCKET INVALID_SOCKET = -1;
+const int SOCKET_ERROR = -1;
+const int WSAEWOULDBLOCK = EWOULDBLOCK;
+
+#ifndef NO_ERROR
+#define NO_ERROR 0
+#endif
+
+inline int closesocket(SOCKET s) { return close(s); }
+inline int WSAGetLastError() { return errno; }
+
+#endif
+
+// Starts up the platform socket library (WSAStartup on Windows, no-op elsewhere).
+inline bool initSocketLibrary() {
+#ifdef _WIN32
+    WSAData wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == NO_ERROR;
+#else
+    return true;
+#endif
+}
+
+inline void cleanupSocketLibrary() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// Switches a socket to non-blocking mode.
+inline bool setNonBlocking(SOCKET s) {
+#ifdef _WIN32
+    unsigned long flag = 1;
+    return ioctlsocket(s, FIONBIO, &flag) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// True when the last socket error only means "try again later".
+inline bool isWouldBlockError(int error) {
+#ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+#else
+    return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+#endif
+}
+
+// One buffer of a gathered send: WSABUF on Windows, iovec elsewhere, so an
+// array of them goes to the system call as is.
+#ifdef _WIN32
+typedef WSABUF SendBuffer;
+#else
+typedef iovec SendBuffer;
+#endif
+
+inline void setSendBuffer(SendBuffer& buffer, const char* data, size_t length) {
+#ifdef _WIN32
+    buffer.buf = const_cast<char*>(data);
+    buffer.len = (ULONG)length;
+#else
+    buffer.iov_base = const_cast<char*>(data);
+    buffer.iov_len = length;
+#endif
+}
+
+// Sends several buffers with one system call (WSASend or sendmsg). Returns the
+// number of bytes sent, which may stop partway through a buffer, or SOCKET_ERROR.
+// moreToFollow tells Linux to hold back a short final segment (MSG_MORE) because
+// more of the same response is about to be sent, e.g. a file after its headers.
+inline int sendBuffers(SOCKET s, SendBuffer* buffers, int count, bool moreToFollow = false) {
+#ifdef _WIN32
+    DWORD bytesSent = 0;
+    if (WSASend(s, buffers, (DWORD)count, &bytesSent, 0, nullptr, nullptr) != 0) {
+        return SOCKET_ERROR;
+    }
+    return (int)bytesSent;
+#else
+    msghdr message = {};
+    message.msg_iov = buffers;
+    message.msg_iovlen = count;
+    int flags = MSG_NOSIGNAL;
+#ifdef MSG_MORE
+    if (moreToFollow) {
+        flags |= MSG_MORE;
+    }
+#endif
+    return (int)sendmsg(s, &message, flags);
+#endif
+}
+
+
+// Read-only file access through integer descriptors, which the MSVC CRT has too.
+// Returns -1 on failure.
+inline int openFileForReading(const char* path) {
+#ifdef _WIN32
+    return _open(path, _O_RDONLY | _O_BINARY);
+#else
+    return open(path, O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+inline void closeFile(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+// What fstat() tells about an open file: enough to serve it and to build its validators.
+struct FileInfo {
+    uint64_t size = 0;
+    time_t modified = 0;
+    uint32_t modifiedNanoseconds = 0; // Within the second; 0 where the platform has no finer time
+    uint64_t fileId = 0;              // The inode; 0 on Windows
+};
+
+inline bool getFileInfo(int fd, FileInfo& result) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_fstat64(fd, &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        return false;
+    }
+    result.fileId = (uint64_t)info.st_ino;
+#endif
+#if defined(__APPLE__)
+    result.modifiedNanoseconds = (uint32_t)info.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+    result.modifiedNanoseconds = (uint32_t)info.st_mtim.tv_nsec;
+#endif
+    result.size = (uint64_t)info.st_size;
+    result.modified = (time_t)info.st_mtime;
+    return true;
+}
+
+// Reads from a fixed offset without moving a shared file position, so one
+// descriptor can serve several connections. Returns the bytes read or -1.
+inline long long readFileAt(int fd, char* buffer, size_t length, uint64_t offset) {
+#ifdef _WIN32
+    OVERLAPPED position = {};
+    position.Offset = (DWORD)offset;
+    position.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD bytesRead = 0;
+    if (!ReadFile((HANDLE)_get_osfhandle(fd), buffer, (DWORD)length, &bytesRead, &position)) {
+        return -1;
+    }
+    return bytesRead;
+#else
+    return pread(fd, buffer, length, (off_t)offset);
+#endif
+}
+
+// Sends part of a file without passing it through a user-space buffer where
+// the OS allows (sendfile on Linux); elsewhere through a bounded stack buffer.
+// Returns the bytes sent, 0 at end of file, or SOCKET_ERROR (check
+// isWouldBlockError()). A short count only means the socket buffer is full.
+inline long long sendFile(SOCKET s, int fd, uint64_t offset, size_t length) {
+    // Keeps each call's byte count well inside what every platform returns without truncation.
+    const size_t MAX_CHUNK = 1 << 30;
+    if (length > MAX_CHUNK) {
+        length = MAX_CHUNK;
+    }
+#ifdef __linux__
+    off_t position = (off_t)offset;
+    return sendfile(s, fd, &position, length);
+#else
+    char buffer[64 * 1024];
+    if (length > sizeof(buffer)) {
+        length = sizeof(buffer);
+    }
+    long long bytesRead = readFileAt(fd, buffer, length, offset);
+    if (bytesRead <= 0) {
+        return bytesRead < 0 ? SOCKET_ERROR : 0;
+    }
+    // Bytes the socket did not take are simply read again on the next call.
+    return send(s, buffer, (int)bytesRead, MSG_NOSIGNAL);
+#endif
+}
+
+// A descriptor other threads signal to wake an event loop blocked in its
+// backend (an eventfd). Returns -1 where there is none, and the loop has to
+// poll instead.
+inline int createWakeupEvent() {
+#ifdef __linux__
+    return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    return -1;
+#endif
+}
+
+// Any thread. Signals stay pending until clearWakeupEvent().
+inline void signalWakeupEvent(int fd) {
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written; // Only fails if the counter is about to overflow, i.e. already signalled.
+#else
+    (void)fd;
+#endif
+}
+
+inline void clearWakeupEvent(int fd) {
+#ifdef __linux__
+    uint64_t count;
+    ssize_t bytesRead = read(fd, &count, sizeof(count));
+    (void)bytesRead; // EAGAIN if it was not signalled.
+#else
+    (void)fd;
+#endif
+}
+
+// Thread-safe calendar conversions (the MSVC and POSIX variants take their arguments in opposite order).
+inline void toUtcTime(const time_t& time, std::tm& result) {
+#ifdef _WIN32
+    gmtime_s(&result, &time);
+#else
+    gmtime_r(&time, &result);
+#endif
+}
+
+inline void toLocalTime(const time_t& time, std::tm& result) {
+#ifdef _WIN32
+    localtime_s(&result, &time);
+#else
+    localtime_r(&time, &result);
+#endif
+}
+
+// Restricts the calling thread to a single CPU.
+inline bool pinCurrentThreadToCpu(int cpu) {
+#if defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    return false;
+#endif
+}
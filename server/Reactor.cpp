@@ -0,0 +1,688 @@
+#include "Reactor.h"
+#include "http/HttpStatusCodes.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/HttpConditional.h"
+#include "http/Compression.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+Reactor::Reactor(const ServerConfig& config, int reactorIndex, FileCache& fileCache, AccessLog& accessLog, AccessLog& slowLog,
+                 Metrics& metrics, WorkerPool* workers)
+    : m_config(config),
+      m_reactorIndex(reactorIndex),
+      m_accessLog(accessLog),
+      m_tracing(config.slowRequestMs > 0),
+      m_manager(config.backendType, config.maxConnections),
+      m_workers(workers),
+      m_putFileEndpoint(fileCache),
+      m_getFileEndpoint(fileCache),
+      m_deleteFileEndpoint(fileCache),
+      m_metricsEndpoint(metrics),
+      m_homeOptions({{HttpMethod::GET, m_homeEndpoint.getDescription()}}),
+      m_postMessageOptions({{HttpMethod::POST, m_postMessageEndpoint.getDescription()}}),
+      m_traceOptions({{HttpMethod::TRACE, m_traceEndpoint.getDescription()}}),
+      m_fileOptions({
+          {HttpMethod::GET, m_getFileEndpoint.getDescription()},
+          {HttpMethod::PUT, m_putFileEndpoint.getDescription()},
+          {HttpMethod::DELETE_0, m_deleteFileEndpoint.getDescription()}
+      }),
+      m_metricsOptions({{HttpMethod::GET, m_metricsEndpoint.getDescription()}})
+{
+    m_manager.setAccessLog(&m_accessLog, m_reactorIndex);
+
+    m_router.add("/home", HttpMethod::GET, &m_homeEndpoint);
+    m_router.add("/home", HttpMethod::OPTIONS, &m_homeOptions);
+    m_router.add("/postmessage", HttpMethod::POST, &m_postMessageEndpoint);
+    m_router.add("/postmessage", HttpMethod::OPTIONS, &m_postMessageOptions);
+    m_router.add("/trace", HttpMethod::TRACE, &m_traceEndpoint);
+    m_router.add("/trace", HttpMethod::OPTIONS, &m_traceOptions);
+
+    m_router.add("/file/{name}.txt", HttpMethod::GET, &m_getFileEndpoint);
+    m_router.add("/file/{name}.txt", HttpMethod::PUT, &m_putFileEndpoint);
+    m_router.add("/file/{name}.txt", HttpMethod::DELETE_0, &m_deleteFileEndpoint);
+    m_router.add("/file/{name}.txt", HttpMethod::OPTIONS, &m_fileOptions);
+    m_router.add("/metrics", HttpMethod::GET, &m_metricsEndpoint);
+    m_router.add("/metrics", HttpMethod::OPTIONS, &m_metricsOptions);
+    m_router.compile();
+
+    m_metrics = &metrics.attach(m_reactorIndex, m_router);
+    m_manager.setMetrics(m_metrics);
+    if (m_tracing) {
+        m_manager.setSlowLog(&slowLog, microsToTraceTicks((uint64_t)config.slowRequestMs * 1000));
+    }
+}
+
+Reactor::~Reactor()
+{
+    // The jobs still hold this reactor's completion queue.
+    while (m_requestsInFlight > 0) {
+        OffloadedRequest* job = m_completions.popAll();
+        while (job) {
+            OffloadedRequest* next = job->next;
+            delete job;
+            m_requestsInFlight--;
+            job = next;
+        }
+        if (m_requestsInFlight > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WORKER_RESULT_POLL_MS));
+        }
+    }
+}
+
+bool Reactor::init()
+{
+    // A lone reactor keeps an exclusive listener so a second server on the same port fails loudly.
+    if (!m_manager.init(m_config.port, m_config.reactorCount > 1)) {
+        return false;
+    }
+
+    if (m_workers) {
+        m_canWakeup = m_manager.enableWakeup();
+        if (!m_canWakeup) {
+            std::cout << "Server: The " << m_manager.getBackendName() << " backend cannot be woken by worker threads; polling every "
+                      << WORKER_RESULT_POLL_MS << " ms while they are busy." << std::endl;
+        }
+    }
+    return true;
+}
+
+void Reactor::run()
+{
+    std::vector<IoEvent> events;
+
+    while (true)
+    {
+        // Sleep until the next connection deadline at the latest.
+        int timeoutMs = m_manager.getNextTimeoutMs();
+        if (m_requestsInFlight > 0 && !m_canWakeup && (timeoutMs < 0 || timeoutMs > WORKER_RESULT_POLL_MS)) {
+            timeoutMs = WORKER_RESULT_POLL_MS;
+        }
+        int nfd = m_manager.waitForEvents(events, timeoutMs);
+        if (nfd == SOCKET_ERROR) {
+            break;
+        }
+
+        // Only the sockets the backend reported are visited. Handling one event
+        // can close a connection and accept another into the same slot, so
+        // events for the slot's previous tenant are skipped.
+        for (const IoEvent& event : events) {
+            if (!m_manager.isCurrent(event)) {
+                continue;
+            }
+            SocketState& socket = m_manager.getSocketState(event.socketIndex);
+            if (socket.status == SocketStatus::LISTENING) {
+                if (event.readable) {
+                    m_manager.acceptNewConnection(event.socketIndex);
+                }
+            }
+            else if (socket.status != SocketStatus::EMPTY) {
+                serviceSocket(event);
+            }
+        }
+
+        if (m_requestsInFlight > 0) {
+            completeOffloadedRequests();
+        }
+        m_manager.expireTimeouts();
+    }
+}
+
+
+IEndpoint* Reactor::findEndpoint(const HttpRequest& request) const
+{
+    return m_router.find(request.getMethod(), request.getPath());
+}
+
+
+// The endpoint that answers a complete request: HEAD is routed as GET.
+IEndpoint* Reactor::findHandler(const HttpRequest& request, int* route) const
+{
+    HttpMethod method = request.getMethod();
+    return m_router.find(method == HttpMethod::HEAD ? HttpMethod::GET : method, request.getPath(), route);
+}
+
+
+// Runs the handler for a fully parsed request and queues its response behind
+// any earlier ones on the same connection.
+void Reactor::processRequest(int socketIndex)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    const HttpRequest& request = socket.requestState->request;
+    const uint64_t start = getMonotonicTimeNs();
+
+    int route = -1;
+    IEndpoint* handler = findHandler(request, &route);
+    HttpStatusCode status;
+    TRACE_PROBE2(handler_start, m_reactorIndex, (int64_t)socket.id);
+    if (m_tracing) {
+        socket.trace.at[(int)TracePhase::HandlerStart] = readTraceClock();
+    }
+
+    if (handler && handler->isCacheable() && !socket.requestState->bodySink) {
+        status = answerFromCache(socketIndex, handler, request);
+    } else {
+        HttpResponse response;
+        if (socket.requestState->bodySink) {
+            response = socket.requestState->bodySink->finish(request);
+        } else if (handler) {
+            response = handler->handle(request);
+            negotiateEncoding(request, response);
+        } else {
+            response = HttpResponse(HttpStatusCode::NotFound);
+        }
+        answerRequest(socketIndex, request, response);
+        status = response.getStatusCode();
+    }
+
+    TRACE_PROBE3(handler_end, m_reactorIndex, (int64_t)socket.id, (int)status);
+    if (m_tracing) {
+        socket.trace.at[(int)TracePhase::HandlerEnd] = readTraceClock();
+    }
+    const uint64_t end = getMonotonicTimeNs();
+    recordRequest(socketIndex, request, route, status, end - start, end);
+}
+
+
+// Compresses a response built for this request alone, if the client accepts
+// a coding and the body is worth it. Cacheable endpoints and files keep their
+// compressed variants instead (see ResponseCache and GetFileEndpoint).
+void Reactor::negotiateEncoding(const HttpRequest& request, HttpResponse& response)
+{
+    if (!isEncodable(response)) {
+        return;
+    }
+    response.addHeader("Vary", "Accept-Encoding");
+    ContentCoding coding = negotiateContentCoding(request.getHeader(HttpHeader::AcceptEncoding));
+    if (coding != ContentCoding::Identity) {
+        encodeResponse(response, coding, CompressionEffort::Response);
+    }
+}
+
+
+void Reactor::answerRequest(int socketIndex, const HttpRequest& request, const HttpResponse& response)
+{
+    bool isHeadRequest = (request.getMethod() == HttpMethod::HEAD);
+    m_accessLog.logRequest(m_reactorIndex, request, response.getStatusCode(), isHeadRequest ? 0 : response.getBodyLength());
+
+    // HEAD gets the same headers, Content-Length included, without the body.
+    m_manager.queueResponse(socketIndex, response, !isHeadRequest);
+}
+
+
+// Replays the serialized response of a cacheable endpoint, running the
+// handler only the first time its key is seen. A hit is one shared buffer on
+// the send queue: no handler, no header rendering, no copy. A client that
+// already holds the response gets the cached 304 instead.
+HttpStatusCode Reactor::answerFromCache(int socketIndex, IEndpoint* handler, const HttpRequest& request)
+{
+    std::string_view dateLine = m_manager.getDateLine();
+    const CachedResponse* cached = m_responseCache.find(handler, request, dateLine);
+    if (!cached) {
+        HttpResponse response = handler->handle(request);
+        cached = m_responseCache.insert(handler, request, response, dateLine);
+        if (!cached) {
+            answerRequest(socketIndex, request, response);
+            return response.getStatusCode();
+        }
+    }
+
+    if (!cached->etag.empty() && isNotModified(request, cached->etag, cached->lastModified)) {
+        const SerializedResponse& notModified = cached->notModified;
+        m_accessLog.logRequest(m_reactorIndex, request, HttpStatusCode::NotModified, 0);
+        m_manager.queueSerializedResponse(socketIndex, notModified.bytes, notModified.bytes->length());
+        return HttpStatusCode::NotModified;
+    }
+
+    bool isHeadRequest = (request.getMethod() == HttpMethod::HEAD);
+    m_accessLog.logRequest(m_reactorIndex, request, cached->statusCode, isHeadRequest ? 0 : cached->bodyLength);
+    m_manager.queueSerializedResponse(socketIndex, cached->full.bytes, isHeadRequest ? cached->headerLength : cached->full.bytes->length());
+    return cached->statusCode;
+}
+
+
+// Counts a request that has been answered into this reactor's metrics and
+// ends its timing: endNs is when its response was queued. A traced request
+// moves on to the send path.
+void Reactor::recordRequest(int socketIndex, const HttpRequest& request, int route, HttpStatusCode status, uint64_t handlerNs, uint64_t endNs)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    uint64_t startNs = socket.requestStartNs != 0 ? socket.requestStartNs : endNs;
+    m_metrics->recordRequest(route, status, socket.parseNs, handlerNs, endNs - startNs);
+    socket.requestStartNs = 0;
+    socket.parseNs = 0;
+    if (m_tracing) {
+        m_manager.traceResponse(socketIndex, request, status);
+    }
+}
+
+
+// Hands a complete request for a blocking endpoint to the worker pool. The
+// connection stays PROCESSING, with whatever was pipelined behind the request
+// left unparsed, until completeOffloadedRequests() queues the response.
+// Returns false if the request is cheap enough to answer inline.
+bool Reactor::offloadRequest(int socketIndex)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    int route = -1;
+    IEndpoint* handler = findHandler(socket.requestState->request, &route);
+    if (!handler || !handler->isBlocking()) {
+        return false;
+    }
+
+    OffloadedRequest* job = new OffloadedRequest();
+    job->connection = m_manager.getConnections().getHandle(socketIndex);
+    job->request = socket.requestState->request.detach(job->storage);
+    job->handler = handler;
+    job->route = route;
+    job->socketId = (int64_t)socket.id;
+    job->bodySink = std::move(socket.requestState->bodySink);
+
+    socket.requestInFlight = true;
+    m_requestsInFlight++;
+    m_workers->submit([this, job]() { runOffloadedRequest(job); });
+    return true;
+}
+
+
+// Worker thread: runs the handler and posts the result back to this reactor.
+void Reactor::runOffloadedRequest(OffloadedRequest* job)
+{
+    const uint64_t start = getMonotonicTimeNs();
+    TRACE_PROBE2(handler_start, m_reactorIndex, job->socketId);
+    if (m_tracing) {
+        job->handlerStart = readTraceClock();
+    }
+    if (job->bodySink) {
+        job->response = job->bodySink->finish(job->request);
+        job->bodySink.reset();
+    } else {
+        job->response = job->handler->handle(job->request);
+    }
+    job->handlerNs = getMonotonicTimeNs() - start;
+    TRACE_PROBE3(handler_end, m_reactorIndex, job->socketId, (int)job->response.getStatusCode());
+    if (m_tracing) {
+        job->handlerEnd = readTraceClock();
+    }
+
+    // Only the push that finds the queue empty needs to wake the loop; later
+    // ones are drained along with it.
+    if (m_completions.push(job) && m_canWakeup) {
+        m_manager.wakeup();
+    }
+}
+
+
+// Queues the responses the workers have finished and resumes their
+// connections: requests pipelined behind are parsed, then the batch is sent.
+// Results for connections closed in the meantime are dropped.
+void Reactor::completeOffloadedRequests()
+{
+    OffloadedRequest* job = m_completions.popAll();
+    while (job) {
+        std::unique_ptr<OffloadedRequest> done(job);
+        job = job->next;
+        m_requestsInFlight--;
+
+        if (!m_manager.getConnections().isValid(done->connection)) {
+            continue;
+        }
+        const int socketIndex = done->connection.index;
+        SocketState& socket = m_manager.getSocketState(socketIndex);
+        socket.requestInFlight = false;
+        socket.trace.at[(int)TracePhase::HandlerStart] = done->handlerStart;
+        socket.trace.at[(int)TracePhase::HandlerEnd] = done->handlerEnd;
+        answerRequest(socketIndex, done->request, done->response);
+        recordRequest(socketIndex, done->request, done->route, done->response.getStatusCode(), done->handlerNs, getMonotonicTimeNs());
+
+        socket.parseOffset += socket.requestState->request.getConsumedBytes();
+        socket.requestState->request.clear(socket.parseOffset);
+        resetBody(socketIndex);
+
+        m_manager.setSocketStatus(socketIndex, SocketStatus::RECEIVING);
+        socket.readPending = true;
+        IoEvent event;
+        event.socketIndex = socketIndex;
+        event.generation = done->connection.generation;
+        serviceSocket(event);
+    }
+}
+
+
+// Parses and answers every complete request in messageData, in order. The
+// responses are queued back to back so the whole batch goes out in one
+// gathered send; a trailing partial request stays for the next read.
+void Reactor::processRequests(int socketIndex)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    m_manager.attachRequestState(socketIndex);
+
+    while (true) {
+        // Bound the batch so a client pipelining without reading cannot grow
+        // the send queue indefinitely; the rest is picked up after the flush.
+        if ((size_t)socket.bytesToSend >= MAX_PIPELINED_RESPONSE_BYTES) {
+            socket.readPending = true;
+            break;
+        }
+
+        ParseResult result;
+        if (socket.requestState->bodyMode == BodyMode::Streamed || socket.requestState->bodyMode == BodyMode::Dechunked) {
+            result = readBody(socketIndex);
+        } else {
+            const uint64_t parseStart = getMonotonicTimeNs();
+            if (socket.requestStartNs == 0 && socket.messageData.length() > socket.parseOffset) {
+                socket.requestStartNs = parseStart;
+                TRACE_PROBE2(request_start, m_reactorIndex, (int64_t)socket.id);
+                if (m_tracing) {
+                    socket.trace.at[(int)TracePhase::FirstByte] = readTraceClock();
+                }
+            }
+            result = socket.requestState->request.parse(socket.messageData);
+            socket.parseNs = getMonotonicTimeNs() - parseStart;
+
+            // The body is sized up and routed as soon as the headers are in, before it is buffered.
+            if (result != ParseResult::Error && socket.requestState->bodyMode == BodyMode::Unchecked && socket.requestState->request.hasHeaders()) {
+                if (!beginBody(socketIndex)) {
+                    break;
+                }
+                if (socket.requestState->bodyMode != BodyMode::Buffered) {
+                    result = readBody(socketIndex);
+                }
+            }
+        }
+
+        if (result == ParseResult::Incomplete) {
+            break;
+        }
+
+        if (result == ParseResult::Error) {
+            if (socket.closeAfterSend) {
+                break; // Refused while reading the body; the response is already queued.
+            }
+            // The stream cannot be resynchronised after a malformed request: the
+            // 400 closes the connection, so nothing sent after it is taken for a
+            // new request.
+            rejectRequest(socketIndex, HttpResponse(HttpStatusCode::BadRequest));
+            break;
+        }
+
+        TRACE_PROBE3(request_parsed, m_reactorIndex, (int64_t)socket.id, (int)socket.requestState->request.getMethod());
+        if (m_tracing) {
+            socket.trace.at[(int)TracePhase::Parsed] = readTraceClock();
+        }
+        m_manager.setSocketStatus(socketIndex, SocketStatus::PROCESSING);
+        if (m_workers && offloadRequest(socketIndex)) {
+            break;
+        }
+        processRequest(socketIndex);
+
+        // The body was a view into messageData, so the bytes are released only now.
+        socket.parseOffset += socket.requestState->request.getConsumedBytes();
+        socket.requestState->request.clear(socket.parseOffset);
+        resetBody(socketIndex);
+    }
+
+    // Drop the consumed requests with one move of whatever follows them.
+    if (socket.parseOffset > 0) {
+        socket.messageData.erase(0, socket.parseOffset);
+        socket.parseOffset = 0;
+        socket.requestState->request.rebase(0);
+    }
+
+    // Between requests a keep-alive connection gives its parser back.
+    if (socket.messageData.empty() && socket.requestState->bodyMode == BodyMode::Unchecked && !socket.requestInFlight) {
+        m_manager.detachRequestState(socketIndex);
+    }
+
+    // Responses queued ahead of an offloaded request wait to go out with its own.
+    if (socket.bytesToSend > 0 && !socket.requestInFlight) {
+        m_manager.setSocketStatus(socketIndex, SocketStatus::SENDING);
+    }
+}
+
+
+uint64_t Reactor::getBodyLimit(BodyMode mode) const
+{
+    if (mode == BodyMode::Streamed) {
+        return m_config.maxUploadBytes;
+    }
+    return m_config.maxUploadBytes < MAX_BUFFERED_BODY_BYTES ? m_config.maxUploadBytes : MAX_BUFFERED_BODY_BYTES;
+}
+
+
+// Decides where the body of a request whose headers just arrived goes, and
+// refuses it early if it is too large or its expectation is unknown. With
+// Expect: 100-continue the client holds the body back until it hears from
+// us, so a refused upload is never sent at all. Returns false if refused.
+bool Reactor::beginBody(int socketIndex)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    const HttpRequest& request = socket.requestState->request;
+
+    socket.requestState->bodyMode = BodyMode::Buffered;
+    const bool hasExpect = request.hasHeader(HttpHeader::Expect);
+    if (!hasExpect && !request.isChunked() && request.getContentLength() == 0) {
+        return true;
+    }
+
+    if (hasExpect && !request.expectsContinue()) {
+        rejectRequest(socketIndex, HttpResponse(HttpStatusCode::ExpectationFailed));
+        return false;
+    }
+
+    IEndpoint* endpoint = findEndpoint(request);
+    if (endpoint && endpoint->streamsBody()) {
+        socket.requestState->bodyMode = BodyMode::Streamed;
+    } else if (request.isChunked()) {
+        socket.requestState->bodyMode = BodyMode::Dechunked;
+    }
+
+    // A chunked body's size is only known as it arrives; readBody() checks it then.
+    if (request.getContentLength() > getBodyLimit(socket.requestState->bodyMode)) {
+        rejectRequest(socketIndex, HttpResponse(HttpStatusCode::ContentTooLarge));
+        return false;
+    }
+
+    if (socket.requestState->bodyMode == BodyMode::Streamed) {
+        HttpResponse refusal;
+        socket.requestState->bodySink = endpoint->openBodySink(request, refusal);
+        if (!socket.requestState->bodySink) {
+            rejectRequest(socketIndex, std::move(refusal));
+            return false;
+        }
+    }
+
+    // Unless the client has already started sending the body anyway.
+    if (hasExpect && socket.messageData.length() == socket.parseOffset + request.getBodyOffset()) {
+        m_manager.queueInterimResponse(socketIndex, HttpStatusCode::Continue);
+    }
+    return true;
+}
+
+
+// Moves the body bytes received so far out of messageData: into the
+// endpoint's sink, or de-chunked into requestBody. Memory use is bounded by
+// one read rather than by the size of the body. Returns Success once the body
+// is complete, and Error if the request was refused (the response is queued).
+ParseResult Reactor::readBody(int socketIndex)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    HttpRequest& request = socket.requestState->request;
+
+    const size_t bodyStart = socket.parseOffset + request.getBodyOffset();
+    const char* data = socket.messageData.data() + bodyStart;
+    const size_t available = socket.messageData.length() - bodyStart;
+    size_t used = 0;
+    bool complete = false;
+
+    // Each piece is delivered before the bytes it points into are erased.
+    auto deliver = [&socket](std::string_view piece) {
+        socket.requestState->bodyBytesRead += piece.length();
+        if (socket.requestState->bodySink) {
+            return socket.requestState->bodySink->write(piece);
+        }
+        socket.requestState->requestBody.append(piece);
+        return true;
+    };
+
+    if (!request.isChunked()) {
+        uint64_t remaining = request.getContentLength() - socket.requestState->bodyBytesRead;
+        used = available < remaining ? available : (size_t)remaining;
+        if (used > 0 && !deliver(std::string_view(data, used))) {
+            rejectRequest(socketIndex, HttpResponse(HttpStatusCode::InternalServerError));
+            return ParseResult::Error;
+        }
+        complete = socket.requestState->bodyBytesRead == request.getContentLength();
+    }
+
+    while (request.isChunked() && !complete && used < available) {
+        size_t consumed = 0;
+        std::string_view payload;
+        ChunkedDecoder::Result result = socket.requestState->chunkedDecoder.decode(data + used, available - used, consumed, payload);
+        used += consumed;
+
+        if (result == ChunkedDecoder::Result::Error) {
+            rejectRequest(socketIndex, HttpResponse(HttpStatusCode::BadRequest));
+            return ParseResult::Error;
+        }
+        if (result == ChunkedDecoder::Result::Data) {
+            if (socket.requestState->bodyBytesRead + payload.length() > getBodyLimit(socket.requestState->bodyMode)) {
+                rejectRequest(socketIndex, HttpResponse(HttpStatusCode::ContentTooLarge));
+                return ParseResult::Error;
+            }
+            if (!deliver(payload)) {
+                rejectRequest(socketIndex, HttpResponse(HttpStatusCode::InternalServerError));
+                return ParseResult::Error;
+            }
+        }
+        complete = result == ChunkedDecoder::Result::Done;
+    }
+
+    // Anything after the body (a pipelined request) moves up behind the headers.
+    socket.messageData.erase(bodyStart, used);
+    if (!complete) {
+        return ParseResult::Incomplete;
+    }
+
+    request.finishStreamedBody(socket.messageData, socket.requestState->requestBody);
+    return ParseResult::Success;
+}
+
+
+// Answers the current request before its body has been read, or a malformed
+// one, then closes the connection: the client may still be sending bytes we
+// cannot frame.
+void Reactor::rejectRequest(int socketIndex, HttpResponse response)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    m_accessLog.logRequest(m_reactorIndex, socket.requestState->request, response.getStatusCode(), response.getBodyLength());
+
+    response.addHeader("Connection", "close");
+    m_manager.queueResponse(socketIndex, response, true);
+    socket.closeAfterSend = true;
+
+    int route = -1;
+    findHandler(socket.requestState->request, &route);
+    recordRequest(socketIndex, socket.requestState->request, route, response.getStatusCode(), 0, getMonotonicTimeNs());
+
+    socket.parseOffset = socket.messageData.length();
+    socket.requestState->request.clear(socket.parseOffset);
+    resetBody(socketIndex);
+}
+
+
+// Ends the current request's body; an unfinished sink discards what it wrote.
+void Reactor::resetBody(int socketIndex)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    socket.requestState->bodyMode = BodyMode::Unchecked;
+    socket.requestState->bodySink.reset();
+    std::string().swap(socket.requestState->requestBody);
+    socket.requestState->chunkedDecoder.reset();
+    socket.requestState->bodyBytesRead = 0;
+}
+
+
+// Picks the deadline for a partially received request. The header deadline
+// starts with the first byte and is not extended; the body deadline restarts
+// on every read. With nothing buffered the idle deadline armed on entering
+// RECEIVING stays.
+void Reactor::armRequestTimeout(int socketIndex)
+{
+    SocketState& socket = m_manager.getSocketState(socketIndex);
+    if (socket.messageData.empty()) {
+        return;
+    }
+    if (socket.requestState && socket.requestState->request.hasHeaders()) {
+        m_manager.armTimeout(socketIndex, TimeoutKind::Body);
+    } else if (socket.timeoutKind != TimeoutKind::Header) {
+        m_manager.armTimeout(socketIndex, TimeoutKind::Header);
+    }
+}
+
+
+// Advances one connection's state machine as far as it can go without blocking:
+// read and parse, run the handlers, then try to send straight away. Edge-triggered
+// backends only report each readiness change once, so we keep going until the
+// socket would block or is waiting on the other direction.
+void Reactor::serviceSocket(const IoEvent& event)
+{
+    SocketState& socket = m_manager.getSocketState(event.socketIndex);
+    bool readable = event.readable;
+    bool writable = event.writable;
+
+    while (true) {
+        if (socket.status == SocketStatus::RECEIVING) {
+            if (!readable && !socket.readPending) {
+                return;
+            }
+            readable = false;
+            socket.readPending = false;
+
+            int received = m_manager.receiveData(event.socketIndex);
+            if (socket.status == SocketStatus::EMPTY) {
+                return; // The socket was closed.
+            }
+            if (received <= 0 && socket.messageData.empty()) {
+                return; // Would block, and nothing is left over from an earlier batch.
+            }
+
+            processRequests(event.socketIndex);
+            if (socket.requestInFlight) {
+                return; // Resumed by completeOffloadedRequests().
+            }
+            if (socket.status != SocketStatus::SENDING) {
+                armRequestTimeout(event.socketIndex);
+                if (socket.readPending) {
+                    continue; // receiveData() stopped early; more is waiting.
+                }
+                return; // Incomplete: wait for more data.
+            }
+            writable = true; // Fresh responses are sent optimistically, without waiting for a writable event.
+        }
+        else if (socket.status == SocketStatus::SENDING) {
+            if (readable) {
+                socket.readPending = true;
+                readable = false;
+            }
+            if (!writable) {
+                return;
+            }
+            writable = false;
+
+            m_manager.sendData(event.socketIndex);
+            if (socket.status != SocketStatus::RECEIVING) {
+                return; // Still draining, or the socket was closed.
+            }
+            armRequestTimeout(event.socketIndex);
+        }
+        else {
+            // PROCESSING: a worker has the request. Reads wait until it is answered.
+            if (readable) {
+                socket.readPending = true;
+            }
+            return;
+        }
+    }
+}
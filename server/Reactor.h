@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ServerConfig.h"
+#include "SocketManager.h"
+#include "http/IEndpoint.h"
+#include "http/Endpoints.h"
+#include "http/FileCache.h"
+#include "http/Router.h"
+#include "http/ResponseCache.h"
+#include "AccessLog.h"
+#include "Metrics.h"
+#include "MpscQueue.h"
+#include "WorkerPool.h"
+
+// Pipelined requests are answered in batches: once this many response bytes
+// are queued, they are flushed before the rest of the input is parsed.
+const size_t MAX_PIPELINED_RESPONSE_BYTES = 1024 * 1024;
+
+// Endpoints that do not stream get the whole body in memory, so it is capped
+// lower than the upload limit.
+const uint64_t MAX_BUFFERED_BODY_BYTES = 1024 * 1024;
+
+// How often a reactor whose backend cannot be woken from another thread
+// checks for handlers finished by the worker pool.
+const int WORKER_RESULT_POLL_MS = 1;
+
+// One event loop: a SocketManager with its own listener, its own endpoint
+// instances and its own route table. In multi-reactor mode every thread
+// builds its own Reactor, so nothing on the request path is shared.
+class Reactor
+{
+public:
+    // The file cache, the access and slow request logs, the metrics
+    // registry and the worker pool are the only state shared between
+    // reactors; each reactor writes to the logs through its own rings and
+    // counts into its own metrics. Without a worker pool (null) every
+    // handler runs inline.
+    Reactor(const ServerConfig& config, int reactorIndex, FileCache& fileCache, AccessLog& accessLog, AccessLog& slowLog,
+            Metrics& metrics, WorkerPool* workers);
+
+    // Waits for the handlers still running on worker threads.
+    ~Reactor();
+
+    bool init();
+
+    // Runs the event loop until the backend reports a fatal error.
+    void run();
+
+private:
+    // A request handed to a worker thread and, on its way back, its response.
+    // The request is a copy: the connection's buffer keeps changing meanwhile.
+    struct OffloadedRequest
+    {
+        ConnectionHandle connection;
+        std::string storage;
+        HttpRequest request;
+        IEndpoint* handler = nullptr;
+        int route = -1;
+        int64_t socketId = 0; // For the trace probes
+        std::unique_ptr<IBodySink> bodySink;
+        HttpResponse response;
+        uint64_t handlerNs = 0; // Measured on the worker
+        uint64_t handlerStart = 0; // Trace clock, when tracing
+        uint64_t handlerEnd = 0;
+        OffloadedRequest* next = nullptr; // MpscQueue link
+    };
+
+    IEndpoint* findEndpoint(const HttpRequest& request) const;
+    IEndpoint* findHandler(const HttpRequest& request, int* route = nullptr) const;
+    void processRequest(int socketIndex);
+    void negotiateEncoding(const HttpRequest& request, HttpResponse& response);
+    void answerRequest(int socketIndex, const HttpRequest& request, const HttpResponse& response);
+    HttpStatusCode answerFromCache(int socketIndex, IEndpoint* handler, const HttpRequest& request);
+    void recordRequest(int socketIndex, const HttpRequest& request, int route, HttpStatusCode status, uint64_t handlerNs, uint64_t endNs);
+    bool offloadRequest(int socketIndex);
+    void runOffloadedRequest(OffloadedRequest* job);
+    void completeOffloadedRequests();
+    void processRequests(int socketIndex);
+    uint64_t getBodyLimit(BodyMode mode) const;
+    bool beginBody(int socketIndex);
+    ParseResult readBody(int socketIndex);
+    void rejectRequest(int socketIndex, HttpResponse response);
+    void resetBody(int socketIndex);
+    void armRequestTimeout(int socketIndex);
+    void serviceSocket(const IoEvent& event);
+
+    const ServerConfig& m_config;
+    int m_reactorIndex;
+    AccessLog& m_accessLog;
+    ReactorMetrics* m_metrics = nullptr;
+    bool m_tracing; // See ServerConfig::slowRequestMs
+    SocketManager m_manager;
+
+    // Workers push finished requests onto m_completions and wake the loop.
+    WorkerPool* m_workers;
+    MpscQueue<OffloadedRequest> m_completions;
+    int m_requestsInFlight = 0;
+    bool m_canWakeup = false;
+
+    // --- Controller Setup ---
+    HomeEndpoint m_homeEndpoint;
+    PostMessageEndpoint m_postMessageEndpoint;
+    PutFileEndpoint m_putFileEndpoint;
+    GetFileEndpoint m_getFileEndpoint;
+    DeleteFileEndpoint m_deleteFileEndpoint;
+    TraceEndpoint m_traceEndpoint;
+    MetricsEndpoint m_metricsEndpoint;
+
+    OptionsEndpoint m_homeOptions;
+    OptionsEndpoint m_postMessageOptions;
+    OptionsEndpoint m_traceOptions;
+    OptionsEndpoint m_fileOptions;
+    OptionsEndpoint m_metricsOptions;
+
+    Router m_router;
+    ResponseCache m_responseCache;
+};
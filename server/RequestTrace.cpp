@@ -0,0 +1,30 @@
+#include "RequestTrace.h"
+#include <chrono>
+#include <thread>
+
+static double traceTicksPerMicro = 1000.0; // Right for the monotonic clock
+
+void calibrateTraceClock()
+{
+#ifdef HAVE_TSC
+	uint64_t startNs = getMonotonicTimeNs();
+	uint64_t startTicks = readTraceClock();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	uint64_t elapsedNs = getMonotonicTimeNs() - startNs;
+	uint64_t elapsedTicks = readTraceClock() - startTicks;
+	if (elapsedNs > 0 && elapsedTicks > 0)
+	{
+		traceTicksPerMicro = (double)elapsedTicks * 1000.0 / (double)elapsedNs;
+	}
+#endif
+}
+
+uint64_t traceTicksToMicros(uint64_t ticks)
+{
+	return (uint64_t)((double)ticks / traceTicksPerMicro);
+}
+
+uint64_t microsToTraceTicks(uint64_t micros)
+{
+	return (uint64_t)((double)micros * traceTicksPerMicro);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include "TimerWheel.h"
+
+// The trace clock: the CPU's time-stamp counter where there is one (a
+// register read, no system call), the monotonic clock elsewhere. Modern x86
+// CPUs keep an invariant TSC, synchronised across cores, so readings taken
+// on a worker thread and on the reactor can be subtracted.
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define HAVE_TSC 1
+#endif
+
+// USDT probes (provider "nbserver") mark each phase of a request, so bpftrace
+// or perf can attach to a running server, e.g.
+//   bpftrace -e 'usdt:./server:nbserver:handler_end { @[arg1] = count(); }'
+// They are a nop until something attaches, and compile to nothing where
+// <sys/sdt.h> (systemtap-sdt-dev) is missing.
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_SDT 1
+#define TRACE_PROBE2(name, a, b) DTRACE_PROBE2(nbserver, name, a, b)
+#define TRACE_PROBE3(name, a, b, c) DTRACE_PROBE3(nbserver, name, a, b, c)
+#else
+#define TRACE_PROBE2(name, a, b) ((void)0)
+#define TRACE_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+inline uint64_t readTraceClock()
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return getMonotonicTimeNs();
+#endif
+}
+
+// Measures the trace clock against the monotonic clock; takes about 20 ms.
+// Call once at startup, before the conversions below are used.
+void calibrateTraceClock();
+uint64_t traceTicksToMicros(uint64_t ticks);
+uint64_t microsToTraceTicks(uint64_t micros);
+
+// Points in a request's life, in order.
+enum class TracePhase
+{
+	Accepted,      // The connection was accepted; set for its first request only
+	FirstByte,     // The request's first bytes were looked at
+	Parsed,        // The request, body included, was complete
+	HandlerStart,
+	HandlerEnd,
+	FirstByteSent, // The socket took the first byte of the response
+	LastByteSent,
+	Count
+};
+
+// Trace clock readings for one request; 0 for a phase it has not reached
+// (or skipped: a malformed request never gets to a handler).
+struct RequestTimes
+{
+	uint64_t at[(int)TracePhase::Count] = {};
+};
+
+// An answered request whose response is being sent, kept until its last
+// byte goes out and then checked against the slow-request threshold.
+struct RequestTrace
+{
+	static const int MAX_URL_LENGTH = 128;
+
+	RequestTimes times;
+	uint64_t sendEnd = 0; // Send-queue offset just past the response; UINT64_MAX for a streamed body
+	uint16_t status = 0;
+	uint8_t method = 0;   // HttpMethod
+	uint8_t urlLength = 0;
+	char url[MAX_URL_LENGTH];
+};
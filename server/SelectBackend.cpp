@@ -0,0 +1,152 @@
+#include "SelectBackend.h"
+#include <iostream>
+
+bool SelectBackend::init(int maxSockets)
+{
+	FD_ZERO(&m_readSet);
+	FD_ZERO(&m_writeSet);
+	m_registered.clear();
+	m_registered.reserve(maxSockets);
+	m_positionByIndex.assign(maxSockets, -1);
+	return true;
+}
+
+bool SelectBackend::addSocket(SOCKET id, int socketIndex, uint32_t generation, bool)
+{
+#ifndef _WIN32
+	// POSIX fd_sets are bitmaps indexed by descriptor value.
+	if (id >= FD_SETSIZE)
+	{
+		std::cout << "Server: Socket " << id << " exceeds FD_SETSIZE for select()." << std::endl;
+		return false;
+	}
+#endif
+	if (socketIndex >= (int)m_positionByIndex.size())
+	{
+		m_positionByIndex.resize(socketIndex + 1, -1);
+	}
+
+	m_positionByIndex[socketIndex] = (int)m_registered.size();
+	m_registered.push_back({ id, socketIndex, generation });
+	FD_SET(id, &m_readSet);
+	return true;
+}
+
+void SelectBackend::setInterest(SOCKET id, int, bool wantRead, bool wantWrite)
+{
+	if (wantRead)
+	{
+		FD_SET(id, &m_readSet);
+	}
+	else
+	{
+		FD_CLR(id, &m_readSet);
+	}
+
+	if (wantWrite)
+	{
+		FD_SET(id, &m_writeSet);
+	}
+	else
+	{
+		FD_CLR(id, &m_writeSet);
+	}
+}
+
+void SelectBackend::removeSocket(SOCKET id, int socketIndex)
+{
+	if (socketIndex < 0 || socketIndex >= (int)m_positionByIndex.size() || m_positionByIndex[socketIndex] < 0)
+	{
+		return;
+	}
+
+	FD_CLR(id, &m_readSet);
+	FD_CLR(id, &m_writeSet);
+
+	// Swap-remove keeps the registration list dense.
+	int position = m_positionByIndex[socketIndex];
+	m_registered[position] = m_registered.back();
+	m_positionByIndex[m_registered[position].socketIndex] = position;
+	m_registered.pop_back();
+	m_positionByIndex[socketIndex] = -1;
+}
+
+bool SelectBackend::setWakeupEvent(int fd)
+{
+#ifdef _WIN32
+	// WinSock's select() only takes sockets.
+	return false;
+#else
+	if (fd >= FD_SETSIZE)
+	{
+		return false;
+	}
+	m_wakeupFd = fd;
+	FD_SET(fd, &m_readSet);
+	return true;
+#endif
+}
+
+int SelectBackend::wait(std::vector<IoEvent>& events, int timeoutMs)
+{
+	events.clear();
+
+	fd_set readyRead = m_readSet;
+	fd_set readyWrite = m_writeSet;
+
+	SOCKET maxId = m_wakeupFd > 0 ? m_wakeupFd : 0;
+	for (const Registration& registration : m_registered)
+	{
+		if (registration.id > maxId)
+		{
+			maxId = registration.id;
+		}
+	}
+
+	timeval timeout;
+	timeval* timeoutPtr = nullptr;
+	if (timeoutMs >= 0)
+	{
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_usec = (timeoutMs % 1000) * 1000;
+		timeoutPtr = &timeout;
+	}
+
+	// The first argument is ignored by WinSock.
+	int nfd = select((int)maxId + 1, &readyRead, &readyWrite, NULL, timeoutPtr);
+	if (nfd == SOCKET_ERROR)
+	{
+		if (isWouldBlockError(WSAGetLastError()))
+		{
+			return 0;
+		}
+		std::cout << "Server: Error at select(): " << WSAGetLastError() << std::endl;
+		return SOCKET_ERROR;
+	}
+
+	if (m_wakeupFd != -1 && FD_ISSET(m_wakeupFd, &readyRead))
+	{
+		clearWakeupEvent(m_wakeupFd);
+		nfd--;
+	}
+
+	for (const Registration& registration : m_registered)
+	{
+		if ((int)events.size() >= nfd)
+		{
+			break;
+		}
+
+		IoEvent event;
+		event.socketIndex = registration.socketIndex;
+		event.generation = registration.generation;
+		event.readable = FD_ISSET(registration.id, &readyRead) != 0;
+		event.writable = FD_ISSET(registration.id, &readyWrite) != 0;
+		if (event.readable || event.writable)
+		{
+			events.push_back(event);
+		}
+	}
+
+	return (int)events.size();
+}
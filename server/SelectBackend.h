@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include "IEventBackend.h"
+
+// Level-triggered select() backend. Works everywhere WinSock or BSD sockets do.
+// The watched fd_sets are kept up to date incrementally and copied before each
+// select() call instead of being rebuilt from the whole connection table.
+class SelectBackend final : public IEventBackend {
+public:
+    bool init(int maxSockets) override;
+    bool addSocket(SOCKET id, int socketIndex, uint32_t generation, bool isListener) override;
+    void setInterest(SOCKET id, int socketIndex, bool wantRead, bool wantWrite) override;
+    void removeSocket(SOCKET id, int socketIndex) override;
+    int wait(std::vector<IoEvent>& events, int timeoutMs) override;
+    bool isEdgeTriggered() const override { return false; }
+    bool setWakeupEvent(int fd) override;
+    const char* getName() const override { return "select"; }
+
+private:
+    struct Registration
+    {
+        SOCKET id;
+        int socketIndex;
+        uint32_t generation;
+    };
+
+    int m_wakeupFd = -1;
+    fd_set m_readSet;
+    fd_set m_writeSet;
+    std::vector<Registration> m_registered;
+    std::vector<int> m_positionByIndex; // socketIndex -> position in m_registered, or -1
+};
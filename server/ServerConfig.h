@@ -0,0 +1,53 @@
+#pragma once
+
+#include "IEventBackend.h"
+#include "ConnectionPool.h"
+#include "AccessLog.h"
+#include "http/FileCache.h"
+#include <string>
+
+const int HTTP_PORT = 8080;
+
+// Largest request body accepted by an endpoint that streams it to disk.
+const uint64_t DEFAULT_MAX_UPLOAD_BYTES = 1024ull * 1024 * 1024;
+
+// Startup options, parsed once in main() and read-only afterwards.
+struct ServerConfig
+{
+    int port = HTTP_PORT;
+    EventBackendType backendType = getDefaultEventBackend();
+
+    // Number of independent event loops. Each owns its own SocketManager,
+    // SO_REUSEPORT listener and route table, so the kernel spreads new
+    // connections across them and they share nothing on the request path.
+    int reactorCount = 1;
+
+    // Threads shared by all reactors that run blocking endpoint handlers
+    // (file I/O) off the event loops; 0 runs every handler inline.
+    int workerThreads = 0;
+
+    // Per reactor. Connection slots are allocated in slabs as load grows.
+    int maxConnections = DEFAULT_MAX_CONNECTIONS;
+
+    // Memory budget of the file cache shared by all reactors; 0 disables it.
+    size_t fileCacheBytes = DEFAULT_FILE_CACHE_BYTES;
+
+    // Larger request bodies are refused with 413 Content Too Large, before
+    // they are read when the client sends Expect: 100-continue.
+    uint64_t maxUploadBytes = DEFAULT_MAX_UPLOAD_BYTES;
+
+    // Access log file; empty disables it. One request or connection event in
+    // accessLogSampleEvery is logged, and the file is rotated at accessLogMaxBytes.
+    std::string accessLogPath = "access.log";
+    int accessLogSampleEvery = 1;
+    uint64_t accessLogMaxBytes = DEFAULT_ACCESS_LOG_MAX_BYTES;
+
+    // Requests are traced phase by phase when slowRequestMs is above 0, and
+    // those that take at least that long, from first byte to last byte sent,
+    // are written to slowLogPath with their breakdown.
+    int slowRequestMs = 0;
+    std::string slowLogPath = "slow.log";
+
+    // Pin reactor i to CPU i (modulo the CPU count).
+    bool pinReactors = false;
+};
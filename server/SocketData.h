@@ -1,9 +1,17 @@
 #pragma once
 
-#include <winsock2.h>
+#include "Platform.h"
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <ctime>
+#include <vector>
+#include "TimerWheel.h"
+#include "RequestTrace.h"
 #include "http/HttpRequest.h" // Include the HttpRequest class definition
+#include "http/FileBody.h"
+#include "http/IBodySink.h"
+#include "http/IBodySource.h"
+#include "http/ChunkedDecoder.h"
 
 // Defines all possible states a socket can be in.
 enum class SocketStatus {
@@ -14,7 +22,52 @@ enum class SocketStatus {
     SENDING
 };
 
-const int BUFFER_SIZE = 1024;
+// Which deadline a connection's timer is currently enforcing.
+enum class TimeoutKind {
+    None,
+    Idle,   // Keep-alive: waiting for the first byte of the next request
+    Header, // Receiving the request line and headers
+    Body,   // Receiving the request body
+    Send    // Writing the response to a client that is not reading
+};
+
+// How the body of the request being received is read, decided once its headers are in.
+enum class BodyMode {
+    Unchecked, // Headers not seen yet
+    Buffered,  // Left in messageData and parsed by HttpRequest, as a view
+    Streamed,  // Handed to bodySink as it arrives and erased from messageData
+    Dechunked  // Chunked, for an endpoint that wants it buffered: decoded into requestBody
+};
+
+// A piece of a queued response: a range of responseData (status line and
+// headers), or a body part shared with the HttpResponse that produced it.
+struct SendSegment
+{
+    std::shared_ptr<const std::string> body; // Null for a range of responseData or a file
+    std::shared_ptr<const FileBody> file;    // Sent with sendFile() rather than from memory
+    uint64_t offset = 0;
+    uint64_t length = 0;
+
+    // A body still to be produced. Empty until the send cursor reaches it;
+    // each piece pulled from it is queued just ahead of it.
+    std::shared_ptr<IBodySource> source;
+};
+
+// Per-request state of a connection, held only while a request is being
+// received or handled, so that idle connections do not carry a parser.
+struct RequestState
+{
+    // The parsed request object associated with this connection.
+    HttpRequest request;
+
+    // Body of the current request, when it does not stay in messageData.
+    // bodyBytesRead counts decoded body bytes so far.
+    BodyMode bodyMode = BodyMode::Unchecked;
+    std::unique_ptr<IBodySink> bodySink;
+    std::string requestBody;
+    ChunkedDecoder chunkedDecoder;
+    uint64_t bodyBytesRead = 0;
+};
 
 // Holds all state information for a single socket connection.
 struct SocketState
@@ -22,16 +75,75 @@ struct SocketState
     SOCKET id = 0;
     SocketStatus status = SocketStatus::EMPTY;
 
-    // Buffers and tracking for network I/O
-    char buffer[BUFFER_SIZE];
-    std::string messageData; // Accumulates the full request/response string
-    int bytesSent = 0;
-    int bytesToSend = 0;
+    // Bumped whenever the slot is released; see ConnectionHandle.
+    uint32_t generation = 0;
 
-    // Timeout tracking
-    time_t lastActivityTime = 0;
+    // Buffers and tracking for network I/O. Reads go through a scratch buffer
+    // owned by SocketManager, so an idle connection holds no receive buffer.
+    std::string messageData;  // Accumulates the incoming request
+    std::string responseData; // Status lines and headers of the queued responses; keeps its capacity between responses
 
-    // The parsed request object associated with this connection.
-    HttpRequest request;
+    // Queued responses, sent as one gathered write. sendSegment and
+    // segmentOffset mark how far sending has got.
+    std::vector<SendSegment> sendQueue;
+    size_t sendSegment = 0;
+    uint64_t segmentOffset = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesToSend = 0;
+
+    // Completion-based backends read file segments through this chunk, one
+    // send at a time, so a connection never holds more than FILE_CHUNK_SIZE of a file.
+    std::vector<char> fileChunk;
+
+    // Completion-based backends: bytes appended to messageData by finished
+    // receives that the state machine has not looked at yet, and the number
+    // of send submissions still owned by the kernel.
+    int bytesReceived = 0;
+    int sendsInFlight = 0;
+
+    // Completion-based backends: bytes that completed after bytesReceived had
+    // reached MAX_RECEIVE_BYTES, while the paused recv was being cancelled.
+    // receiveData() moves them into messageData within the same budget.
+    std::string receiveBacklog;
+
+    // Start of the first unanswered request in messageData. Pipelined requests
+    // before it have been answered; they are erased once the batch is done.
+    size_t parseOffset = 0;
+
+    // Set when the backend reported readable data that could not be read yet
+    // (e.g. while a response was still being sent). Edge-triggered backends will
+    // not report it again, so it is drained once the socket is RECEIVING again.
+    bool readPending = false;
+
+    // Timeout tracking: a single timer, moved between deadlines as the connection changes phase.
+    TimerNode timer;
+    TimeoutKind timeoutKind = TimeoutKind::None;
+
+    // Parser and body state of the request being received. Only connections
+    // with unanswered bytes hold one; a keep-alive connection waiting for its
+    // next request does not. See ConnectionPool::attachRequestState().
+    std::unique_ptr<RequestState> requestState;
+
+    // The connection is closed once the queued responses are sent, e.g.
+    // after refusing a body the client may still be sending.
+    bool closeAfterSend = false;
+
+    // Request timing for the metrics, in monotonic nanoseconds: when the
+    // current request was first looked at (0 between requests), and how long
+    // the parse() call that produced its headers took.
+    uint64_t requestStartNs = 0;
+    uint64_t parseNs = 0;
+
+    // Request tracing (--slow-request-ms): the phases the current request has
+    // reached, and the answered requests whose responses are still being sent,
+    // from sentTrace on.
+    RequestTimes trace;
+    std::vector<RequestTrace> sendTraces;
+    size_t sentTrace = 0;
+
+    // The current request is being handled on a worker thread. Nothing after
+    // it is parsed or sent until its response is back, so responses keep
+    // their order.
+    bool requestInFlight = false;
 };
 
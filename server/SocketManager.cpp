@@ -2,54 +2,86 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "SocketManager.h"
+#include <cstring>
 #include <iostream>
 
+#ifdef _WIN32
 #pragma comment(lib, "Ws2_32.lib")
+#endif
 
-SocketManager::SocketManager() : activeSocketsCount(0)
+SocketManager::SocketManager(EventBackendType backendType, int maxConnections)
+	: connections(maxConnections), receiveBuffer(RECEIVE_BUFFER_SIZE), backendType(backendType),
+	now(getMonotonicTimeMs()), timers(now)
 {
-	sockets.resize(MAX_SOCKETS);
 }
 
 SocketManager::~SocketManager()
 {
-	for (int i = 0; i < MAX_SOCKETS; ++i)
+	for (int i = 0; i < connections.getCapacity(); ++i)
 	{
-		if (sockets[i].status != SocketStatus::EMPTY)
+		if (connections.get(i).status != SocketStatus::EMPTY)
 		{
-			closesocket(sockets[i].id);
+			closesocket(connections.get(i).id);
 		}
 	}
-	WSACleanup();
+	backend.reset();
+	if (wakeupFd != -1)
+	{
+		closeFile(wakeupFd);
+	}
+	cleanupSocketLibrary();
 }
 
-bool SocketManager::init()
+bool SocketManager::init(int port, bool reusePort)
 {
-	WSAData wsaData;
-	if (NO_ERROR != WSAStartup(MAKEWORD(2, 2), &wsaData))
+	if (!initSocketLibrary())
 	{
 		std::cout << "Server: Error at WSAStartup()\n";
 		return false;
 	}
 
+	backend = createEventBackend(backendType);
+	if (!backend || !backend->init(connections.getMaxConnections()))
+	{
+		std::cout << "Server: Failed to initialize the event backend." << std::endl;
+		cleanupSocketLibrary();
+		return false;
+	}
+
 	SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 	if (listenSocket == INVALID_SOCKET)
 	{
 		std::cout << "Server: Error at socket(): " << WSAGetLastError() << std::endl;
-		WSACleanup();
+		cleanupSocketLibrary();
+		return false;
+	}
+
+	int reuse = 1;
+#ifndef _WIN32
+	// Allow quick restarts while old connections sit in TIME_WAIT.
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+#ifdef SO_REUSEPORT
+	if (reusePort && setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuse, sizeof(reuse)) == SOCKET_ERROR)
+	{
+		std::cout << "Server: Error at setsockopt(SO_REUSEPORT): " << WSAGetLastError() << std::endl;
+		closesocket(listenSocket);
+		cleanupSocketLibrary();
 		return false;
 	}
+#endif
 
 	sockaddr_in serverService;
 	serverService.sin_family = AF_INET;
 	serverService.sin_addr.s_addr = INADDR_ANY;
-	serverService.sin_port = htons(HTTP_PORT);
+	serverService.sin_port = htons(port);
 
 	if (bind(listenSocket, (SOCKADDR*)&serverService, sizeof(serverService)) == SOCKET_ERROR)
 	{
 		std::cout << "Server: Error at bind(): " << WSAGetLastError() << std::endl;
 		closesocket(listenSocket);
-		WSACleanup();
+		cleanupSocketLibrary();
 		return false;
 	}
 
@@ -57,7 +89,7 @@ bool SocketManager::init()
 	{
 		std::cout << "Server: Error at listen(): " << WSAGetLastError() << std::endl;
 		closesocket(listenSocket);
-		WSACleanup();
+		cleanupSocketLibrary();
 		return false;
 	}
 
@@ -65,211 +97,866 @@ bool SocketManager::init()
 	{
 		std::cout << "Server: Failed to add listening socket." << std::endl;
 		closesocket(listenSocket);
-		WSACleanup();
+		cleanupSocketLibrary();
 		return false;
 	}
 
-	std::cout << "Server is listening on port " << HTTP_PORT << std::endl;
+	std::cout << "Server is listening on port " << port << " (" << backend->getName() << " backend)" << std::endl;
+	std::cout << "Server: Up to " << connections.getMaxConnections() << " connections, "
+		<< ConnectionPool::getIdleConnectionBytes() << " bytes per idle connection, "
+		<< ConnectionPool::getActiveRequestBytes() << " more while a request is in progress." << std::endl;
 	return true;
 }
 
-void SocketManager::buildFdSets(fd_set& waitRecv, fd_set& waitSend)
+int SocketManager::waitForEvents(std::vector<IoEvent>& events, int timeoutMs)
 {
-	FD_ZERO(&waitRecv);
-	FD_ZERO(&waitSend);
+	int count = backend->wait(events, timeoutMs);
+	now = getMonotonicTimeMs();
+	dateCache.refresh(time(nullptr));
+	if (count == SOCKET_ERROR || !backend->isCompletionBased())
+	{
+		return count;
+	}
 
-	for (int i = 0; i < MAX_SOCKETS; ++i)
+	// A completion-based backend already did the I/O. Apply the results to the
+	// connection table and only hand the state machine the sockets with work left.
+	// Applying one completion can release and reuse a slot, so stale ones are
+	// filtered here rather than up front.
+	size_t remaining = 0;
+	for (size_t i = 0; i < events.size(); i++)
 	{
-		if (sockets[i].status == SocketStatus::LISTENING || sockets[i].status == SocketStatus::RECEIVING) {
-			FD_SET(sockets[i].id, &waitRecv);
-		}
-		else if (sockets[i].status == SocketStatus::SENDING)
+		if (applyCompletion(events[i]))
 		{
-			FD_SET(sockets[i].id, &waitSend);
+			events[remaining++] = events[i];
 		}
 	}
+	events.resize(remaining);
+	return (int)remaining;
 }
 
-bool SocketManager::acceptNewConnection(int listenerSocketIndex)
+// Returns true if the state machine should look at the socket afterwards.
+bool SocketManager::applyCompletion(IoEvent& event)
 {
-	sockaddr_in from;
-	int fromLen = sizeof(from);
-	SOCKET newSocket = accept(sockets[listenerSocketIndex].id, (SOCKADDR*)&from, &fromLen);
+	if (!isCurrent(event))
+	{
+		return false;
+	}
 
-	if (newSocket == INVALID_SOCKET)
+	switch (event.completion)
 	{
-		if (WSAGetLastError() != WSAEWOULDBLOCK)
+	case IoCompletion::Accepted:
+		if (!addSocket(event.acceptedSocket, SocketStatus::RECEIVING))
+		{
+			logConnection(AccessEvent::Rejected, event.acceptedSocket);
+			closesocket(event.acceptedSocket);
+		}
+		else
 		{
-			std::cout << "Server: Error at accept(): " << WSAGetLastError() << std::endl;
+			logConnection(AccessEvent::Connect, event.acceptedSocket);
 		}
 		return false;
+
+	case IoCompletion::Received:
+	{
+		SocketState& socket = connections.get(event.socketIndex);
+		if (socket.bytesReceived >= MAX_RECEIVE_BYTES || !socket.receiveBacklog.empty())
+		{
+			// The state machine has not caught up yet: keep the bytes aside, in
+			// order, rather than growing messageData (see receiveData()).
+			socket.receiveBacklog.append(event.data, event.result);
+			socket.readPending = true;
+		}
+		else
+		{
+			socket.messageData.append(event.data, event.result);
+			socket.bytesReceived += event.result;
+		}
+		// Over budget: stop receiving until receiveData() has handed this much over,
+		// as a readiness backend leaves the rest in the kernel.
+		if (socket.bytesReceived >= MAX_RECEIVE_BYTES)
+		{
+			backend->setInterest(socket.id, event.socketIndex, false, false);
+		}
+		if (metrics)
+		{
+			metrics->addBytesReceived((uint64_t)event.result);
+		}
+		event.readable = true;
+		return true;
 	}
 
-	std::cout << "Server: Client " << inet_ntoa(from.sin_addr) << ":" << ntohs(from.sin_port) << " is connected." << std::endl;
+	case IoCompletion::Sent:
+	{
+		SocketState& socket = connections.get(event.socketIndex);
+		if (socket.status != SocketStatus::SENDING)
+		{
+			return false;
+		}
+		socket.sendsInFlight--;
+		advanceSendQueue(socket, event.result);
 
-	if (!addSocket(newSocket, SocketStatus::RECEIVING))
+		if (socket.sendsInFlight > 0)
+		{
+			armTimeout(event.socketIndex, TimeoutKind::Send);
+			return false;
+		}
+		if (!isSendComplete(socket))
+		{
+			// A short send (e.g. interrupted by a signal), or the next piece of a body source: queue the rest.
+			armTimeout(event.socketIndex, TimeoutKind::Send);
+			sendData(event.socketIndex);
+			return false;
+		}
+		completeSend(event.socketIndex);
+		if (socket.status == SocketStatus::EMPTY)
+		{
+			return false;
+		}
+		event.writable = true;
+		return true;
+	}
+
+	case IoCompletion::Closed:
+		removeSocket(event.socketIndex);
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+// Accepts every pending connection; the listener is non-blocking, so this stops at WSAEWOULDBLOCK.
+bool SocketManager::acceptNewConnection(int listenerSocketIndex)
+{
+	bool acceptedAny = false;
+
+	while (true)
 	{
-		std::cout << "\t\tToo many connections, dropped client." << std::endl;
-		closesocket(newSocket);
+		sockaddr_in from;
+		socklen_t fromLen = sizeof(from);
+		SOCKET newSocket = accept(connections.get(listenerSocketIndex).id, (SOCKADDR*)&from, &fromLen);
+
+		if (newSocket == INVALID_SOCKET)
+		{
+			if (!isWouldBlockError(WSAGetLastError()))
+			{
+				std::cout << "Server: Error at accept(): " << WSAGetLastError() << std::endl;
+			}
+			return acceptedAny;
+		}
+
+		acceptedAny = true;
+
+		if (!addSocket(newSocket, SocketStatus::RECEIVING))
+		{
+			logConnection(AccessEvent::Rejected, newSocket);
+			closesocket(newSocket);
+		}
+		else
+		{
+			logConnection(AccessEvent::Connect, newSocket, from.sin_addr.s_addr, ntohs(from.sin_port));
+		}
 	}
-	return true;
 }
 
+// Reads until the socket would block. Returns the number of bytes appended to
+// messageData, 0 if the peer closed the connection, or SOCKET_ERROR if nothing
+// could be read (the socket is removed if the error was fatal).
 int SocketManager::receiveData(int socketIndex)
 {
-	SocketState& socket = sockets[socketIndex];
+	SocketState& socket = connections.get(socketIndex);
+	int totalRead = 0;
 
-	int bytesRead = recv(socket.id, socket.buffer, BUFFER_SIZE, 0);
+	// Completion-based backends have already appended the data in waitForEvents().
+	if (backend->isCompletionBased())
+	{
+		totalRead = socket.bytesReceived;
+		socket.bytesReceived = 0;
+		if (!socket.receiveBacklog.empty())
+		{
+			size_t budget = totalRead < MAX_RECEIVE_BYTES ? (size_t)(MAX_RECEIVE_BYTES - totalRead) : 0;
+			size_t moved = socket.receiveBacklog.length() < budget ? socket.receiveBacklog.length() : budget;
+			socket.messageData.append(socket.receiveBacklog, 0, moved);
+			socket.receiveBacklog.erase(0, moved);
+			totalRead += (int)moved;
+		}
+		if (!socket.receiveBacklog.empty())
+		{
+			socket.readPending = true;
+		}
+		else if (socket.status == SocketStatus::RECEIVING)
+		{
+			// Lifts a pause for going over the budget.
+			backend->setInterest(socket.id, socketIndex, true, false);
+		}
+		return totalRead > 0 ? totalRead : SOCKET_ERROR;
+	}
 
-	if (bytesRead == SOCKET_ERROR)
+	while (true)
 	{
-		if (WSAGetLastError() != WSAEWOULDBLOCK)
+		int bytesRead = recv(socket.id, receiveBuffer.data(), RECEIVE_BUFFER_SIZE, 0);
+
+		if (bytesRead == SOCKET_ERROR)
+		{
+			if (!isWouldBlockError(WSAGetLastError()))
+			{
+				std::cout << "Server: Error at recv(): " << WSAGetLastError() << std::endl;
+				removeSocket(socketIndex);
+				return SOCKET_ERROR;
+			}
+			break;
+		}
+
+		if (bytesRead == 0)
 		{
-			std::cout << "Server: Error at recv(): " << WSAGetLastError() << std::endl;
 			removeSocket(socketIndex);
+			return 0;
+		}
+
+		// Append received data from the shared scratch buffer to the main message string.
+		socket.messageData.append(receiveBuffer.data(), bytesRead);
+		totalRead += bytesRead;
+
+		// A short read means the kernel buffer is empty; skip the extra recv() that would only return WOULDBLOCK.
+		if (bytesRead < RECEIVE_BUFFER_SIZE)
+		{
+			break;
 		}
+
+		// The rest is read once this much has been processed (see readPending).
+		if (totalRead >= MAX_RECEIVE_BYTES)
+		{
+			socket.readPending = true;
+			break;
+		}
+	}
+
+	if (totalRead == 0)
+	{
 		return SOCKET_ERROR;
 	}
+	if (metrics)
+	{
+		metrics->addBytesReceived((uint64_t)totalRead);
+	}
+
+	return totalRead;
+}
 
-	if (bytesRead == 0)
+// Appends a response to the connection's send queue. The status line and
+// headers are serialized into responseData; the body joins the queue by
+// reference. A range that directly follows the previous one in responseData
+// extends it, so back-to-back bodiless responses cost a single buffer.
+void SocketManager::queueResponse(int socketIndex, const HttpResponse& response, bool includeBody)
+{
+	SocketState& socket = connections.get(socketIndex);
+
+	size_t headerStart = socket.responseData.length();
+	response.serializeHeaders(socket.responseData, dateCache.getHeaderLine());
+	queueResponseData(socket, headerStart);
+
+	if (includeBody && response.getBodySource())
 	{
-		removeSocket(socketIndex);
-		return 0;
+		SendSegment segment;
+		segment.source = response.getBodySource();
+		socket.sendQueue.push_back(std::move(segment));
 	}
+	else if (includeBody)
+	{
+		for (const BodyPart& part : response.getBodyParts())
+		{
+			socket.sendQueue.push_back({ part.data, part.file, part.offset, part.length, nullptr });
+		}
+		socket.bytesToSend += response.getBodyLength();
+	}
+}
 
-	// Append received data from the temporary char buffer to the main message string.
-	socket.messageData.append(socket.buffer, bytesRead);
-	socket.lastActivityTime = time(nullptr);
+void SocketManager::queueSerializedResponse(int socketIndex, std::shared_ptr<const std::string> bytes, size_t length)
+{
+	SocketState& socket = connections.get(socketIndex);
+	socket.sendQueue.push_back({ std::move(bytes), nullptr, 0, length, nullptr });
+	socket.bytesToSend += length;
+}
 
-	return bytesRead;
+void SocketManager::queueInterimResponse(int socketIndex, HttpStatusCode code)
+{
+	SocketState& socket = connections.get(socketIndex);
+
+	size_t start = socket.responseData.length();
+	socket.responseData.append(getStatusLine(code)).append("\r\n");
+	queueResponseData(socket, start);
 }
 
-int SocketManager::sendData(int socketIndex)
+// Queues responseData from start to its end.
+void SocketManager::queueResponseData(SocketState& socket, size_t start)
 {
-	SocketState& socket = sockets[socketIndex];
-	int bytesRemaining = socket.bytesToSend - socket.bytesSent;
+	size_t length = socket.responseData.length() - start;
 
-	if (bytesRemaining <= 0)
+	const SendSegment* last = socket.sendQueue.empty() ? nullptr : &socket.sendQueue.back();
+	if (last && !last->body && !last->file && !last->source && last->offset + last->length == start)
 	{
-		return 0;
+		socket.sendQueue.back().length += length;
 	}
+	else
+	{
+		socket.sendQueue.push_back({ nullptr, nullptr, start, length, nullptr });
+	}
+	socket.bytesToSend += length;
+}
 
-	// Send data directly from the messageData string, using an offset for partial sends.
-	const char* dataToSend = socket.messageData.c_str();
-	int bytesSent = send(socket.id, dataToSend + socket.bytesSent, bytesRemaining, 0);
+// Describes the unsent in-memory segments at the front of the send queue, at
+// most maxCount of them; stops at the first file or body source segment.
+int SocketManager::getPendingBuffers(const SocketState& socket, IoBuffer* buffers, int maxCount) const
+{
+	int count = 0;
+	uint64_t offset = socket.segmentOffset;
+	for (size_t i = socket.sendSegment; i < socket.sendQueue.size() && count < maxCount; i++)
+	{
+		const SendSegment& segment = socket.sendQueue[i];
+		if (segment.file || segment.source)
+		{
+			break;
+		}
+		const char* base = segment.body ? segment.body->data() : socket.responseData.data();
+		buffers[count].data = base + segment.offset + offset;
+		buffers[count].length = (int)(segment.length - offset);
+		count++;
+		offset = 0;
+	}
+	return count;
+}
 
-	if (bytesSent == SOCKET_ERROR)
+// Moves the send cursor past bytes the socket has accepted.
+void SocketManager::advanceSendQueue(SocketState& socket, uint64_t bytes)
+{
+	socket.bytesSent += bytes;
+	if (metrics)
 	{
-		if (WSAGetLastError() != WSAEWOULDBLOCK)
+		metrics->addBytesSent(bytes);
+	}
+	if (socket.sentTrace < socket.sendTraces.size())
+	{
+		advanceTraces(socket, false);
+	}
+	while (bytes > 0 && socket.sendSegment < socket.sendQueue.size())
+	{
+		uint64_t remaining = socket.sendQueue[socket.sendSegment].length - socket.segmentOffset;
+		if (bytes < remaining)
 		{
-			std::cout << "Server: Error at send(): " << WSAGetLastError() << std::endl;
-			removeSocket(socketIndex);
+			socket.segmentOffset += bytes;
+			return;
 		}
+		bytes -= remaining;
+		socket.sendSegment++;
+		socket.segmentOffset = 0;
+	}
+}
+
+// Completion-based backends: reads the next piece of the current file segment
+// into the connection's chunk buffer and queues it as one send.
+bool SocketManager::submitFileChunk(int socketIndex)
+{
+	SocketState& socket = connections.get(socketIndex);
+	const SendSegment& segment = socket.sendQueue[socket.sendSegment];
+
+	uint64_t remaining = segment.length - socket.segmentOffset;
+	size_t length = remaining < (uint64_t)FILE_CHUNK_SIZE ? (size_t)remaining : FILE_CHUNK_SIZE;
+	socket.fileChunk.resize(FILE_CHUNK_SIZE);
+
+	long long bytesRead = readFileAt(segment.file->getDescriptor(), socket.fileChunk.data(), length, segment.offset + socket.segmentOffset);
+	if (bytesRead <= 0)
+	{
+		std::cout << "Server: Error reading a file for socket " << socket.id << "." << std::endl;
+		return false;
+	}
+
+	IoBuffer chunk = { socket.fileChunk.data(), (int)bytesRead };
+	if (!backend->submitSend(socket.id, socketIndex, &chunk, 1))
+	{
+		return false;
+	}
+	socket.sendsInFlight = 1;
+	return true;
+}
+
+// Called with the send cursor on a body source: everything queued before it
+// has been sent. Pulls the next piece, frames it as a chunk and queues it
+// ahead of the source; after the last piece the source is replaced by the
+// terminating chunk. The sent front of the queue is dropped first, so a long
+// stream does not grow the queue.
+bool SocketManager::pullBodySource(SocketState& socket)
+{
+	socket.sendQueue.erase(socket.sendQueue.begin(), socket.sendQueue.begin() + socket.sendSegment);
+	socket.sendSegment = 0;
+	socket.segmentOffset = 0;
+
+	// The size line is reserved up front and filled in afterwards, so the
+	// piece is read straight into the buffer it is sent from. Leading zeros
+	// in a chunk size are allowed (RFC 9112, section 7.1).
+	static const char sizeLine[] = "00000000\r\n";
+	const size_t sizeLength = sizeof(sizeLine) - 1;
+	auto chunk = std::make_shared<std::string>();
+	chunk->reserve(sizeLength + BODY_SOURCE_CHUNK_SIZE + 7);
+	chunk->assign(sizeLine, sizeLength);
+
+	std::shared_ptr<IBodySource> source = socket.sendQueue[0].source;
+	BodySourceResult result = source->read(*chunk, BODY_SOURCE_CHUNK_SIZE);
+	size_t length = chunk->length() - sizeLength;
+	if (result == BodySourceResult::Error || length > BODY_SOURCE_CHUNK_SIZE || (result == BodySourceResult::More && length == 0))
+	{
+		std::cout << "Server: Body source failed for socket " << socket.id << "." << std::endl;
+		return false;
+	}
+
+	static const char hexDigits[] = "0123456789abcdef";
+	for (size_t i = 0; i < 8; i++)
+	{
+		(*chunk)[7 - i] = hexDigits[(length >> (4 * i)) & 0xf];
+	}
+	if (length > 0)
+	{
+		chunk->append("\r\n");
+	}
+	else
+	{
+		chunk->clear();
+	}
+	if (result == BodySourceResult::Done)
+	{
+		chunk->append("0\r\n\r\n");
+	}
+
+	uint64_t chunkLength = chunk->length();
+	socket.bytesToSend += chunkLength;
+	if (result == BodySourceResult::Done)
+	{
+		socket.sendQueue[0] = { std::move(chunk), nullptr, 0, chunkLength, nullptr };
+	}
+	else
+	{
+		socket.sendQueue.insert(socket.sendQueue.begin(), { std::move(chunk), nullptr, 0, chunkLength, nullptr });
+	}
+	return true;
+}
+
+// True once everything queued has been sent and no body source is left to pull.
+bool SocketManager::isSendComplete(const SocketState& socket) const
+{
+	return socket.bytesSent >= socket.bytesToSend &&
+		(socket.sendSegment >= socket.sendQueue.size() || !socket.sendQueue[socket.sendSegment].source);
+}
+
+// Sends until the queue is drained or the socket would block. In-memory
+// segments are gathered, up to MAX_SEND_BUFFERS at a time, into one
+// writev-style send; file segments go out through sendFile().
+long long SocketManager::sendData(int socketIndex)
+{
+	SocketState& socket = connections.get(socketIndex);
+	IoBuffer buffers[MAX_SEND_BUFFERS];
+	long long totalSent = 0;
+
+	// Completion-based backends: hand the next part of the queue to the kernel
+	// as linked sends; the Sent completions advance it in waitForEvents().
+	const bool atSource = socket.sendSegment < socket.sendQueue.size() && socket.sendQueue[socket.sendSegment].source;
+	if (atSource && socket.sendsInFlight == 0 && !pullBodySource(socket))
+	{
+		removeSocket(socketIndex);
 		return SOCKET_ERROR;
 	}
 
-	socket.bytesSent += bytesSent;
-	socket.lastActivityTime = time(nullptr);
+	if (backend->isCompletionBased())
+	{
+		if (socket.sendsInFlight == 0 && socket.bytesSent < socket.bytesToSend)
+		{
+			bool submitted;
+			if (socket.sendQueue[socket.sendSegment].file)
+			{
+				submitted = submitFileChunk(socketIndex);
+			}
+			else
+			{
+				int count = getPendingBuffers(socket, buffers, MAX_SEND_BUFFERS);
+				submitted = backend->submitSend(socket.id, socketIndex, buffers, count);
+				socket.sendsInFlight = count;
+			}
+			if (!submitted)
+			{
+				removeSocket(socketIndex);
+				return SOCKET_ERROR;
+			}
+		}
+		return 0;
+	}
+
+	SendBuffer sendBuffers[MAX_SEND_BUFFERS];
+	while (socket.bytesSent < socket.bytesToSend)
+	{
+		const SendSegment& segment = socket.sendQueue[socket.sendSegment];
+		long long bytesSent;
+		if (segment.file)
+		{
+			bytesSent = sendFile(socket.id, segment.file->getDescriptor(), segment.offset + socket.segmentOffset, (size_t)(segment.length - socket.segmentOffset));
+			if (bytesSent == 0)
+			{
+				std::cout << "Server: File for socket " << socket.id << " ended early." << std::endl;
+				removeSocket(socketIndex);
+				return SOCKET_ERROR;
+			}
+		}
+		else
+		{
+			int count = getPendingBuffers(socket, buffers, MAX_SEND_BUFFERS);
+			for (int i = 0; i < count; i++)
+			{
+				setSendBuffer(sendBuffers[i], buffers[i].data, buffers[i].length);
+			}
+			// Hold the headers back briefly if a file or produced body follows, so both can share packets.
+			size_t next = socket.sendSegment + count;
+			bool bodyFollows = next < socket.sendQueue.size() && (socket.sendQueue[next].file || socket.sendQueue[next].source);
+			bytesSent = ::sendBuffers(socket.id, sendBuffers, count, bodyFollows);
+		}
+
+		if (bytesSent == SOCKET_ERROR)
+		{
+			if (!isWouldBlockError(WSAGetLastError()))
+			{
+				std::cout << "Server: Error at send(): " << WSAGetLastError() << std::endl;
+				removeSocket(socketIndex);
+				return SOCKET_ERROR;
+			}
+			break;
+		}
+
+		advanceSendQueue(socket, (uint64_t)bytesSent);
+		totalSent += bytesSent;
+
+		if (socket.sendSegment < socket.sendQueue.size() && socket.sendQueue[socket.sendSegment].source && !pullBodySource(socket))
+		{
+			removeSocket(socketIndex);
+			return SOCKET_ERROR;
+		}
+	}
 
 	// If all data has been sent, reset the state for the next request.
-	if (socket.bytesSent >= socket.bytesToSend)
+	if (isSendComplete(socket))
+	{
+		completeSend(socketIndex);
+	}
+	else if (totalSent > 0)
 	{
-		socket.bytesSent = 0;
-		socket.bytesToSend = 0;
-		socket.messageData.clear();
-		socket.status = SocketStatus::RECEIVING;
+		armTimeout(socketIndex, TimeoutKind::Send);
 	}
 
-	return bytesSent;
+	return totalSent;
+}
+
+void SocketManager::completeSend(int socketIndex)
+{
+	SocketState& socket = connections.get(socketIndex);
+	TRACE_PROBE2(response_sent, accessLogIndex, (int64_t)socket.id);
+	if (!socket.sendTraces.empty())
+	{
+		advanceTraces(socket, true);
+		socket.sendTraces.clear();
+		socket.sentTrace = 0;
+	}
+	socket.bytesSent = 0;
+	socket.bytesToSend = 0;
+	socket.responseData.clear();
+	socket.sendQueue.clear(); // Drops the references to the bodies and files
+	if (!socket.fileChunk.empty())
+	{
+		std::vector<char>().swap(socket.fileChunk);
+	}
+	socket.sendSegment = 0;
+	socket.segmentOffset = 0;
+	if (socket.closeAfterSend)
+	{
+		removeSocket(socketIndex);
+		return;
+	}
+	setSocketStatus(socketIndex, SocketStatus::RECEIVING);
+}
+
+// Changes a socket's state and tells the backend which direction to watch.
+void SocketManager::setSocketStatus(int socketIndex, SocketStatus status)
+{
+	SocketState& socket = connections.get(socketIndex);
+	if (metrics)
+	{
+		metrics->changeSocketStatus(socket.status, status);
+	}
+	socket.status = status;
+
+	if (status == SocketStatus::RECEIVING)
+	{
+		// Held-back input comes first; receiveData() resumes reading once it is used up.
+		backend->setInterest(socket.id, socketIndex, socket.receiveBacklog.empty(), false);
+		armTimeout(socketIndex, TimeoutKind::Idle);
+	}
+	else if (status == SocketStatus::SENDING)
+	{
+		backend->setInterest(socket.id, socketIndex, false, true);
+		armTimeout(socketIndex, TimeoutKind::Send);
+	}
+	else if (status == SocketStatus::PROCESSING)
+	{
+		backend->setInterest(socket.id, socketIndex, false, false);
+		armTimeout(socketIndex, TimeoutKind::None);
+	}
 }
 
 void SocketManager::removeSocket(int socketIndex)
 {
-	if (socketIndex < 0 || socketIndex >= MAX_SOCKETS || sockets[socketIndex].status == SocketStatus::EMPTY)
+	if (socketIndex < 0 || socketIndex >= connections.getCapacity() || connections.get(socketIndex).status == SocketStatus::EMPTY)
 	{
 		return;
 	}
 
-	std::cout << "Server: Closing connection for socket " << sockets[socketIndex].id << std::endl;
+	SocketState& socket = connections.get(socketIndex);
+	logConnection(AccessEvent::Close, socket.id);
+	if (metrics)
+	{
+		metrics->changeSocketStatus(socket.status, SocketStatus::EMPTY);
+	}
+
+	backend->removeSocket(socket.id, socketIndex);
+	timers.cancel(socket.timer);
+	closesocket(socket.id);
+	connections.release(socketIndex);
+}
+
+static const char* timeoutKindToString(TimeoutKind kind)
+{
+	switch (kind)
+	{
+	case TimeoutKind::Idle: return "idle";
+	case TimeoutKind::Header: return "header";
+	case TimeoutKind::Body: return "body";
+	case TimeoutKind::Send: return "send";
+	default: return "none";
+	}
+}
+
+void SocketManager::armTimeout(int socketIndex, TimeoutKind kind)
+{
+	SocketState& socket = connections.get(socketIndex);
+	socket.timeoutKind = kind;
+
+	int seconds = 0;
+	switch (kind)
+	{
+	case TimeoutKind::Idle: seconds = IDLE_TIMEOUT_SECONDS; break;
+	case TimeoutKind::Header: seconds = HEADER_TIMEOUT_SECONDS; break;
+	case TimeoutKind::Body: seconds = BODY_TIMEOUT_SECONDS; break;
+	case TimeoutKind::Send: seconds = SEND_TIMEOUT_SECONDS; break;
+	default:
+		timers.cancel(socket.timer);
+		return;
+	}
+	timers.schedule(socket.timer, now + (uint64_t)seconds * 1000);
+}
 
-	closesocket(sockets[socketIndex].id);
-	sockets[socketIndex].status = SocketStatus::EMPTY;
-	sockets[socketIndex].id = 0;
-	activeSocketsCount--;
+int SocketManager::getNextTimeoutMs() const
+{
+	return timers.getTimeoutMs(now);
 }
 
-void SocketManager::checkTimeouts()
+void SocketManager::expireTimeouts()
 {
-	time_t currentTime = time(nullptr);
-	for (int i = 0; i < MAX_SOCKETS; i++)
+	expiredTimers.clear();
+	timers.advance(now, expiredTimers);
+
+	for (int socketIndex : expiredTimers)
 	{
-		if (sockets[i].status != SocketStatus::EMPTY && sockets[i].status != SocketStatus::LISTENING)
+		const SocketState& socket = connections.get(socketIndex);
+		logConnection(AccessEvent::Timeout, socket.id, 0, 0, timeoutKindToString(socket.timeoutKind));
+		if (metrics)
 		{
-			if (difftime(currentTime, sockets[i].lastActivityTime) > SOCKET_TIMEOUT_SECONDS)
-			{
-				std::cout << "Server: Socket " << sockets[i].id << " timed out." << std::endl;
-				removeSocket(i);
-			}
+			metrics->addTimeout(socket.timeoutKind);
 		}
+		removeSocket(socketIndex);
 	}
 }
 
-SocketState& SocketManager::getSocketState(int socketIndex)
+bool SocketManager::isCurrent(const IoEvent& event) const
 {
-	return sockets[socketIndex];
+	ConnectionHandle handle;
+	handle.index = event.socketIndex;
+	handle.generation = event.generation;
+	return connections.isValid(handle);
 }
 
-const std::vector<SocketState>& SocketManager::getSockets() const
+void SocketManager::setAccessLog(AccessLog* log, int reactorIndex)
 {
-	return sockets;
+	accessLog = log;
+	accessLogIndex = reactorIndex;
 }
 
-bool SocketManager::addSocket(SOCKET id, SocketStatus status)
+void SocketManager::setMetrics(ReactorMetrics* reactorMetrics)
 {
-	// For the listening socket, we want to ensure it gets the first slot.
-	if (status == SocketStatus::LISTENING) {
-		if (sockets[0].status == SocketStatus::EMPTY) {
-			sockets[0].id = id;
-			sockets[0].status = status;
-			sockets[0].lastActivityTime = time(nullptr);
-			activeSocketsCount++;
-			return true;
+	metrics = reactorMetrics;
+}
+
+void SocketManager::setSlowLog(AccessLog* log, uint64_t thresholdTicks)
+{
+	slowLog = log;
+	slowRequestTicks = thresholdTicks;
+}
+
+void SocketManager::traceResponse(int socketIndex, const HttpRequest& request, HttpStatusCode status)
+{
+	SocketState& socket = connections.get(socketIndex);
+
+	// The queue offsets of anything behind a streamed body are unknown until
+	// it has been produced, so those responses end with the send.
+	bool streamed = (!socket.sendTraces.empty() && socket.sendTraces.back().sendEnd == UINT64_MAX) ||
+		(!socket.sendQueue.empty() && socket.sendQueue.back().source);
+
+	socket.sendTraces.emplace_back();
+	RequestTrace& trace = socket.sendTraces.back();
+	trace.times = socket.trace;
+	trace.sendEnd = streamed ? UINT64_MAX : socket.bytesToSend;
+	trace.status = (uint16_t)status;
+	trace.method = (uint8_t)request.getMethod();
+	std::string_view url = request.getRawUrl();
+	trace.urlLength = (uint8_t)(url.length() < sizeof(trace.url) ? url.length() : sizeof(trace.url));
+	std::memcpy(trace.url, url.data(), trace.urlLength);
+
+	socket.trace = RequestTimes();
+}
+
+// Stamps the send phases of the traced responses the send cursor has
+// reached or passed, and logs each finished one that was slow. complete
+// means the whole queue has gone out.
+void SocketManager::advanceTraces(SocketState& socket, bool complete)
+{
+	const uint64_t now = readTraceClock();
+	while (socket.sentTrace < socket.sendTraces.size())
+	{
+		RequestTrace& trace = socket.sendTraces[socket.sentTrace];
+		uint64_t start = socket.sentTrace > 0 ? socket.sendTraces[socket.sentTrace - 1].sendEnd : 0;
+		if (!complete && socket.bytesSent <= start)
+		{
+			return;
 		}
-		else {
-			return false;
+
+		uint64_t* at = trace.times.at;
+		if (at[(int)TracePhase::FirstByteSent] == 0)
+		{
+			at[(int)TracePhase::FirstByteSent] = now;
+		}
+		if (!complete && socket.bytesSent < trace.sendEnd)
+		{
+			return;
 		}
+		at[(int)TracePhase::LastByteSent] = now;
+		socket.sentTrace++;
+
+		uint64_t elapsed = at[(int)TracePhase::FirstByte] != 0 ? now - at[(int)TracePhase::FirstByte] : 0;
+		TRACE_PROBE3(request_done, accessLogIndex, (int64_t)socket.id, traceTicksToMicros(elapsed));
+		if (elapsed >= slowRequestTicks)
+		{
+			slowLog->logSlowRequest(accessLogIndex, (uint64_t)socket.id, trace);
+		}
+	}
+}
+
+void SocketManager::logConnection(AccessEvent event, SOCKET id, uint32_t peerAddress, uint16_t peerPort, const char* detail)
+{
+	if (accessLog)
+	{
+		accessLog->logConnection(accessLogIndex, event, (uint64_t)id, peerAddress, peerPort, detail);
 	}
+}
 
-	if (activeSocketsCount >= MAX_SOCKETS)
+bool SocketManager::enableWakeup()
+{
+	if (wakeupFd == -1)
 	{
+		wakeupFd = createWakeupEvent();
+	}
+	return wakeupFd != -1 && backend->setWakeupEvent(wakeupFd);
+}
+
+void SocketManager::wakeup()
+{
+	signalWakeupEvent(wakeupFd);
+}
+
+SocketState& SocketManager::getSocketState(int socketIndex)
+{
+	return connections.get(socketIndex);
+}
+
+const ConnectionPool& SocketManager::getConnections() const
+{
+	return connections;
+}
+
+void SocketManager::attachRequestState(int socketIndex)
+{
+	connections.attachRequestState(socketIndex);
+}
+
+void SocketManager::detachRequestState(int socketIndex)
+{
+	connections.detachRequestState(socketIndex);
+}
+
+const char* SocketManager::getBackendName() const
+{
+	return backend ? backend->getName() : "none";
+}
+
+std::string_view SocketManager::getDateLine() const
+{
+	return dateCache.getHeaderLine();
+}
+
+bool SocketManager::addSocket(SOCKET id, SocketStatus status)
+{
+	// Every socket, the listener included, must be non-blocking so the loops
+	// above can drain it until WSAEWOULDBLOCK. Completion-based backends never
+	// call into the socket directly, so they skip the extra syscalls.
+	if (!backend->isCompletionBased() && !setNonBlocking(id))
+	{
+		std::cout << "Server: Error at ioctlsocket(): " << WSAGetLastError() << std::endl;
 		return false;
 	}
 
-	for (int i = 1; i < MAX_SOCKETS; i++)
+	int slot = connections.acquire();
+	if (slot == -1)
 	{
-		if (sockets[i].status == SocketStatus::EMPTY)
+		if (metrics)
 		{
-			sockets[i].id = id;
-			sockets[i].status = status;
-			sockets[i].messageData.clear();
-			sockets[i].bytesSent = 0;
-			sockets[i].bytesToSend = 0;
-			sockets[i].lastActivityTime = time(nullptr);
+			metrics->addAcceptRejected();
+		}
+		return false;
+	}
 
-			unsigned long flag = 1;
-			if (ioctlsocket(id, FIONBIO, &flag) != 0)
-			{
-				std::cout << "Server: Error at ioctlsocket(): " << WSAGetLastError() << std::endl;
-				closesocket(id);
-				sockets[i].status = SocketStatus::EMPTY;
-				return false;
-			}
+	SocketState& socket = connections.get(slot);
+	if (!backend->addSocket(id, slot, socket.generation, status == SocketStatus::LISTENING))
+	{
+		connections.release(slot);
+		return false;
+	}
 
-			activeSocketsCount++;
-			return true;
+	// Released slots are already reset, so only the new connection's identity is filled in.
+	socket.id = id;
+	socket.status = status;
+	if (metrics)
+	{
+		metrics->changeSocketStatus(SocketStatus::EMPTY, status);
+	}
+	if (status != SocketStatus::LISTENING)
+	{
+		armTimeout(slot, TimeoutKind::Idle);
+		TRACE_PROBE2(accept, accessLogIndex, (int64_t)id);
+		if (slowLog)
+		{
+			socket.trace.at[(int)TracePhase::Accepted] = readTraceClock();
 		}
 	}
-
-	return false;
+	return true;
 }
-
@@ -1,36 +1,131 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include "SocketData.h"
+#include "ConnectionPool.h"
+#include "IEventBackend.h"
+#include "http/HttpResponse.h"
+#include "http/HttpDate.h"
+#include "AccessLog.h"
+#include "Metrics.h"
 
-const int HTTP_PORT = 8080;
-const int LISTEN_BACKLOG = 5;
-const int SOCKET_TIMEOUT_SECONDS = 120; // 2 minutes
+const int LISTEN_BACKLOG = SOMAXCONN;
+const int RECEIVE_BUFFER_SIZE = 16 * 1024;
+const int MAX_RECEIVE_BYTES = 256 * 1024; // Per receiveData() call, so a fast uploader cannot grow messageData without bound
+const int MAX_SEND_BUFFERS = 64; // Segments gathered into one send (well below IOV_MAX)
+const size_t FILE_CHUNK_SIZE = 64 * 1024; // Per sending connection, when files cannot go through sendfile
+const size_t BODY_SOURCE_CHUNK_SIZE = 64 * 1024; // Largest piece pulled from an IBodySource at a time
+
+// Per-phase deadlines. The header deadline is not extended by later bytes, so a
+// client trickling a request (slowloris) cannot hold a connection open forever.
+const int IDLE_TIMEOUT_SECONDS = 120;  // Keep-alive, between requests
+const int HEADER_TIMEOUT_SECONDS = 10; // From the first byte of a request until its headers are complete
+const int BODY_TIMEOUT_SECONDS = 30;   // Between reads of a request body
+const int SEND_TIMEOUT_SECONDS = 30;   // Between writes of a response
 
 class SocketManager
 {
 public:
-    // This constant is now part of the class, making it accessible from outside.
-    static constexpr int MAX_SOCKETS = 60;
-
-    SocketManager();
+    explicit SocketManager(EventBackendType backendType = getDefaultEventBackend(), int maxConnections = DEFAULT_MAX_CONNECTIONS);
     ~SocketManager();
 
-    bool init();
-    void buildFdSets(fd_set& waitRecv, fd_set& waitSend);
+    // Opens the listener. With reusePort several managers (one per reactor
+    // thread) can listen on the same port and the kernel balances between them.
+    bool init(int port, bool reusePort);
+    int waitForEvents(std::vector<IoEvent>& events, int timeoutMs);
     bool acceptNewConnection(int listenerSocketIndex);
     int receiveData(int socketIndex);
-    int sendData(int socketIndex);
+    long long sendData(int socketIndex);
+
+    // Queues a response behind any others on the connection; includeBody is false for HEAD.
+    // Once the connection is SENDING, sendData() writes the whole queue.
+    void queueResponse(int socketIndex, const HttpResponse& response, bool includeBody);
+
+    // Queues a response serialized ahead of time (see ResponseCache): the
+    // first length bytes of bytes, shared rather than copied.
+    void queueSerializedResponse(int socketIndex, std::shared_ptr<const std::string> bytes, size_t length);
+
+    // Queues a bare 1xx status line (e.g. 100 Continue), with no headers.
+    void queueInterimResponse(int socketIndex, HttpStatusCode code);
+    void setSocketStatus(int socketIndex, SocketStatus status);
     void removeSocket(int socketIndex);
-    void checkTimeouts();
+
+    // Starts (or restarts) the deadline for the given phase; TimeoutKind::None disarms it.
+    // Changing the status to RECEIVING, PROCESSING or SENDING arms Idle, None or Send.
+    void armTimeout(int socketIndex, TimeoutKind kind);
+
+    // How long the next wait may block before a deadline is due; -1 if none is armed.
+    int getNextTimeoutMs() const;
+
+    // Closes every connection whose deadline has passed.
+    void expireTimeouts();
+
+    // False if the event was queued for a connection whose slot has since been released.
+    bool isCurrent(const IoEvent& event) const;
+
+    // Connection events (connect, close, timeout) go to the access log as reactor reactorIndex.
+    void setAccessLog(AccessLog* log, int reactorIndex);
+
+    // Bytes, connection states, accept drops and timeouts are counted into
+    // metrics, which belongs to the same reactor; null counts nothing.
+    void setMetrics(ReactorMetrics* metrics);
+
+    // Turns request tracing on: requests whose response is still being sent
+    // thresholdTicks (trace clock) after their first byte arrived go to log.
+    void setSlowLog(AccessLog* log, uint64_t thresholdTicks);
+
+    // Tracing: the current request has been answered. Its phases so far move
+    // to the send path, which adds the send phases as the response goes out.
+    void traceResponse(int socketIndex, const HttpRequest& request, HttpStatusCode status);
+
+    // Lets other threads cut waitForEvents() short through wakeup(). Returns
+    // false if the backend cannot be woken, and the caller has to poll.
+    bool enableWakeup();
+
+    // Any thread, once enableWakeup() has succeeded.
+    void wakeup();
 
     SocketState& getSocketState(int socketIndex);
-    const std::vector<SocketState>& getSockets() const;
+    const ConnectionPool& getConnections() const;
+
+    // See ConnectionPool::attachRequestState().
+    void attachRequestState(int socketIndex);
+    void detachRequestState(int socketIndex);
+    const char* getBackendName() const;
+
+    // The "Date: ...\r\n" line the responses queued on this wakeup carry.
+    std::string_view getDateLine() const;
 
 private:
     bool addSocket(SOCKET id, SocketStatus status);
+    bool applyCompletion(IoEvent& event);
+    void completeSend(int socketIndex);
+    void queueResponseData(SocketState& socket, size_t start);
+    int getPendingBuffers(const SocketState& socket, IoBuffer* buffers, int maxCount) const;
+    void advanceSendQueue(SocketState& socket, uint64_t bytes);
+    bool submitFileChunk(int socketIndex);
+    bool pullBodySource(SocketState& socket);
+    bool isSendComplete(const SocketState& socket) const;
+    void logConnection(AccessEvent event, SOCKET id, uint32_t peerAddress = 0, uint16_t peerPort = 0, const char* detail = "");
+    void advanceTraces(SocketState& socket, bool complete);
 
-    std::vector<SocketState> sockets;
-    int activeSocketsCount;
-};
+    ConnectionPool connections;
+    std::vector<char> receiveBuffer; // Shared by every connection; recv() drains into it before appending to messageData
+    EventBackendType backendType;
+    std::unique_ptr<IEventBackend> backend;
+
+    // Read once per wakeup in waitForEvents(); deadlines are armed relative to it.
+    uint64_t now;
+    HttpDateCache dateCache; // Refreshed on the same wakeup, re-rendered only when the second changes
+    TimerWheel timers;
+    std::vector<int> expiredTimers;
 
+    AccessLog* accessLog = nullptr;
+    int accessLogIndex = 0;
+    ReactorMetrics* metrics = nullptr;
+    AccessLog* slowLog = nullptr; // Null unless tracing
+    uint64_t slowRequestTicks = 0;
+
+    int wakeupFd = -1; // See enableWakeup()
+};
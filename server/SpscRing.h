@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded single-producer, single-consumer queue. Each side owns one index
+// and only reads the other's with acquire semantics, so neither push nor pop
+// takes a lock or a read-modify-write. Each side also caches its last view
+// of the other index, so the shared cache line is only touched when the ring
+// looks full (producer) or empty (consumer).
+template <typename T>
+class SpscRing
+{
+public:
+	// Capacity is rounded up to a power of two.
+	explicit SpscRing(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		m_slots.resize(size);
+		m_mask = size - 1;
+	}
+
+	// Producer side. Returns false, leaving the ring unchanged, if it is full.
+	bool tryPush(const T& item)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_cachedHead > m_mask)
+		{
+			m_cachedHead = m_head.load(std::memory_order_acquire);
+			if (tail - m_cachedHead > m_mask)
+			{
+				return false;
+			}
+		}
+		m_slots[tail & m_mask] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Returns false if the ring is empty.
+	bool tryPop(T& item)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_cachedTail)
+		{
+			m_cachedTail = m_tail.load(std::memory_order_acquire);
+			if (head == m_cachedTail)
+			{
+				return false;
+			}
+		}
+		item = m_slots[head & m_mask];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	std::vector<T> m_slots;
+	size_t m_mask = 0;
+
+	// Written by the producer.
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail{ 0 };
+	size_t m_cachedHead = 0;
+
+	// Written by the consumer.
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head{ 0 };
+	size_t m_cachedTail = 0;
+};
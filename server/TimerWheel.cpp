@@ -0,0 +1,157 @@
+#include "TimerWheel.h"
+#include <chrono>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int countTrailingZeros(uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return (int)index;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+uint64_t getMonotonicTimeMs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t getMonotonicTimeNs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TimerWheel::TimerWheel(uint64_t now)
+	: m_buckets(BUCKET_COUNT, nullptr), m_occupied(BUCKET_COUNT / 64, 0), m_nextTick(now / TICK_MS)
+{
+}
+
+void TimerWheel::schedule(TimerNode& node, uint64_t expiresAt)
+{
+	cancel(node);
+
+	// A deadline inside a tick that was already processed goes into the next one.
+	uint64_t tick = expiresAt / TICK_MS;
+	if (tick < m_nextTick)
+	{
+		tick = m_nextTick;
+	}
+
+	int bucket = (int)(tick & (BUCKET_COUNT - 1));
+	node.expiresAt = expiresAt;
+	node.bucket = bucket;
+	node.prev = nullptr;
+	node.next = m_buckets[bucket];
+	if (node.next)
+	{
+		node.next->prev = &node;
+	}
+	m_buckets[bucket] = &node;
+	m_occupied[bucket / 64] |= (uint64_t)1 << (bucket % 64);
+	m_armedCount++;
+}
+
+void TimerWheel::cancel(TimerNode& node)
+{
+	if (node.bucket < 0)
+	{
+		return;
+	}
+
+	if (node.prev)
+	{
+		node.prev->next = node.next;
+	}
+	else
+	{
+		m_buckets[node.bucket] = node.next;
+		if (!node.next)
+		{
+			m_occupied[node.bucket / 64] &= ~((uint64_t)1 << (node.bucket % 64));
+		}
+	}
+	if (node.next)
+	{
+		node.next->prev = node.prev;
+	}
+
+	node.prev = nullptr;
+	node.next = nullptr;
+	node.bucket = -1;
+	m_armedCount--;
+}
+
+void TimerWheel::advance(uint64_t now, std::vector<int>& expired)
+{
+	uint64_t nowTick = now / TICK_MS;
+	if (m_armedCount == 0)
+	{
+		if (nowTick >= m_nextTick)
+		{
+			m_nextTick = nowTick + 1;
+		}
+		return;
+	}
+
+	// After a long stall every bucket is visited once rather than once per missed tick.
+	uint64_t first = m_nextTick;
+	if (nowTick >= first + BUCKET_COUNT)
+	{
+		first = nowTick - BUCKET_COUNT + 1;
+	}
+
+	for (uint64_t tick = first; tick <= nowTick; tick++)
+	{
+		expireBucket((int)(tick & (BUCKET_COUNT - 1)), nowTick, expired);
+	}
+
+	if (nowTick >= m_nextTick)
+	{
+		m_nextTick = nowTick + 1;
+	}
+}
+
+void TimerWheel::expireBucket(int bucket, uint64_t nowTick, std::vector<int>& expired)
+{
+	TimerNode* node = m_buckets[bucket];
+	while (node)
+	{
+		TimerNode* next = node->next;
+		if (node->expiresAt / TICK_MS <= nowTick)
+		{
+			cancel(*node);
+			expired.push_back(node->owner);
+		}
+		node = next;
+	}
+}
+
+int TimerWheel::getTimeoutMs(uint64_t now) const
+{
+	if (m_armedCount == 0)
+	{
+		return -1;
+	}
+
+	// Scan the occupancy bitmap forward from the next unprocessed tick, wrapping once.
+	int start = (int)(m_nextTick & (BUCKET_COUNT - 1));
+	for (int scanned = 0; scanned <= BUCKET_COUNT; )
+	{
+		int bucket = (start + scanned) & (BUCKET_COUNT - 1);
+		uint64_t word = m_occupied[bucket / 64] >> (bucket % 64);
+		if (word)
+		{
+			scanned += countTrailingZeros(word);
+			uint64_t dueAt = (m_nextTick + (uint64_t)scanned) * TICK_MS;
+			return dueAt > now ? (int)(dueAt - now) : 0;
+		}
+		scanned += 64 - bucket % 64;
+	}
+	return -1;
+}
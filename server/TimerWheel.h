@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Milliseconds from a monotonic clock; unaffected by wall-clock changes.
+uint64_t getMonotonicTimeMs();
+
+// The same clock in nanoseconds, for timing requests.
+uint64_t getMonotonicTimeNs();
+
+// Intrusive list node embedded in whatever owns the timer, so arming never allocates.
+struct TimerNode
+{
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint64_t expiresAt = 0; // Monotonic milliseconds
+    int bucket = -1;        // -1 while not armed
+    int owner = -1;         // Handed back when the timer fires
+};
+
+// Hashed timing wheel. Timers are bucketed by the tick they expire in, so
+// schedule, reschedule and cancel are O(1) list operations and advance() only
+// visits the buckets whose tick has passed. Deadlines further out than one
+// revolution share a bucket with nearer ones and are skipped until their
+// round comes up. Expiry is rounded to the tick, i.e. a timer may fire up to
+// one tick early.
+class TimerWheel
+{
+public:
+    static constexpr int TICK_MS = 100;
+    static constexpr int BUCKET_COUNT = 1024; // Must be a power of two; one revolution is ~102 s
+
+    explicit TimerWheel(uint64_t now);
+
+    // Arms the timer, or moves it if it is already armed.
+    void schedule(TimerNode& node, uint64_t expiresAt);
+    void cancel(TimerNode& node);
+
+    // Fires every timer due at or before now: each is disarmed and its owner appended to expired.
+    void advance(uint64_t now, std::vector<int>& expired);
+
+    // Milliseconds until the next non-empty bucket comes due, or -1 if nothing is armed.
+    int getTimeoutMs(uint64_t now) const;
+
+    bool isEmpty() const { return m_armedCount == 0; }
+
+private:
+    void expireBucket(int bucket, uint64_t nowTick, std::vector<int>& expired);
+
+    std::vector<TimerNode*> m_buckets;
+    std::vector<uint64_t> m_occupied; // One bit per bucket, so the next deadline is found a word at a time
+    uint64_t m_nextTick;              // First tick advance() has not processed yet
+    int m_armedCount = 0;
+};
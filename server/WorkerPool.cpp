@@ -0,0 +1,60 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threadCount)
+{
+	for (int i = 0; i < threadCount; i++)
+	{
+		m_threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void WorkerPool::submit(Job job)
+{
+	bool wake;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+		wake = m_idle > 0;
+	}
+	if (wake)
+	{
+		m_wake.notify_one();
+	}
+}
+
+void WorkerPool::run()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (m_jobs.empty() && !m_stopping)
+			{
+				m_idle++;
+				m_wake.wait(lock);
+				m_idle--;
+			}
+			if (m_jobs.empty())
+			{
+				return; // Stopping, and nothing is left to run.
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job();
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread pool for endpoint handlers that block (disk I/O). All workers take
+// jobs from one shared FIFO queue, so a slow job holds up only its own worker:
+// whichever worker is free next runs the job queued behind it. Jobs are
+// milliseconds of disk I/O each, so the one lock around the queue is not
+// where the time goes.
+class WorkerPool
+{
+public:
+	using Job = std::function<void()>;
+
+	explicit WorkerPool(int threadCount);
+
+	// Stops the workers once every queued job has run.
+	~WorkerPool();
+
+	// Any thread.
+	void submit(Job job);
+
+	int getThreadCount() const { return (int)m_threads.size(); }
+
+private:
+	void run();
+
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake; // Idle workers sleep here
+	std::deque<Job> m_jobs;
+	int m_idle = 0; // Workers waiting on m_wake; submit() signals only when one is
+	bool m_stopping = false;
+};
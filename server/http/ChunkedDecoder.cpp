@@ -0,0 +1,104 @@
+#include "ChunkedDecoder.h"
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+ChunkedDecoder::Result ChunkedDecoder::decode(const char* data, size_t length, size_t& consumed, std::string_view& payload) {
+    size_t position = 0;
+    payload = std::string_view();
+
+    while (position < length) {
+        char c = data[position];
+
+        switch (m_state) {
+        case State::Size: {
+            int digit = hexValue(c);
+            if (digit >= 0) {
+                if (m_chunkRemaining > (UINT64_MAX >> 4)) {
+                    return Result::Error;
+                }
+                m_chunkRemaining = (m_chunkRemaining << 4) | (uint64_t)digit;
+                m_sawDigit = true;
+                position++;
+                break;
+            }
+            if (!m_sawDigit) {
+                return Result::Error;
+            }
+            m_state = State::Extension;
+            m_lineLength = 0;
+            break;
+        }
+
+        case State::Extension:
+            position++;
+            if (c == '\n') {
+                m_sawDigit = false;
+                m_state = m_chunkRemaining == 0 ? State::Trailer : State::Data;
+                m_lineLength = 0;
+            } else if (++m_lineLength > MAX_LINE_BYTES) {
+                return Result::Error;
+            }
+            break;
+
+        case State::Data: {
+            size_t available = length - position;
+            size_t take = available < m_chunkRemaining ? available : (size_t)m_chunkRemaining;
+            payload = std::string_view(data + position, take);
+            position += take;
+            m_chunkRemaining -= take;
+            if (m_chunkRemaining == 0) {
+                m_state = State::DataEnd;
+            }
+            consumed = position;
+            return Result::Data;
+        }
+
+        case State::DataEnd:
+            // CRLF, though a bare LF is accepted as for header lines.
+            position++;
+            if (c == '\n') {
+                m_state = State::Size;
+                m_lineLength = 0;
+            } else if (c != '\r' || m_lineLength++ > 0) {
+                return Result::Error;
+            }
+            break;
+
+        case State::Trailer:
+            position++;
+            if (c == '\n') {
+                if (m_lineLength == 0) {
+                    m_state = State::Done;
+                    consumed = position;
+                    return Result::Done;
+                }
+                m_lineLength = 0;
+            } else if (c != '\r' || m_lineLength > 0) {
+                // A CR only ends an empty line when it comes first; anything else is a trailer field.
+                if (++m_lineLength > MAX_LINE_BYTES) {
+                    return Result::Error;
+                }
+            }
+            break;
+
+        case State::Done:
+            consumed = position;
+            return Result::Done;
+        }
+    }
+
+    consumed = position;
+    return m_state == State::Done ? Result::Done : Result::NeedMore;
+}
+
+void ChunkedDecoder::reset() {
+    m_state = State::Size;
+    m_chunkRemaining = 0;
+    m_lineLength = 0;
+    m_sawDigit = false;
+}
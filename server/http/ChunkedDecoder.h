@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Incremental decoder for the chunked transfer coding (RFC 9112, section 7.1).
+// Input may be split anywhere; chunk extensions and trailer fields are
+// skipped. The payload is handed back as views into the input, so decoding
+// copies nothing.
+class ChunkedDecoder
+{
+public:
+    enum class Result {
+        NeedMore, // All of the input was consumed
+        Data,     // payload holds the next piece of the body
+        Done,     // The last chunk and the trailer section have been read
+        Error     // Malformed framing
+    };
+
+    // Consumes input up to the end of the next payload piece, or all of it.
+    // consumed is set to the number of bytes of data used.
+    Result decode(const char* data, size_t length, size_t& consumed, std::string_view& payload);
+
+    void reset();
+
+private:
+    enum class State {
+        Size,      // Hex digits of the chunk size
+        Extension, // Anything after the size, up to LF
+        Data,
+        DataEnd,   // The CRLF after a chunk's data
+        Trailer,   // Trailer field lines, up to an empty line
+        Done
+    };
+
+    // Framing lines longer than this are rejected.
+    static constexpr size_t MAX_LINE_BYTES = 4096;
+
+    State m_state = State::Size;
+    uint64_t m_chunkRemaining = 0;
+    size_t m_lineLength = 0;
+    bool m_sawDigit = false;
+};
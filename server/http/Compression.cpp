@@ -0,0 +1,232 @@
+#include "Compression.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+static char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+static bool equalsIgnoreCase(std::string_view value, std::string_view lowerCase) {
+    if (value.length() != lowerCase.length()) {
+        return false;
+    }
+    for (size_t i = 0; i < value.length(); i++) {
+        if (toLowerAscii(value[i]) != lowerCase[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// A qvalue ("0", "0.5", "1.000") in thousandths; -1 if malformed.
+static int parseQuality(std::string_view value) {
+    if (value.empty() || (value[0] != '0' && value[0] != '1')) {
+        return -1;
+    }
+    int quality = (value[0] - '0') * 1000;
+    if (value.length() == 1) {
+        return quality;
+    }
+    if (value[1] != '.' || value.length() > 5) {
+        return -1;
+    }
+    int scale = 100;
+    for (size_t i = 2; i < value.length(); i++, scale /= 10) {
+        if (value[i] < '0' || value[i] > '9') {
+            return -1;
+        }
+        quality += (value[i] - '0') * scale;
+    }
+    return quality > 1000 ? -1 : quality;
+}
+
+std::string_view getContentCodingName(ContentCoding coding) {
+    switch (coding) {
+        case ContentCoding::Gzip:   return "gzip";
+        case ContentCoding::Brotli: return "br";
+        default:                    return {};
+    }
+}
+
+bool isCompressionAvailable() {
+#if defined(HAVE_ZLIB) || defined(HAVE_BROTLI)
+    return true;
+#else
+    return false;
+#endif
+}
+
+ContentCoding negotiateContentCoding(std::string_view acceptEncoding) {
+    // -1: not mentioned, so the wildcard's weight applies.
+    int gzip = -1;
+    int brotli = -1;
+    int wildcard = 0;
+
+    size_t position = 0;
+    while (position < acceptEncoding.length()) {
+        size_t end = acceptEncoding.find(',', position);
+        if (end == std::string_view::npos) {
+            end = acceptEncoding.length();
+        }
+        std::string_view item = acceptEncoding.substr(position, end - position);
+        position = end + 1;
+
+        int quality = 1000;
+        size_t semicolon = item.find(';');
+        if (semicolon != std::string_view::npos) {
+            std::string_view parameter = trim(item.substr(semicolon + 1));
+            if (parameter.length() < 2 || toLowerAscii(parameter[0]) != 'q' || parameter[1] != '=') {
+                continue;
+            }
+            quality = parseQuality(parameter.substr(2));
+            if (quality < 0) {
+                continue;
+            }
+            item = item.substr(0, semicolon);
+        }
+
+        item = trim(item);
+        if (equalsIgnoreCase(item, "gzip") || equalsIgnoreCase(item, "x-gzip")) {
+            gzip = quality;
+        } else if (equalsIgnoreCase(item, "br")) {
+            brotli = quality;
+        } else if (item == "*") {
+            wildcard = quality;
+        }
+    }
+
+#ifndef HAVE_ZLIB
+    gzip = 0;
+#endif
+#ifndef HAVE_BROTLI
+    brotli = 0;
+#endif
+    if (gzip < 0) {
+        gzip = wildcard;
+    }
+    if (brotli < 0) {
+        brotli = wildcard;
+    }
+    if (brotli > 0 && brotli >= gzip) {
+        return ContentCoding::Brotli;
+    }
+    return gzip > 0 ? ContentCoding::Gzip : ContentCoding::Identity;
+}
+
+bool isCompressibleType(std::string_view contentType) {
+    size_t semicolon = contentType.find(';');
+    std::string_view type = trim(contentType.substr(0, semicolon));
+    if (type.length() >= 5 && equalsIgnoreCase(type.substr(0, 5), "text/")) {
+        return true;
+    }
+    static const std::string_view TYPES[] = {
+        "application/json", "application/javascript", "application/xml", "image/svg+xml", "message/http"
+    };
+    for (std::string_view compressible : TYPES) {
+        if (equalsIgnoreCase(type, compressible)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef HAVE_ZLIB
+static bool compressGzip(std::string_view body, int level, std::string& output) {
+    z_stream stream = {};
+    // 15 window bits plus 16: a gzip header and trailer rather than a zlib one.
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    output.resize(deflateBound(&stream, (uLong)body.length()));
+    stream.next_in = (Bytef*)body.data();
+    stream.avail_in = (uInt)body.length();
+    stream.next_out = (Bytef*)&output[0];
+    stream.avail_out = (uInt)output.length();
+    int result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+#endif
+
+#ifdef HAVE_BROTLI
+static bool compressBrotli(std::string_view body, int quality, std::string& output) {
+    size_t length = BrotliEncoderMaxCompressedSize(body.length());
+    if (length == 0) {
+        return false;
+    }
+    output.resize(length);
+    if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, body.length(),
+                               (const uint8_t*)body.data(), &length, (uint8_t*)&output[0])) {
+        return false;
+    }
+    output.resize(length);
+    return true;
+}
+#endif
+
+bool compressBody(ContentCoding coding, std::string_view body, CompressionEffort effort, std::string& output) {
+    if (body.length() < MIN_COMPRESSED_BODY_BYTES || body.length() > UINT32_MAX) {
+        return false;
+    }
+
+    // Levels past these cost several times the CPU for a few percent (brotli 11 is ~70x slower than 9).
+    const bool cached = effort == CompressionEffort::Variant;
+    std::string compressed;
+    bool done = false;
+#ifdef HAVE_ZLIB
+    if (coding == ContentCoding::Gzip) {
+        done = compressGzip(body, cached ? 9 : 6, compressed);
+    }
+#endif
+#ifdef HAVE_BROTLI
+    if (coding == ContentCoding::Brotli) {
+        done = compressBrotli(body, cached ? 9 : 5, compressed);
+    }
+#endif
+    (void)coding;
+    (void)cached;
+    if (!done || compressed.length() > body.length() - body.length() / 8) {
+        return false;
+    }
+    output = std::move(compressed);
+    return true;
+}
+
+std::string formatVariantETag(std::string_view etag, ContentCoding coding) {
+    std::string tagged(etag.substr(0, etag.length() - 1));
+    tagged.append("-").append(getContentCodingName(coding)).append("\"");
+    return tagged;
+}
+
+bool isEncodable(const HttpResponse& response) {
+    const std::vector<BodyPart>& parts = response.getBodyParts();
+    return isCompressionAvailable() && parts.size() == 1 && parts[0].data && parts[0].length >= MIN_COMPRESSED_BODY_BYTES &&
+           response.getHeader("Content-Encoding").empty() && isCompressibleType(response.getHeader("Content-Type"));
+}
+
+bool encodeResponse(HttpResponse& response, ContentCoding coding, CompressionEffort effort) {
+    const BodyPart& part = response.getBodyParts()[0];
+    std::string compressed;
+    if (!compressBody(coding, std::string_view(*part.data).substr((size_t)part.offset, (size_t)part.length), effort, compressed)) {
+        return false;
+    }
+    response.setBody(std::move(compressed));
+    response.addHeader("Content-Encoding", std::string(getContentCodingName(coding)));
+    return true;
+}
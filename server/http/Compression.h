@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "HttpResponse.h"
+
+// Content codings (RFC 9110, section 8.4.1) and Accept-Encoding negotiation
+// (section 12.5.3). gzip comes from zlib and br from the Brotli encoder; each
+// is compiled in when its header is found, and must then be linked
+// (-lz, -lbrotlienc). Without either, every response is sent as it is.
+#if __has_include(<zlib.h>)
+#define HAVE_ZLIB 1
+#endif
+#if __has_include(<brotli/encode.h>)
+#define HAVE_BROTLI 1
+#endif
+
+enum class ContentCoding {
+    Identity,
+    Gzip,
+    Brotli,
+    Count
+};
+
+// Smaller bodies are sent as they are: the saving would not pay for the CPU.
+const size_t MIN_COMPRESSED_BODY_BYTES = 256;
+
+// A compressed copy that is cached is built once and served many times, so
+// it is worth compressing harder than a response built for one request.
+enum class CompressionEffort {
+    Response,
+    Variant
+};
+
+// The Content-Encoding token, e.g. "gzip"; empty for Identity.
+std::string_view getContentCodingName(ContentCoding coding);
+
+// True if at least one coding is compiled in.
+bool isCompressionAvailable();
+
+// The compiled-in coding the client weights highest in Accept-Encoding (br
+// on a tie with gzip), or Identity if it accepts none of them.
+ContentCoding negotiateContentCoding(std::string_view acceptEncoding);
+
+// Text, and the structured text formats (JSON, XML, JavaScript, SVG).
+bool isCompressibleType(std::string_view contentType);
+
+// False, leaving output alone, if the coding is not compiled in, the body is
+// smaller than MIN_COMPRESSED_BODY_BYTES, or it would shrink by less than an eighth.
+bool compressBody(ContentCoding coding, std::string_view body, CompressionEffort effort, std::string& output);
+
+// The entity tag of a compressed variant: a different representation, so a
+// different strong tag ("abc" becomes "abc-gzip").
+std::string formatVariantETag(std::string_view etag, ContentCoding coding);
+
+// True if the response has a single in-memory body of a compressible type,
+// large enough to be worth compressing, and no coding yet. Responses like
+// that vary with Accept-Encoding, whichever coding they are sent with.
+bool isEncodable(const HttpResponse& response);
+
+// Replaces the body of an encodable response with its compressed form and
+// sets Content-Encoding. False, leaving the response alone, if compressBody() declines.
+bool encodeResponse(HttpResponse& response, ContentCoding coding, CompressionEffort effort);
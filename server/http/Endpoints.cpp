@@ -2,31 +2,37 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
-#include <sstream>
+#include <atomic>
+#include <chrono>
+#include "Compression.h"
+#include "HttpConditional.h"
+#include "HttpRange.h"
+#include "HttpDate.h"
+#include "../Platform.h"
+#include "../Metrics.h"
 
-OptionsEndpoint::OptionsEndpoint(const std::map<HttpMethod, std::string>& supportedMethods)
-    : m_supportedMethods(supportedMethods) {}
+OptionsEndpoint::OptionsEndpoint(const std::map<HttpMethod, std::string>& supportedMethods) {
+    std::map<HttpMethod, std::string> methods = supportedMethods;
+    methods[HttpMethod::OPTIONS] = getDescription();
 
-HttpResponse OptionsEndpoint::handle(const HttpRequest& request) {
-    HttpResponse response(HttpStatusCode::Ok);
-    std::string allowHeaderValue;
-    std::string body = "<html><head><title>Allowed Options</title></head><body><h1>Allowed methods for " + request.getPath() + "</h1><ul>";
-
-    // Add this endpoint's own info to the map for the response body.
-    m_supportedMethods[HttpMethod::OPTIONS] = getDescription();
-
-    for (const auto& pair : m_supportedMethods) {
-        if (!allowHeaderValue.empty()) {
-            allowHeaderValue += ", ";
+    for (const auto& pair : methods) {
+        if (!m_allowHeader.empty()) {
+            m_allowHeader += ", ";
         }
-        allowHeaderValue += httpMethodToString(pair.first);
-        body += "<li><b>" + httpMethodToString(pair.first) + ":</b> " + pair.second + "</li>";
+        m_allowHeader += httpMethodToString(pair.first);
+        m_methodList += "<li><b>" + httpMethodToString(pair.first) + ":</b> " + pair.second + "</li>";
     }
+}
+
+HttpResponse OptionsEndpoint::handle(const HttpRequest& request) {
+    HttpResponse response(HttpStatusCode::Ok);
+    std::string body = "<html><head><title>Allowed Options</title></head><body><h1>Allowed methods for " + std::string(request.getPath()) + "</h1><ul>";
+    body += m_methodList;
     body += "</ul></body></html>";
 
-    response.addHeader("Allow", allowHeaderValue);
+    response.addHeader("Allow", m_allowHeader);
     response.addHeader("Content-Type", "text/html");
-    response.setBody(body);
+    response.setBody(std::move(body));
     return response;
 }
 
@@ -39,8 +45,8 @@ std::string OptionsEndpoint::getDescription() const {
 HttpResponse HomeEndpoint::handle(const HttpRequest& request) {
     // Default to English
     std::string lang = "en";
-    if (request.getQueryParams().count("lang")) {
-        lang = request.getQueryParams().at("lang");
+    if (request.hasQueryParam("lang")) {
+        lang = std::string(request.getQueryParam("lang"));
     }
 
     // --- Language-Specific Strings ---
@@ -55,6 +61,7 @@ HttpResponse HomeEndpoint::handle(const HttpRequest& request) {
         greeting = "Bonjour le monde!";
         pageStatus = "Cette page est actuellement en français.";
     } else { // Default to English
+        lang = "en";
         greeting = "Hello World!";
         pageStatus = "This page is currently in English.";
     }
@@ -82,10 +89,15 @@ HttpResponse HomeEndpoint::handle(const HttpRequest& request) {
 </html>)";
 
     // --- Build and Return Response ---
-    HttpResponse response(HttpStatusCode::Ok, body);
+    HttpResponse response(HttpStatusCode::Ok, std::move(body));
     response.addHeader("Content-Type", "text/html; charset=UTF-8");
     return response;
 }
+const std::vector<std::string>& HomeEndpoint::getCacheKeyParams() const {
+    static const std::vector<std::string> params = { "lang" };
+    return params;
+}
+
 std::string HomeEndpoint::getDescription() const {
     return "Returns a greeting webpage. Supports 'lang' query parameter (en, he, fr).";
 }
@@ -104,34 +116,312 @@ std::string PostMessageEndpoint::getDescription() const {
 
 
 // --- File Endpoint Implementations ---
-HttpResponse PutFileEndpoint::handle(const HttpRequest& request) {
-    if (request.getPathSegments().size() < 2) return HttpResponse(HttpStatusCode::BadRequest, "Missing filename.");
+static std::string formatContentRange(const ByteRange& range, uint64_t size) {
+    return "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(size);
+}
+
+// The time plus a per-process counter: unlikely to occur inside any file, and
+// never the same for two responses.
+static std::string makeMultipartBoundary() {
+    static std::atomic<uint64_t> counter{ 0 };
+    return "ByteRanges" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + "x" + std::to_string(counter++);
+}
+
+// The header lines shared by every full or single-range response for a file;
+// cached files keep theirs pre-rendered. Any file may be sent compressed, so
+// all of them vary with Accept-Encoding.
+static std::shared_ptr<const std::string> renderFileHeaders(const std::string& etag, time_t modified,
+                                                            ContentCoding coding = ContentCoding::Identity) {
+    std::string headers = "Accept-Ranges: bytes\r\nContent-Type: application/octet-stream\r\n";
+    if (coding != ContentCoding::Identity) {
+        headers.append("Content-Encoding: ").append(getContentCodingName(coding)).append("\r\n");
+    }
+    headers.append("ETag: ").append(etag).append("\r\nLast-Modified: ").append(formatHttpDate(modified)).append("\r\n");
+    if (isCompressionAvailable()) {
+        headers.append("Vary: Accept-Encoding\r\n");
+    }
+    return std::make_shared<const std::string>(std::move(headers));
+}
+
+static std::shared_ptr<const CachedFile> makeCachedFile(const FileBody& file, std::shared_ptr<const std::string> content,
+                                                        std::shared_ptr<const std::string> headers) {
+    auto cached = std::make_shared<CachedFile>();
+    cached->content = std::move(content);
+    cached->headers = std::move(headers);
+    cached->etag = file.getETag();
+    cached->modified = file.getModifiedTime();
+    return cached;
+}
+
+// Returns the cached file with its compressed copy for coding, building it on
+// the first request for that coding and swapping the extended entry into the
+// cache. The route only admits .txt files, so every file is worth a try.
+static std::shared_ptr<const CachedFile> addEncodedFile(FileCache& cache, const std::string& filename,
+                                                        std::shared_ptr<const CachedFile> cached, ContentCoding coding, uint64_t version) {
+    const uint8_t bit = (uint8_t)(1u << (int)coding);
+    if (cached->triedCodings & bit) {
+        return cached;
+    }
+
+    auto extended = std::make_shared<CachedFile>(*cached);
+    extended->triedCodings |= bit;
+    std::string compressed;
+    if (compressBody(coding, *cached->content, CompressionEffort::Variant, compressed)) {
+        EncodedFile& encoded = extended->encoded[(int)coding];
+        encoded.content = std::make_shared<const std::string>(std::move(compressed));
+        encoded.etag = formatVariantETag(cached->etag, coding);
+        encoded.headers = renderFileHeaders(encoded.etag, cached->modified, coding);
+    }
+    cache.insert(filename, extended, version);
+    return extended;
+}
+
+// Carries the validators a 200 would have, and nothing else.
+static HttpResponse makeNotModifiedResponse(const std::string& etag, time_t modified) {
+    HttpResponse response(HttpStatusCode::NotModified);
+    response.addHeader("ETag", etag);
+    response.addHeader("Last-Modified", formatHttpDate(modified));
+    if (isCompressionAvailable()) {
+        response.addHeader("Vary", "Accept-Encoding");
+    }
+    return response;
+}
+
+// Returns null if the file could not be read in full (e.g. it was truncated meanwhile).
+static std::shared_ptr<const std::string> readWholeFile(const FileBody& file) {
+    std::string content((size_t)file.getSize(), '\0');
+    size_t offset = 0;
+    while (offset < content.size()) {
+        long long bytesRead = readFileAt(file.getDescriptor(), &content[offset], content.size() - offset, offset);
+        if (bytesRead <= 0) {
+            return nullptr;
+        }
+        offset += (size_t)bytesRead;
+    }
+    return std::make_shared<const std::string>(std::move(content));
+}
+
+// Writes an upload to a temporary file as it arrives and renames it over the
+// target once complete, so a concurrent GET sees either the old file or the
+// new one, never a partial write. A copy of a small upload is kept to replace
+// the cached copy directly (write-through).
+class FileUploadSink final : public IBodySink {
+public:
+    FileUploadSink(FileCache& cache, std::string filename, bool keepCopy)
+        : m_cache(cache), m_filename(std::move(filename)), m_keepCopy(keepCopy) {
+        static std::atomic<uint64_t> uploadCounter{ 0 };
+        m_tempName = m_filename + "." + std::to_string(uploadCounter++) + ".upload";
+        m_file.open(m_tempName, std::ios::binary);
+    }
+
+    ~FileUploadSink() override {
+        if (!m_renamed) {
+            m_file.close();
+            std::remove(m_tempName.c_str());
+        }
+    }
+
+    bool isOpen() const { return m_file.is_open(); }
+
+    bool write(std::string_view data) override {
+        if (m_keepCopy) {
+            if (m_copy.size() + data.size() <= MAX_CACHED_FILE_BYTES) {
+                m_copy.append(data);
+            } else {
+                m_keepCopy = false;
+                std::string().swap(m_copy);
+            }
+        }
+        return (bool)m_file.write(data.data(), (std::streamsize)data.size());
+    }
+
+    HttpResponse finish(const HttpRequest&) override {
+        m_file.close();
+        if (m_file.fail()) return HttpResponse(HttpStatusCode::InternalServerError, "Could not write file.");
+
+        // The validators come from the temporary file itself, before the rename:
+        // reopening the target afterwards could find another upload's file there.
+        std::shared_ptr<const FileBody> written = FileBody::open(m_tempName);
+        const uint64_t version = m_cache.getVersion();
+
+        std::error_code error;
+        std::filesystem::rename(m_tempName, m_filename, error);
+        if (error) return HttpResponse(HttpStatusCode::InternalServerError, "Could not write file.");
+        m_renamed = true;
+
+        if (written && m_keepCopy && m_cache.isCacheable(m_copy.size())) {
+            m_cache.replace(m_filename, makeCachedFile(*written, std::make_shared<const std::string>(std::move(m_copy)),
+                                                       renderFileHeaders(written->getETag(), written->getModifiedTime())),
+                            version);
+        } else {
+            m_cache.invalidate(m_filename);
+        }
+        return HttpResponse(HttpStatusCode::Created, "File created.");
+    }
+
+private:
+    FileCache& m_cache;
+    std::string m_filename;
+    std::string m_tempName;
+    std::ofstream m_file;
+    std::string m_copy;
+    bool m_keepCopy;
+    bool m_renamed = false;
+};
+
+PutFileEndpoint::PutFileEndpoint(FileCache& cache)
+    : m_cache(cache) {}
+
+std::unique_ptr<IBodySink> PutFileEndpoint::openBodySink(const HttpRequest& request, HttpResponse& response) {
+    if (request.getPathSegmentCount() < 2) {
+        response = HttpResponse(HttpStatusCode::BadRequest, "Missing filename.");
+        return nullptr;
+    }
     std::filesystem::create_directory("files");
-    std::ofstream outFile("files/" + request.getPathSegments()[1], std::ios::binary);
-    if (!outFile) return HttpResponse(HttpStatusCode::InternalServerError, "Could not open file.");
-    outFile << request.getBody();
-    return HttpResponse(HttpStatusCode::Created, "File created.");
+    std::string filename = "files/" + std::string(request.getPathSegment(1));
+
+    // A chunked upload's size is unknown, so a copy is kept until it outgrows the cache.
+    bool keepCopy = request.isChunked() || m_cache.isCacheable(request.getContentLength());
+    auto sink = std::make_unique<FileUploadSink>(m_cache, std::move(filename), keepCopy);
+    if (!sink->isOpen()) {
+        response = HttpResponse(HttpStatusCode::InternalServerError, "Could not open file.");
+        return nullptr;
+    }
+    return sink;
+}
+
+// Requests normally arrive through openBodySink(); this is the same path for a body already in memory.
+HttpResponse PutFileEndpoint::handle(const HttpRequest& request) {
+    HttpResponse response;
+    std::unique_ptr<IBodySink> sink = openBodySink(request, response);
+    if (!sink) return response;
+    if (!sink->write(request.getBody())) return HttpResponse(HttpStatusCode::InternalServerError, "Could not write file.");
+    return sink->finish(request);
 }
 std::string PutFileEndpoint::getDescription() const { return "Creates or replaces a file: /file/{filename}."; }
 
+GetFileEndpoint::GetFileEndpoint(FileCache& cache)
+    : m_cache(cache) {}
+
+// Small files are served from the shared cache without touching the disk.
+// Others are streamed from an open descriptor instead of being read into
+// memory. Range requests (RFC 9110, section 14) let downloads resume or be split.
+// A client revalidating an unchanged file gets 304 before anything is read.
+// Cached files also keep a compressed copy per coding clients have asked for.
 HttpResponse GetFileEndpoint::handle(const HttpRequest& request) {
-    if (request.getPathSegments().size() < 2) return HttpResponse(HttpStatusCode::BadRequest, "Missing filename.");
-    std::string filename = "files/" + request.getPathSegments()[1];
-    if (!std::filesystem::exists(filename)) return HttpResponse(HttpStatusCode::NotFound, "File not found.");
-    std::ifstream inFile(filename, std::ios::binary);
-    std::stringstream buffer;
-    buffer << inFile.rdbuf();
-    HttpResponse response(HttpStatusCode::Ok, buffer.str());
-    response.addHeader("Content-Type", "application/octet-stream");
+    if (request.getPathSegmentCount() < 2) return HttpResponse(HttpStatusCode::BadRequest, "Missing filename.");
+    std::string filename = "files/" + std::string(request.getPathSegment(1));
+
+    uint64_t version = m_cache.getVersion();
+    std::shared_ptr<const CachedFile> cached = m_cache.find(filename);
+    std::shared_ptr<const FileBody> file;
+    std::shared_ptr<const std::string> headers;
+    uint64_t size = 0;
+
+    if (!cached) {
+        if (!std::filesystem::is_regular_file(filename)) return HttpResponse(HttpStatusCode::NotFound, "File not found.");
+        file = FileBody::open(filename);
+        if (!file) return HttpResponse(HttpStatusCode::InternalServerError, "Could not open file.");
+        if (isNotModified(request, file->getETag(), file->getModifiedTime())) {
+            return makeNotModifiedResponse(file->getETag(), file->getModifiedTime());
+        }
+        headers = renderFileHeaders(file->getETag(), file->getModifiedTime());
+        size = file->getSize();
+
+        if (m_cache.isCacheable(size)) {
+            std::shared_ptr<const std::string> content = readWholeFile(*file);
+            if (content) {
+                cached = makeCachedFile(*file, std::move(content), headers);
+                m_cache.insert(filename, cached, version);
+                file = nullptr;
+            }
+        }
+    }
+
+    // A whole cached file goes out compressed if the client accepts a coding.
+    // Ranges always address the identity bytes.
+    if (cached && isCompressionAvailable() && !request.hasHeader(HttpHeader::Range)) {
+        ContentCoding coding = negotiateContentCoding(request.getHeader(HttpHeader::AcceptEncoding));
+        if (coding != ContentCoding::Identity) {
+            cached = addEncodedFile(m_cache, filename, std::move(cached), coding, version);
+            const EncodedFile& encoded = cached->encoded[(int)coding];
+            if (encoded.content) {
+                if (isNotModified(request, encoded.etag, cached->modified)) return makeNotModifiedResponse(encoded.etag, cached->modified);
+                HttpResponse response;
+                response.setPrerenderedHeaders(encoded.headers);
+                response.setBody(encoded.content);
+                return response;
+            }
+        }
+    }
+
+    if (cached) {
+        if (isNotModified(request, cached->etag, cached->modified)) return makeNotModifiedResponse(cached->etag, cached->modified);
+        headers = cached->headers;
+        size = cached->content->size();
+    }
+
+    // Ranges of the cached copy are slices of its shared buffer; ranges of a file are read as they are sent.
+    auto appendRange = [&](HttpResponse& response, uint64_t offset, uint64_t length) {
+        if (cached) {
+            response.appendBody(cached->content, offset, length);
+        } else {
+            response.appendFileRange(file, offset, length);
+        }
+    };
+
+    std::vector<ByteRange> ranges;
+    RangeResult rangeResult = RangeResult::Ignored;
+    if (request.hasHeader(HttpHeader::Range)) {
+        rangeResult = parseRangeHeader(request.getHeader(HttpHeader::Range), size, ranges);
+    }
+
+    HttpResponse response;
+
+    if (rangeResult == RangeResult::Unsatisfiable) {
+        response.setStatusCode(HttpStatusCode::RangeNotSatisfiable);
+        response.addHeader("Accept-Ranges", "bytes");
+        response.addHeader("Content-Range", "bytes */" + std::to_string(size));
+        return response;
+    }
+
+    if (rangeResult == RangeResult::Ignored) {
+        response.setPrerenderedHeaders(headers);
+        appendRange(response, 0, size);
+        return response;
+    }
+
+    response.setStatusCode(HttpStatusCode::PartialContent);
+    if (ranges.size() == 1) {
+        response.setPrerenderedHeaders(headers);
+        response.addHeader("Content-Range", formatContentRange(ranges[0], size));
+        appendRange(response, ranges[0].first, ranges[0].getLength());
+        return response;
+    }
+
+    // Several ranges: a multipart/byteranges body whose parts point into the file.
+    std::string boundary = makeMultipartBoundary();
+    response.addHeader("Accept-Ranges", "bytes");
+    response.addHeader("Content-Type", "multipart/byteranges; boundary=" + boundary);
+    for (const ByteRange& range : ranges) {
+        response.appendBody("\r\n--" + boundary + "\r\nContent-Type: application/octet-stream\r\nContent-Range: " +
+                            formatContentRange(range, size) + "\r\n\r\n");
+        appendRange(response, range.first, range.getLength());
+    }
+    response.appendBody("\r\n--" + boundary + "--\r\n");
     return response;
 }
-std::string GetFileEndpoint::getDescription() const { return "Retrieves a file: /file/{filename}."; }
+std::string GetFileEndpoint::getDescription() const { return "Retrieves a file, or byte ranges of it: /file/{filename}."; }
+
+DeleteFileEndpoint::DeleteFileEndpoint(FileCache& cache)
+    : m_cache(cache) {}
 
 HttpResponse DeleteFileEndpoint::handle(const HttpRequest& request) {
-    if (request.getPathSegments().size() < 2) return HttpResponse(HttpStatusCode::BadRequest, "Missing filename.");
-    std::string filename = "files/" + request.getPathSegments()[1];
+    if (request.getPathSegmentCount() < 2) return HttpResponse(HttpStatusCode::BadRequest, "Missing filename.");
+    std::string filename = "files/" + std::string(request.getPathSegment(1));
     if (!std::filesystem::exists(filename)) return HttpResponse(HttpStatusCode::NotFound, "File not found.");
     if (std::remove(filename.c_str()) != 0) return HttpResponse(HttpStatusCode::InternalServerError, "Error deleting file.");
+    m_cache.invalidate(filename);
     return HttpResponse(HttpStatusCode::Ok, "File deleted.");
 }
 std::string DeleteFileEndpoint::getDescription() const { return "Deletes a file: /file/{filename}."; }
@@ -140,14 +430,27 @@ std::string DeleteFileEndpoint::getDescription() const { return "Deletes a file:
 // --- TraceEndpoint Implementation ---
 HttpResponse TraceEndpoint::handle(const HttpRequest& request) {
     std::string echoedRequest;
-    echoedRequest += httpMethodToString(request.getMethod()) + " " + request.getRawUrl() + " HTTP/1.1\r\n";
-    for (const auto& header : request.getHeaders()) {
-        echoedRequest += header.first + ": " + header.second + "\r\n";
+    echoedRequest += httpMethodToString(request.getMethod()) + " ";
+    echoedRequest.append(request.getRawUrl()).append(" HTTP/1.1\r\n");
+    for (size_t i = 0; i < request.getHeaderCount(); i++) {
+        HttpHeaderField header = request.getHeaderField(i);
+        echoedRequest.append(header.name).append(": ").append(header.value).append("\r\n");
     }
     echoedRequest += "\r\n";
-    HttpResponse response(HttpStatusCode::Ok, echoedRequest);
+    HttpResponse response(HttpStatusCode::Ok, std::move(echoedRequest));
     response.addHeader("Content-Type", "message/http");
     return response;
 }
 std::string TraceEndpoint::getDescription() const { return "Echoes the received request headers back to the client."; }
 
+
+// --- MetricsEndpoint Implementation ---
+MetricsEndpoint::MetricsEndpoint(Metrics& metrics) : m_metrics(metrics) {}
+
+HttpResponse MetricsEndpoint::handle(const HttpRequest&) {
+    HttpResponse response(HttpStatusCode::Ok, m_metrics.render());
+    response.addHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    response.addHeader("Cache-Control", "no-store");
+    return response;
+}
+std::string MetricsEndpoint::getDescription() const { return "Reports request, connection and cache metrics in the Prometheus text format: /metrics."; }
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "IEndpoint.h"
+#include "FileCache.h"
 #include <vector>
 #include <map>
 
+class Metrics;
 
 class OptionsEndpoint final : public IEndpoint {
 public:
@@ -11,15 +13,20 @@ public:
 
     HttpResponse handle(const HttpRequest& request) override;
     std::string getDescription() const override;
+    bool isCacheable() const override { return true; }
 
 private:
-    std::map<HttpMethod, std::string> m_supportedMethods;
+    // Rendered once from the supported methods, plus OPTIONS itself.
+    std::string m_allowHeader;
+    std::string m_methodList;
 };
 
 class HomeEndpoint final : public IEndpoint {
 public:
     HttpResponse handle(const HttpRequest& request) override;
     std::string getDescription() const override;
+    bool isCacheable() const override { return true; }
+    const std::vector<std::string>& getCacheKeyParams() const override;
 };
 
 class PostMessageEndpoint final : public IEndpoint {
@@ -30,20 +37,42 @@ public:
 
 class PutFileEndpoint final : public IEndpoint {
 public:
+    explicit PutFileEndpoint(FileCache& cache);
+
     HttpResponse handle(const HttpRequest& request) override;
     std::string getDescription() const override;
+
+    // Uploads are written to disk as they arrive rather than buffered.
+    bool streamsBody() const override { return true; }
+    std::unique_ptr<IBodySink> openBodySink(const HttpRequest& request, HttpResponse& response) override;
+    bool isBlocking() const override { return true; }
+
+private:
+    FileCache& m_cache;
 };
 
 class GetFileEndpoint final : public IEndpoint {
 public:
+    explicit GetFileEndpoint(FileCache& cache);
+
     HttpResponse handle(const HttpRequest& request) override;
     std::string getDescription() const override;
+    bool isBlocking() const override { return true; }
+
+private:
+    FileCache& m_cache;
 };
 
 class DeleteFileEndpoint final : public IEndpoint {
 public:
+    explicit DeleteFileEndpoint(FileCache& cache);
+
     HttpResponse handle(const HttpRequest& request) override;
     std::string getDescription() const override;
+    bool isBlocking() const override { return true; }
+
+private:
+    FileCache& m_cache;
 };
 
 class TraceEndpoint final : public IEndpoint {
@@ -52,3 +81,20 @@ public:
     std::string getDescription() const override;
 };
 
+// Serves the server's counters and latency histograms in the Prometheus text
+// format. Each scrape sums the reactors' counters, so it costs a few
+// microseconds of the reactor that answers it and nothing of the others.
+class MetricsEndpoint final : public IEndpoint {
+public:
+    explicit MetricsEndpoint(Metrics& metrics);
+
+    HttpResponse handle(const HttpRequest& request) override;
+    std::string getDescription() const override;
+
+    // A scrape renders every route's histograms; with --workers that happens
+    // off the reactor. Metrics::render() is safe on any thread.
+    bool isBlocking() const override { return true; }
+
+private:
+    Metrics& m_metrics;
+};
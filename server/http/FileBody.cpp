@@ -0,0 +1,24 @@
+#include "FileBody.h"
+#include "HttpConditional.h"
+#include "../Platform.h"
+
+std::shared_ptr<const FileBody> FileBody::open(const std::string& path) {
+    int descriptor = openFileForReading(path.c_str());
+    if (descriptor == -1) {
+        return nullptr;
+    }
+    FileInfo info;
+    if (!getFileInfo(descriptor, info)) {
+        closeFile(descriptor);
+        return nullptr;
+    }
+    return std::make_shared<const FileBody>(descriptor, info.size, info.modified,
+                                            formatFileETag(info.fileId, info.modified, info.modifiedNanoseconds, info.size));
+}
+
+FileBody::FileBody(int descriptor, uint64_t size, time_t modified, std::string etag)
+    : m_descriptor(descriptor), m_size(size), m_modified(modified), m_etag(std::move(etag)) {}
+
+FileBody::~FileBody() {
+    closeFile(m_descriptor);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+
+// An open file that a response streams from. Responses and the connection's
+// send queue share it; the descriptor is closed when the last of them lets go,
+// so the file is never read into memory as a whole.
+class FileBody
+{
+public:
+    // Returns null if the file cannot be opened.
+    static std::shared_ptr<const FileBody> open(const std::string& path);
+
+    FileBody(int descriptor, uint64_t size, time_t modified, std::string etag);
+    ~FileBody();
+
+    FileBody(const FileBody&) = delete;
+    FileBody& operator=(const FileBody&) = delete;
+
+    int getDescriptor() const;
+    uint64_t getSize() const;      // As of open()
+    time_t getModifiedTime() const; // As of open()
+    const std::string& getETag() const; // As of open(); see formatFileETag()
+
+private:
+    int m_descriptor;
+    uint64_t m_size;
+    time_t m_modified;
+    std::string m_etag;
+};
+
+inline int FileBody::getDescriptor() const { return m_descriptor; }
+inline uint64_t FileBody::getSize() const { return m_size; }
+inline time_t FileBody::getModifiedTime() const { return m_modified; }
+inline const std::string& FileBody::getETag() const { return m_etag; }
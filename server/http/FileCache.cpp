@@ -0,0 +1,99 @@
+#include "FileCache.h"
+
+// Bookkeeping per entry on top of the buffers: list node, hash node, key, control blocks.
+static const size_t ENTRY_OVERHEAD_BYTES = 256;
+
+FileCache::FileCache(size_t capacityBytes)
+    : m_capacityBytes(capacityBytes) {}
+
+std::shared_ptr<const CachedFile> FileCache::find(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto position = m_index.find(path);
+    if (position == m_index.end()) {
+        m_misses++;
+        return nullptr;
+    }
+    m_hits++;
+    m_entries.splice(m_entries.begin(), m_entries, position->second);
+    return position->second->file;
+}
+
+uint64_t FileCache::getVersion() const {
+    return m_version.load(std::memory_order_acquire);
+}
+
+void FileCache::insert(const std::string& path, std::shared_ptr<const CachedFile> file, uint64_t version) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_version.load(std::memory_order_relaxed) != version) {
+        return;
+    }
+    store(path, std::move(file));
+}
+
+void FileCache::replace(const std::string& path, std::shared_ptr<const CachedFile> file, uint64_t version) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_version.fetch_add(1, std::memory_order_release) != version) {
+        file = nullptr;
+    }
+    m_invalidations++;
+    store(path, std::move(file));
+}
+
+void FileCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_version.fetch_add(1, std::memory_order_release);
+    m_invalidations++;
+    auto position = m_index.find(path);
+    if (position != m_index.end()) {
+        erase(position);
+    }
+}
+
+bool FileCache::isCacheable(uint64_t size) const {
+    // A single file may take at most a quarter of the budget, so one upload cannot flush the rest.
+    return size <= MAX_CACHED_FILE_BYTES && size + ENTRY_OVERHEAD_BYTES <= m_capacityBytes / 4;
+}
+
+FileCacheStats FileCache::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FileCacheStats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    stats.invalidations = m_invalidations;
+    stats.entries = m_entries.size();
+    stats.bytes = m_bytes;
+    stats.capacityBytes = m_capacityBytes;
+    return stats;
+}
+
+void FileCache::store(const std::string& path, std::shared_ptr<const CachedFile> file) {
+    auto position = m_index.find(path);
+    if (position != m_index.end()) {
+        erase(position);
+    }
+    if (!file || !isCacheable(file->content->length())) {
+        return;
+    }
+
+    size_t cost = file->content->length() + file->headers->length() + path.length() + ENTRY_OVERHEAD_BYTES;
+    for (int i = 0; i < (int)ContentCoding::Count; i++) {
+        if (file->encoded[i].content) {
+            cost += file->encoded[i].content->length() + file->encoded[i].headers->length();
+        }
+    }
+    while (m_bytes + cost > m_capacityBytes && !m_entries.empty()) {
+        erase(m_index.find(m_entries.back().path));
+        m_evictions++;
+    }
+
+    m_entries.push_front({ path, std::move(file), cost });
+    m_index.emplace(path, m_entries.begin());
+    m_bytes += cost;
+}
+
+void FileCache::erase(std::unordered_map<std::string, std::list<Entry>::iterator>::iterator position) {
+    m_bytes -= position->second->cost;
+    m_entries.erase(position->second);
+    m_index.erase(position);
+}
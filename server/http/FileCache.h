@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Compression.h"
+
+// Default memory budget; --file-cache-mb overrides it, and 0 disables the cache.
+const size_t DEFAULT_FILE_CACHE_BYTES = 64 * 1024 * 1024;
+
+// Larger files are always streamed from disk.
+const size_t MAX_CACHED_FILE_BYTES = 1024 * 1024;
+
+// A compressed copy of a cached file, with the header lines and entity tag
+// that go with it.
+struct EncodedFile {
+    std::shared_ptr<const std::string> content;
+    std::shared_ptr<const std::string> headers;
+    std::string etag;
+};
+
+// A file's contents plus the header lines every response for it carries.
+// Immutable once cached: responses share the buffers, and a PUT swaps in a
+// new entry rather than changing this one.
+struct CachedFile {
+    std::shared_ptr<const std::string> content;
+    std::shared_ptr<const std::string> headers; // Pre-rendered "Name: value\r\n" lines
+
+    // The validators in those headers, for answering conditional requests.
+    std::string etag;
+    time_t modified = 0;
+
+    // Compressed copies, indexed by ContentCoding. One is built the first time
+    // a client asks for it, and the entry is swapped for a copy that has it;
+    // triedCodings keeps a file that does not shrink from being compressed again.
+    EncodedFile encoded[(int)ContentCoding::Count];
+    uint8_t triedCodings = 0;
+};
+
+struct FileCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t capacityBytes = 0;
+};
+
+// A size-bounded LRU cache of small files, shared by all reactors. Lookups
+// and updates take one mutex for an O(1) hash lookup and list splice; the
+// file I/O on a miss happens outside it.
+class FileCache
+{
+public:
+    explicit FileCache(size_t capacityBytes);
+
+    // Returns null on a miss. A hit makes the entry the most recently used.
+    std::shared_ptr<const CachedFile> find(const std::string& path);
+
+    // A miss is filled in three steps: take getVersion(), read the file, then
+    // insert(). If the file was replaced or deleted in between, the version
+    // has moved on and the possibly stale contents are dropped.
+    uint64_t getVersion() const;
+    void insert(const std::string& path, std::shared_ptr<const CachedFile> file, uint64_t version);
+
+    // Write-through from PUT and DELETE, after the file on disk has changed.
+    // A PUT takes getVersion() before its rename; if the version has moved on
+    // by the time it replaces the entry, another upload may have renamed its
+    // file over this one in between, so the entry is dropped instead.
+    void replace(const std::string& path, std::shared_ptr<const CachedFile> file, uint64_t version);
+    void invalidate(const std::string& path);
+
+    bool isCacheable(uint64_t size) const;
+    FileCacheStats getStats() const;
+
+private:
+    struct Entry {
+        std::string path;
+        std::shared_ptr<const CachedFile> file;
+        size_t cost;
+    };
+
+    // Callers hold m_mutex.
+    void store(const std::string& path, std::shared_ptr<const CachedFile> file);
+    void erase(std::unordered_map<std::string, std::list<Entry>::iterator>::iterator position);
+
+    const size_t m_capacityBytes;
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    size_t m_bytes = 0;
+    std::atomic<uint64_t> m_version{ 0 };
+
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_evictions = 0;
+    uint64_t m_invalidations = 0;
+};
@@ -0,0 +1,89 @@
+#include "HttpConditional.h"
+#include "HttpDate.h"
+
+static void appendHex(std::string& out, uint64_t value) {
+    static const char DIGITS[] = "0123456789abcdef";
+    char buffer[16];
+    int length = 0;
+    do {
+        buffer[length++] = DIGITS[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    while (length > 0) {
+        out.push_back(buffer[--length]);
+    }
+}
+
+std::string formatFileETag(uint64_t fileId, time_t modified, uint32_t modifiedNanoseconds, uint64_t size) {
+    std::string etag = "\"";
+    appendHex(etag, fileId);
+    etag.push_back('-');
+    appendHex(etag, (uint64_t)modified * 1000000000ull + modifiedNanoseconds);
+    etag.push_back('-');
+    appendHex(etag, size);
+    etag.push_back('"');
+    return etag;
+}
+
+std::string formatContentETag(std::string_view content) {
+    // 64-bit FNV-1a: bodies cached this way are small and hashed once.
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char byte : content) {
+        hash = (hash ^ byte) * 0x100000001b3ull;
+    }
+    std::string etag = "\"";
+    appendHex(etag, hash);
+    etag.push_back('"');
+    return etag;
+}
+
+// If-None-Match = "*" / #entity-tag, compared weakly: a W/ prefix on either side is ignored.
+static bool matchesEntityTag(std::string_view list, std::string_view etag) {
+    if (etag.substr(0, 2) == "W/") {
+        etag.remove_prefix(2);
+    }
+
+    size_t position = 0;
+    while (position < list.length()) {
+        char c = list[position];
+        if (c == ' ' || c == '\t' || c == ',') {
+            position++;
+            continue;
+        }
+        if (c == '*') {
+            return true;
+        }
+        if (list.compare(position, 2, "W/") == 0) {
+            position += 2;
+        }
+        if (position >= list.length() || list[position] != '"') {
+            return false; // Malformed; the header is ignored as a whole
+        }
+        size_t close = list.find('"', position + 1);
+        if (close == std::string_view::npos) {
+            return false;
+        }
+        if (list.substr(position, close + 1 - position) == etag) {
+            return true;
+        }
+        position = close + 1;
+    }
+    return false;
+}
+
+bool isNotModified(const HttpRequest& request, std::string_view etag, time_t lastModified) {
+    HttpMethod method = request.getMethod();
+    if (method != HttpMethod::GET && method != HttpMethod::HEAD) {
+        return false;
+    }
+
+    if (request.hasHeader(HttpHeader::IfNoneMatch)) {
+        return !etag.empty() && matchesEntityTag(request.getHeader(HttpHeader::IfNoneMatch), etag);
+    }
+
+    time_t since;
+    if (request.hasHeader(HttpHeader::IfModifiedSince) && parseHttpDate(request.getHeader(HttpHeader::IfModifiedSince), since)) {
+        return lastModified <= since;
+    }
+    return false;
+}
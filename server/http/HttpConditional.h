@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include "HttpRequest.h"
+
+// Validators (RFC 9110, section 8.8) and conditional GET (section 13): a
+// client that already holds the current representation is answered with
+// 304 Not Modified and no body.
+
+// A strong entity tag for a file, from its inode, modification time and
+// size. PUT renames a new file into place, so every upload changes the inode
+// even within the same clock tick.
+std::string formatFileETag(uint64_t fileId, time_t modified, uint32_t modifiedNanoseconds, uint64_t size);
+
+// A strong entity tag for an in-memory body, from a hash of its bytes.
+std::string formatContentETag(std::string_view content);
+
+// True if a GET or HEAD for the representation with these validators should
+// get 304: If-None-Match lists etag, or, when the request has no
+// If-None-Match, If-Modified-Since is no older than lastModified.
+bool isNotModified(const HttpRequest& request, std::string_view etag, time_t lastModified);
@@ -0,0 +1,70 @@
+#include "HttpDate.h"
+#include "../Platform.h"
+
+std::string formatHttpDate(time_t time) {
+    std::tm tm_buf;
+    toUtcTime(time, tm_buf);
+    char buffer[32];
+    size_t length = strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm_buf);
+    return std::string(buffer, length);
+}
+
+// "Sun, 06 Nov 1994 08:49:37 GMT": every field at a fixed position.
+bool parseHttpDate(std::string_view text, time_t& time) {
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if (text.length() != 29 || text[3] != ',' || text[4] != ' ' || text[7] != ' ' || text[11] != ' ' ||
+        text[16] != ' ' || text[19] != ':' || text[22] != ':' || text.substr(25) != " GMT") {
+        return false;
+    }
+
+    auto number = [&text](size_t position, size_t digits, int& value) {
+        value = 0;
+        for (size_t i = position; i < position + digits; i++) {
+            if (text[i] < '0' || text[i] > '9') {
+                return false;
+            }
+            value = value * 10 + (text[i] - '0');
+        }
+        return true;
+    };
+    int day, year, hour, minute, second;
+    if (!number(5, 2, day) || !number(12, 4, year) || !number(17, 2, hour) || !number(20, 2, minute) || !number(23, 2, second)) {
+        return false;
+    }
+    int month = 0;
+    while (month < 12 && text.substr(8, 3) != std::string_view(MONTHS + month * 3, 3)) {
+        month++;
+    }
+    if (month == 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    // Days since 1970-01-01 of the civil date (H. Hinnant's days_from_civil),
+    // as timegm() is not portable.
+    int m = month + 1;
+    int y = year - (m <= 2 ? 1 : 0);
+    int era = y / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    long long days = (long long)era * 146097 + dayOfEra - 719468;
+
+    time = (time_t)(days * 86400 + hour * 3600 + minute * 60 + second);
+    return true;
+}
+
+HttpDateCache::HttpDateCache() {
+    refresh(time(nullptr));
+}
+
+void HttpDateCache::refresh(time_t now) {
+    if (now == m_second) {
+        return;
+    }
+    m_second = now;
+
+    std::tm tm_buf;
+    toUtcTime(now, tm_buf);
+    // %a and %b follow the C locale, which the server never changes.
+    m_length = strftime(m_line, sizeof(m_line), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm_buf);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+// Formats a time as an HTTP date (IMF-fixdate), e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+std::string formatHttpDate(time_t time);
+
+// Parses an IMF-fixdate, the only format formatHttpDate() produces. The two
+// obsolete formats are rejected, which RFC 9110 allows for validators: a
+// conditional header that cannot be parsed is ignored.
+bool parseHttpDate(std::string_view text, time_t& time);
+
+// The "Date: ...\r\n" header line (RFC 9110, section 6.6.1), which only changes
+// once a second. Each event loop owns one and refreshes it once per wakeup,
+// so responses append a ready-made line instead of formatting the time.
+class HttpDateCache
+{
+public:
+    HttpDateCache();
+
+    // Re-renders the line if the wall-clock second has changed.
+    void refresh(time_t now);
+
+    std::string_view getHeaderLine() const;
+
+private:
+    time_t m_second = -1;
+    size_t m_length = 0;
+    char m_line[64] = {};
+};
+
+inline std::string_view HttpDateCache::getHeaderLine() const { return std::string_view(m_line, m_length); }
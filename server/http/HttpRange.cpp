@@ -0,0 +1,107 @@
+#include "HttpRange.h"
+
+static std::string_view trimWhitespace(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// Digits only, no sign or whitespace; false on overflow.
+static bool parsePosition(std::string_view digits, uint64_t& position) {
+    if (digits.empty()) {
+        return false;
+    }
+    position = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9' || position > (UINT64_MAX - 9) / 10) {
+            return false;
+        }
+        position = position * 10 + (c - '0');
+    }
+    return true;
+}
+
+RangeResult parseRangeHeader(std::string_view value, uint64_t size, std::vector<ByteRange>& ranges) {
+    ranges.clear();
+    value = trimWhitespace(value);
+
+    // The unit is case-insensitive (RFC 9110, section 14.1).
+    const std::string_view unit = "bytes=";
+    if (value.length() < unit.length()) {
+        return RangeResult::Ignored;
+    }
+    for (size_t i = 0; i < unit.length(); i++) {
+        char c = value[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = (char)(c - 'A' + 'a');
+        }
+        if (c != unit[i]) {
+            return RangeResult::Ignored;
+        }
+    }
+    value.remove_prefix(unit.length());
+
+    size_t requested = 0;
+    uint64_t totalLength = 0;
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view spec = trimWhitespace(value.substr(0, comma));
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        if (spec.empty()) {
+            continue; // Empty list elements are allowed (RFC 9110, section 5.6.1).
+        }
+        if (++requested > MAX_BYTE_RANGES) {
+            return RangeResult::Ignored;
+        }
+
+        size_t dash = spec.find('-');
+        if (dash == std::string_view::npos) {
+            return RangeResult::Ignored;
+        }
+
+        ByteRange range;
+        if (dash == 0) {
+            // Suffix range: the last N bytes.
+            uint64_t suffixLength;
+            if (!parsePosition(spec.substr(1), suffixLength)) {
+                return RangeResult::Ignored;
+            }
+            if (suffixLength == 0 || size == 0) {
+                continue;
+            }
+            range.first = suffixLength < size ? size - suffixLength : 0;
+            range.last = size - 1;
+        } else {
+            if (!parsePosition(spec.substr(0, dash), range.first)) {
+                return RangeResult::Ignored;
+            }
+            std::string_view lastDigits = spec.substr(dash + 1);
+            if (lastDigits.empty()) {
+                range.last = UINT64_MAX;
+            } else if (!parsePosition(lastDigits, range.last) || range.last < range.first) {
+                return RangeResult::Ignored;
+            }
+            if (range.first >= size) {
+                continue; // Unsatisfiable on its own; others may still be satisfiable.
+            }
+            if (range.last >= size) {
+                range.last = size - 1;
+            }
+        }
+
+        totalLength += range.getLength();
+        if (totalLength > size) {
+            return RangeResult::Ignored;
+        }
+        ranges.push_back(range);
+    }
+
+    if (requested == 0) {
+        return RangeResult::Ignored;
+    }
+    return ranges.empty() ? RangeResult::Unsatisfiable : RangeResult::Satisfiable;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// One byte range of a representation, inclusive at both ends (RFC 9110, section 14.1.2).
+struct ByteRange {
+    uint64_t first;
+    uint64_t last;
+
+    uint64_t getLength() const { return last - first + 1; }
+};
+
+enum class RangeResult {
+    Ignored,      // Send the whole representation: bad syntax, another unit, or a request the server declines
+    Satisfiable,  // Send the ranges (206)
+    Unsatisfiable // None of the ranges overlaps the representation (416)
+};
+
+// More ranges than this in one request are treated as abuse and ignored.
+const size_t MAX_BYTE_RANGES = 16;
+
+// Parses a Range header value against a representation of the given size.
+// Ranges come back clamped to the representation, in the order requested.
+// Requests asking for more bytes in total than the representation holds
+// (overlapping ranges) are ignored rather than served.
+RangeResult parseRangeHeader(std::string_view value, uint64_t size, std::vector<ByteRange>& ranges);
@@ -1,116 +1,355 @@
 #include "HttpRequest.h"
+#include "HttpScan.h"
+#include <cstdint>
+#include <cstring>
 
-// The main parsing method.
-ParseResult HttpRequest::parse(const std::string& rawData) {
-    clear(); // Reset state for parsing a new request
+static char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
 
-    const std::string EOH = "\r\n\r\n";
-    size_t headersEnd = rawData.find(EOH);
-    if (headersEnd == std::string::npos) {
-        return ParseResult::Incomplete;
+static bool equalsIgnoreCase(const char* data, size_t length, std::string_view lowerCase) {
+    if (length != lowerCase.length()) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (toLowerAscii(data[i]) != lowerCase[i]) {
+            return false;
+        }
     }
+    return true;
+}
 
-    std::string headersPart = rawData.substr(0, headersEnd);
-    m_body = rawData.substr(headersEnd + EOH.length());
+static bool isOptionalWhitespace(char c) {
+    return c == ' ' || c == '\t';
+}
 
-    size_t requestLineEnd = headersPart.find("\r\n");
-    if (requestLineEnd == std::string::npos) {
-        return ParseResult::Error;
+// Lower-case names of the HttpHeader values, in enum order.
+static const std::string_view KNOWN_HEADER_NAMES[(int)HttpHeader::Count] = {
+    "host",
+    "connection",
+    "content-length",
+    "content-type",
+    "transfer-encoding",
+    "expect",
+    "accept",
+    "accept-encoding",
+    "if-none-match",
+    "if-modified-since",
+    "range",
+    "user-agent",
+    "cookie"
+};
+
+static bool equalsIgnoreCase(std::string_view value, std::string_view lowerCase) {
+    return equalsIgnoreCase(value.data(), value.length(), lowerCase);
+}
+
+// The main parsing method. Consumes complete lines as they arrive and stops
+// at the first incomplete one, remembering how far it has already scanned.
+ParseResult HttpRequest::parse(const std::string& rawData) {
+    m_data = rawData.data() + m_requestStart;
+    const size_t available = rawData.size() - m_requestStart;
+
+    while (m_state == ParseState::RequestLine || m_state == ParseState::Headers) {
+        size_t newline = m_scanPos + findLineFeed(m_data + m_scanPos, available - m_scanPos);
+        if (newline == available) {
+            m_scanPos = available;
+            if (available > MAX_HEADER_BYTES) {
+                m_state = ParseState::Failed;
+                return ParseResult::Error;
+            }
+            return ParseResult::Incomplete;
+        }
+
+        size_t lineEnd = newline;
+        size_t nextLine = lineEnd + 1;
+        if (lineEnd > m_lineStart && m_data[lineEnd - 1] == '\r') {
+            lineEnd--; // CRLF, though a bare LF is accepted too
+        }
+        size_t lineStart = m_lineStart;
+        size_t length = lineEnd - m_lineStart;
+        m_lineStart = nextLine;
+        m_scanPos = nextLine;
+
+        if (nextLine > MAX_HEADER_BYTES) {
+            m_state = ParseState::Failed;
+            return ParseResult::Error;
+        }
+
+        if (m_state == ParseState::RequestLine) {
+            // Empty lines before the request line are ignored (RFC 9112, section 2.2).
+            if (length == 0) {
+                continue;
+            }
+            if (!parseRequestLine(lineStart, length)) {
+                m_state = ParseState::Failed;
+                return ParseResult::Error;
+            }
+            m_state = ParseState::Headers;
+        } else if (length == 0) {
+            ParseResult result = finishHeaders(nextLine);
+            if (result == ParseResult::Error) {
+                return result;
+            }
+        } else if (!parseHeaderLine(lineStart, length)) {
+            m_state = ParseState::Failed;
+            return ParseResult::Error;
+        }
     }
 
-    std::string requestLine = headersPart.substr(0, requestLineEnd);
-    if (!parseRequestLine(requestLine)) {
-        return ParseResult::Error;
+    if (m_state == ParseState::Body) {
+        // The body is never copied; it is complete once enough bytes have arrived.
+        if (m_chunked || available - m_bodyOffset < m_contentLength) {
+            return ParseResult::Incomplete;
+        }
+        m_state = ParseState::Complete;
     }
-    
-    headersPart.erase(0, requestLineEnd + 2);
-    if (!parseHeaders(headersPart)) {
-        return ParseResult::Error;
+
+    return m_state == ParseState::Complete ? ParseResult::Success : ParseResult::Error;
+}
+
+// Resets the state of the request object to be reused.
+void HttpRequest::clear(size_t requestStart) {
+    m_state = ParseState::RequestLine;
+    m_requestStart = requestStart;
+    m_lineStart = 0;
+    m_scanPos = 0;
+    m_bodyOffset = 0;
+    m_contentLength = 0;
+    m_chunked = false;
+    m_bodyStreamed = false;
+    m_streamedBody = std::string_view();
+    m_data = nullptr;
+    m_method = HttpMethod::UNKNOWN;
+    m_rawUrl = Token();
+    m_path = Token();
+    m_headerCount = 0;
+    m_pathSegmentCount = 0;
+    m_queryParamCount = 0;
+    for (uint8_t& slot : m_knownHeaders) {
+        slot = 0;
     }
-    
-    if (!parseUrl()) {
-        return ParseResult::Error;
+}
+
+bool HttpRequest::hasQueryParam(std::string_view name) const {
+    for (int i = 0; i < m_queryParamCount; i++) {
+        if (view(m_queryParams[i].name) == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view HttpRequest::getQueryParam(std::string_view name) const {
+    // The last occurrence wins, as it did with the old map-based storage.
+    for (int i = m_queryParamCount - 1; i >= 0; i--) {
+        if (view(m_queryParams[i].name) == name) {
+            return view(m_queryParams[i].value);
+        }
     }
+    return std::string_view();
+}
 
-    // Check if the body is complete
-    if (m_headers.count("Content-Length")) {
-        try {
-            size_t expectedLength = std::stoul(m_headers.at("Content-Length"));
-            if (m_body.length() < expectedLength) {
-                return ParseResult::Incomplete; // Body is not fully received yet
+std::string_view HttpRequest::getHeader(std::string_view name) const {
+    for (int i = m_headerCount - 1; i >= 0; i--) {
+        const HeaderSlot& slot = m_headers[i];
+        if (slot.name.length == name.length()) {
+            std::string_view slotName = view(slot.name);
+            size_t j = 0;
+            while (j < name.length() && toLowerAscii(slotName[j]) == toLowerAscii(name[j])) {
+                j++;
             }
-            if (m_body.length() > expectedLength) {
-                m_body.resize(expectedLength); // Trim any extra data
+            if (j == name.length()) {
+                return view(slot.value);
             }
-        } catch (const std::exception&) {
-            return ParseResult::Error; // Malformed Content-Length
         }
     }
-
-    return ParseResult::Success;
+    return std::string_view();
 }
 
-// Resets the state of the request object to be reused.
-void HttpRequest::clear() {
-    m_method = HttpMethod::UNKNOWN;
-    m_rawUrl.clear();
-    m_path.clear();
-    m_pathSegments.clear();
-    m_queryParams.clear();
-    m_headers.clear();
-    m_body.clear();
+bool HttpRequest::expectsContinue() const {
+    return equalsIgnoreCase(getHeader(HttpHeader::Expect), "100-continue");
 }
 
 // --- Private parsing helper functions ---
-bool HttpRequest::parseRequestLine(const std::string& line) {
-    std::stringstream requestLineStream(line);
-    std::string methodStr;
-    requestLineStream >> methodStr >> m_rawUrl;
-    m_method = stringToHttpMethod(methodStr);
+bool HttpRequest::parseRequestLine(size_t lineStart, size_t length) {
+    const char* line = m_data + lineStart;
+    const char* end = line + length;
+    const char* methodEnd = (const char*)std::memchr(line, ' ', length);
+    if (!methodEnd) {
+        return false;
+    }
+    const char* urlStart = methodEnd + 1;
+    const char* urlEnd = (const char*)std::memchr(urlStart, ' ', end - urlStart);
+    if (!urlEnd) {
+        urlEnd = end; // HTTP/0.9-style request line without a version
+    }
+    if (urlEnd == urlStart) {
+        return false;
+    }
+
+    m_method = stringToHttpMethod(std::string_view(line, methodEnd - line));
+    m_rawUrl.offset = (uint16_t)(urlStart - m_data);
+    m_rawUrl.length = (uint16_t)(urlEnd - urlStart);
     return m_method != HttpMethod::UNKNOWN;
 }
 
-bool HttpRequest::parseHeaders(const std::string& headersPart) {
-    std::stringstream headerStream(headersPart);
-    std::string headerLine;
-    while (std::getline(headerStream, headerLine) && !headerLine.empty() && headerLine != "\r") {
-        size_t colonPos = headerLine.find(": ");
-        if (colonPos != std::string::npos) {
-            std::string key = headerLine.substr(0, colonPos);
-            std::string value = headerLine.substr(colonPos + 2);
-            // Trim potential trailing \r from value
-            if (!value.empty() && value.back() == '\r') {
-                value.pop_back();
+bool HttpRequest::parseHeaderLine(size_t lineStart, size_t length) {
+    // The name must be a non-empty token followed directly by ':'. This also
+    // rejects whitespace before the colon and obsolete line folding.
+    const char* line = m_data + lineStart;
+    size_t nameLength = findNonTokenChar(line, length);
+    if (nameLength == 0 || nameLength == length || line[nameLength] != ':' || m_headerCount == MAX_HEADERS) {
+        return false;
+    }
+    const char* colon = line + nameLength;
+
+    const char* valueStart = colon + 1;
+    const char* valueEnd = line + length;
+    while (valueStart < valueEnd && isOptionalWhitespace(*valueStart)) {
+        valueStart++;
+    }
+    while (valueEnd > valueStart && isOptionalWhitespace(valueEnd[-1])) {
+        valueEnd--;
+    }
+    if (findInvalidValueChar(valueStart, valueEnd - valueStart) != (size_t)(valueEnd - valueStart)) {
+        return false; // Bare CR, NUL or another control character
+    }
+
+    HeaderSlot& slot = m_headers[m_headerCount];
+    slot.name.offset = (uint16_t)lineStart;
+    slot.name.length = (uint16_t)(colon - line);
+    slot.value.offset = (uint16_t)(valueStart - m_data);
+    slot.value.length = (uint16_t)(valueEnd - valueStart);
+    m_headerCount++;
+
+    std::string_view name(line, colon - line);
+    bool repeated = false;
+    for (int i = 0; i < (int)HttpHeader::Count; i++) {
+        if (equalsIgnoreCase(name, KNOWN_HEADER_NAMES[i])) {
+            repeated = m_knownHeaders[i] != 0;
+            m_knownHeaders[i] = m_headerCount;
+            break;
+        }
+    }
+
+    // Only the last Transfer-Encoding line is looked at, so a repeat could
+    // hide a coding that a proxy in front of us honours; refuse it outright.
+    if (repeated && m_knownHeaders[(int)HttpHeader::TransferEncoding] == m_headerCount) {
+        return false;
+    }
+
+    if (m_knownHeaders[(int)HttpHeader::ContentLength] == m_headerCount) {
+        if (valueStart == valueEnd) {
+            return false;
+        }
+        size_t contentLength = 0;
+        for (const char* c = valueStart; c < valueEnd; c++) {
+            if (*c < '0' || *c > '9' || contentLength > (SIZE_MAX - 9) / 10) {
+                return false; // Malformed or absurdly large Content-Length
             }
-            m_headers[key] = value;
+            contentLength = contentLength * 10 + (*c - '0');
         }
+        // Repeated Content-Length headers must agree (RFC 9112, section 6.3),
+        // including a repeat after "Content-Length: 0".
+        if (repeated && m_contentLength != contentLength) {
+            return false;
+        }
+        m_contentLength = contentLength;
     }
     return true;
 }
 
+ParseResult HttpRequest::finishHeaders(size_t headersEnd) {
+    if (!parseUrl()) {
+        m_state = ParseState::Failed;
+        return ParseResult::Error;
+    }
+
+    // Only the chunked coding is supported, alone and in a single header line
+    // (see parseHeaderLine()). It overrides Content-Length, which a sender must
+    // not combine with it (RFC 9112, section 6.3).
+    if (hasHeader(HttpHeader::TransferEncoding)) {
+        if (!equalsIgnoreCase(getHeader(HttpHeader::TransferEncoding), "chunked") || hasHeader(HttpHeader::ContentLength)) {
+            m_state = ParseState::Failed;
+            return ParseResult::Error;
+        }
+        m_chunked = true;
+    }
+
+    m_bodyOffset = headersEnd;
+    m_state = ParseState::Body;
+    return ParseResult::Incomplete;
+}
+
+void HttpRequest::finishStreamedBody(const std::string& rawData, std::string_view body) {
+    m_data = rawData.data() + m_requestStart;
+    m_streamedBody = body;
+    m_bodyStreamed = true;
+    m_state = ParseState::Complete;
+}
+
+HttpRequest HttpRequest::detach(std::string& storage) const {
+    const size_t consumed = getConsumedBytes();
+    storage.reserve(consumed + (m_bodyStreamed ? m_streamedBody.length() : 0));
+    storage.assign(m_data, consumed);
+    if (m_bodyStreamed) {
+        storage.append(m_streamedBody);
+    }
+
+    HttpRequest copy = *this;
+    copy.m_requestStart = 0;
+    copy.m_data = storage.data();
+    if (m_bodyStreamed) {
+        copy.m_streamedBody = std::string_view(storage.data() + consumed, m_streamedBody.length());
+    }
+    return copy;
+}
+
+// Splits the URL into path, segments and query parameters, all as tokens into the request line.
 bool HttpRequest::parseUrl() {
-    size_t queryPos = m_rawUrl.find('?');
-    if (queryPos != std::string::npos) {
-        m_path = m_rawUrl.substr(0, queryPos);
-        std::string queryString = m_rawUrl.substr(queryPos + 1);
-        std::stringstream queryStream(queryString);
-        std::string param;
-        while (std::getline(queryStream, param, '&')) {
-            size_t equalPos = param.find('=');
-            if (equalPos != std::string::npos) {
-                m_queryParams[param.substr(0, equalPos)] = param.substr(equalPos + 1);
+    const size_t urlStart = m_rawUrl.offset;
+    const size_t urlEnd = urlStart + m_rawUrl.length;
+    const char* queryMark = (const char*)std::memchr(m_data + urlStart, '?', m_rawUrl.length);
+    const size_t pathEnd = queryMark ? queryMark - m_data : urlEnd;
+
+    m_path.offset = (uint16_t)urlStart;
+    m_path.length = (uint16_t)(pathEnd - urlStart);
+
+    if (queryMark) {
+        size_t paramStart = pathEnd + 1;
+        while (paramStart <= urlEnd) {
+            const char* ampersand = (const char*)std::memchr(m_data + paramStart, '&', urlEnd - paramStart);
+            size_t paramEnd = ampersand ? ampersand - m_data : urlEnd;
+            const char* equals = (const char*)std::memchr(m_data + paramStart, '=', paramEnd - paramStart);
+            if (equals) {
+                if (m_queryParamCount == MAX_QUERY_PARAMS) {
+                    return false;
+                }
+                QueryParam& param = m_queryParams[m_queryParamCount++];
+                size_t equalPos = equals - m_data;
+                param.name.offset = (uint16_t)paramStart;
+                param.name.length = (uint16_t)(equalPos - paramStart);
+                param.value.offset = (uint16_t)(equalPos + 1);
+                param.value.length = (uint16_t)(paramEnd - equalPos - 1);
             }
+            paramStart = paramEnd + 1;
         }
-    } else {
-        m_path = m_rawUrl;
     }
 
-    std::stringstream pathStream(m_path);
-    std::string segment;
-    while (std::getline(pathStream, segment, '/')) {
-        if (!segment.empty()) {
-            m_pathSegments.push_back(segment);
+    size_t segmentStart = urlStart;
+    while (segmentStart < pathEnd) {
+        const char* slash = (const char*)std::memchr(m_data + segmentStart, '/', pathEnd - segmentStart);
+        size_t segmentEnd = slash ? slash - m_data : pathEnd;
+        if (segmentEnd > segmentStart) {
+            if (m_pathSegmentCount == MAX_PATH_SEGMENTS) {
+                return false;
+            }
+            Token& segment = m_pathSegments[m_pathSegmentCount++];
+            segment.offset = (uint16_t)segmentStart;
+            segment.length = (uint16_t)(segmentEnd - segmentStart);
         }
+        segmentStart = segmentEnd + 1;
     }
     return true;
 }
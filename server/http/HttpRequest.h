@@ -1,9 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <vector>
-#include <map>
-#include <sstream>
+#include <string_view>
 
 enum class ParseResult {
     Success,    // The request is complete and valid.
@@ -16,55 +15,185 @@ enum class HttpMethod {
     GET, POST, HEAD, PUT, DELETE_0, TRACE, OPTIONS, UNKNOWN
 };
 
-inline HttpMethod stringToHttpMethod(const std::string& methodStr);
+inline HttpMethod stringToHttpMethod(std::string_view methodStr);
 inline std::string httpMethodToString(HttpMethod method);
 
 
+// Headers the server itself looks at. The parser records where each one is
+// while it walks the header block, so looking them up later is O(1).
+enum class HttpHeader {
+    Host,
+    Connection,
+    ContentLength,
+    ContentType,
+    TransferEncoding,
+    Expect,
+    Accept,
+    AcceptEncoding,
+    IfNoneMatch,
+    IfModifiedSince,
+    Range,
+    UserAgent,
+    Cookie,
+    Count
+};
+
+// One header line, as views into the receive buffer.
+struct HttpHeaderField {
+    std::string_view name;
+    std::string_view value;
+};
+
+
+// Request line plus headers; anything larger is rejected as malformed. Also
+// keeps every offset into the header block within 16 bits.
+const size_t MAX_HEADER_BYTES = 32 * 1024;
+
+
+// A parsed request that owns no memory: every accessor returns a view into
+// the buffer handed to parse(), so parsing a typical request allocates nothing.
+// Views stay valid until that buffer is modified.
 class HttpRequest
 {
 public:
+    static constexpr int MAX_HEADERS = 48;
+    static constexpr int MAX_PATH_SEGMENTS = 16;
+    static constexpr int MAX_QUERY_PARAMS = 16;
+
+    // Resumable: rawData is the connection's receive buffer, which only grows
+    // between calls, and parsing picks up where the previous call stopped, so
+    // each byte is examined once. The request starts at the offset given to
+    // clear(); bytes after it are left for the next request (pipelining).
     ParseResult parse(const std::string& rawData);
 
     // --- Accessor Methods ---
     HttpMethod getMethod() const;
-    const std::string& getRawUrl() const;
-    const std::string& getPath() const;
-    const std::vector<std::string>& getPathSegments() const;
-    const std::map<std::string, std::string>& getQueryParams() const;
-    const std::map<std::string, std::string>& getHeaders() const;
-    const std::string& getBody() const;
+    std::string_view getRawUrl() const;
+    std::string_view getPath() const;
+
+    // Non-empty path segments, e.g. "file" and "a.txt" for "/file/a.txt".
+    size_t getPathSegmentCount() const;
+    std::string_view getPathSegment(size_t index) const;
+
+    // Returns an empty view if the parameter is absent.
+    bool hasQueryParam(std::string_view name) const;
+    std::string_view getQueryParam(std::string_view name) const;
+
+    // Header names are matched case-insensitively. A repeated header resolves
+    // to its last occurrence; all of them are visible through getHeaderField().
+    bool hasHeader(HttpHeader header) const;
+    std::string_view getHeader(HttpHeader header) const;
+    std::string_view getHeader(std::string_view name) const;
+    size_t getHeaderCount() const;
+    HttpHeaderField getHeaderField(size_t index) const;
+
+    std::string_view getBody() const;
     void setMethod(HttpMethod method);
 
-    void clear();
+    // Body framing, valid once hasHeaders() is true. A chunked body is never
+    // reported complete by parse(); the caller decodes it and hands the
+    // result to finishStreamedBody().
+    bool isChunked() const;
+    size_t getContentLength() const;
+
+    // True for "Expect: 100-continue", the only expectation defined (RFC 9110, section 10.1.1).
+    bool expectsContinue() const;
+
+    // Start of the body, relative to the start of this request in the buffer.
+    size_t getBodyOffset() const;
+
+    // Completes a request whose body was taken out of the buffer as it arrived
+    // (streamed to an endpoint, or de-chunked). getBody() then returns body,
+    // and getConsumedBytes() covers only the request line and headers.
+    void finishStreamedBody(const std::string& rawData, std::string_view body);
+
+    // Copies a complete request, and its body, into storage and returns a
+    // request whose views point there instead of into the receive buffer, so
+    // it stays valid while the buffer changes, e.g. on another thread.
+    HttpRequest detach(std::string& storage) const;
+
+    // True once parse() has seen the full header block, even if the body is still incomplete.
+    bool hasHeaders() const;
+
+    // Bytes of the buffer taken up by this request, headers and body; valid after Success.
+    size_t getConsumedBytes() const;
+
+    // Resets the object for a new request beginning at requestStart in the buffer.
+    void clear(size_t requestStart = 0);
+
+    // The consumed front of the buffer was erased and this request now begins
+    // at requestStart. Views stay invalid until the next parse().
+    void rebase(size_t requestStart);
 
 private:
-    bool parseRequestLine(const std::string& line);
-    bool parseHeaders(const std::string& headersPart);
+    enum class ParseState {
+        RequestLine,
+        Headers,
+        Body,
+        Complete,
+        Failed
+    };
+
+    // A span of the header block. Offsets rather than pointers: the buffer may
+    // be reallocated as it grows between parse() calls.
+    struct Token {
+        uint16_t offset = 0;
+        uint16_t length = 0;
+    };
+
+    struct HeaderSlot {
+        Token name;
+        Token value;
+    };
+
+    struct QueryParam {
+        Token name;
+        Token value;
+    };
+
+    bool parseRequestLine(size_t lineStart, size_t length);
+    bool parseHeaderLine(size_t lineStart, size_t length);
     bool parseUrl();
+    ParseResult finishHeaders(size_t headersEnd);
+    std::string_view view(Token token) const;
+
+    // Positions below are relative to m_requestStart.
+    ParseState m_state = ParseState::RequestLine;
+    size_t m_requestStart = 0;
+    size_t m_lineStart = 0;     // Start of the line being parsed
+    size_t m_scanPos = 0;       // Everything from m_lineStart up to here is known to hold no '\n'
+    size_t m_bodyOffset = 0;
+    size_t m_contentLength = 0;
+    bool m_chunked = false;
+    bool m_bodyStreamed = false;
+    std::string_view m_streamedBody;
+    const char* m_data = nullptr; // Start of this request in the buffer, as of the last parse() call
 
     HttpMethod m_method = HttpMethod::UNKNOWN;
-    std::string m_rawUrl;
-    std::string m_path;
-    std::vector<std::string> m_pathSegments;
-    std::map<std::string, std::string> m_queryParams;
-    std::map<std::string, std::string> m_headers;
-    std::string m_body;
+    Token m_rawUrl;
+    Token m_path;
+
+    uint8_t m_headerCount = 0;
+    uint8_t m_pathSegmentCount = 0;
+    uint8_t m_queryParamCount = 0;
+    uint8_t m_knownHeaders[(int)HttpHeader::Count] = {}; // Slot index + 1, or 0 if absent
+    HeaderSlot m_headers[MAX_HEADERS];
+    Token m_pathSegments[MAX_PATH_SEGMENTS];
+    QueryParam m_queryParams[MAX_QUERY_PARAMS];
 };
 
 
 // --- Inline Implementations for Helper Functions ---
-inline HttpMethod stringToHttpMethod(const std::string& methodStr) {
-    static const std::map<std::string, HttpMethod> methodMap = {
-        {"GET",     HttpMethod::GET},
-        {"POST",    HttpMethod::POST},
-        {"HEAD",    HttpMethod::HEAD},
-        {"PUT",     HttpMethod::PUT},
-        {"DELETE",  HttpMethod::DELETE_0},
-        {"OPTIONS", HttpMethod::OPTIONS},
-        {"TRACE",   HttpMethod::TRACE}
-    };
-    auto it = methodMap.find(methodStr);
-    return (it != methodMap.end()) ? it->second : HttpMethod::UNKNOWN;
+inline HttpMethod stringToHttpMethod(std::string_view methodStr) {
+    // Methods are case-sensitive (RFC 9110, section 9.1).
+    if (methodStr == "GET")     return HttpMethod::GET;
+    if (methodStr == "POST")    return HttpMethod::POST;
+    if (methodStr == "HEAD")    return HttpMethod::HEAD;
+    if (methodStr == "PUT")     return HttpMethod::PUT;
+    if (methodStr == "DELETE")  return HttpMethod::DELETE_0;
+    if (methodStr == "OPTIONS") return HttpMethod::OPTIONS;
+    if (methodStr == "TRACE")   return HttpMethod::TRACE;
+    return HttpMethod::UNKNOWN;
 }
 
 inline std::string httpMethodToString(HttpMethod method) {
@@ -82,11 +211,20 @@ inline std::string httpMethodToString(HttpMethod method) {
 
 // --- Inline Implementations for Accessors ---
 inline HttpMethod HttpRequest::getMethod() const { return m_method; }
-inline const std::string& HttpRequest::getRawUrl() const { return m_rawUrl; }
-inline const std::string& HttpRequest::getPath() const { return m_path; }
-inline const std::vector<std::string>& HttpRequest::getPathSegments() const { return m_pathSegments; }
-inline const std::map<std::string, std::string>& HttpRequest::getQueryParams() const { return m_queryParams; }
-inline const std::map<std::string, std::string>& HttpRequest::getHeaders() const { return m_headers; }
-inline const std::string& HttpRequest::getBody() const { return m_body; }
+inline std::string_view HttpRequest::getRawUrl() const { return view(m_rawUrl); }
+inline std::string_view HttpRequest::getPath() const { return view(m_path); }
+inline size_t HttpRequest::getPathSegmentCount() const { return m_pathSegmentCount; }
+inline std::string_view HttpRequest::getPathSegment(size_t index) const { return index < m_pathSegmentCount ? view(m_pathSegments[index]) : std::string_view(); }
+inline bool HttpRequest::hasHeader(HttpHeader header) const { return m_knownHeaders[(int)header] != 0; }
+inline std::string_view HttpRequest::getHeader(HttpHeader header) const { return hasHeader(header) ? view(m_headers[m_knownHeaders[(int)header] - 1].value) : std::string_view(); }
+inline size_t HttpRequest::getHeaderCount() const { return m_headerCount; }
+inline HttpHeaderField HttpRequest::getHeaderField(size_t index) const { return { view(m_headers[index].name), view(m_headers[index].value) }; }
+inline std::string_view HttpRequest::getBody() const { return m_bodyStreamed ? m_streamedBody : m_data ? std::string_view(m_data + m_bodyOffset, m_contentLength) : std::string_view(); }
 inline void HttpRequest::setMethod(HttpMethod method) { m_method = method; }
-
+inline bool HttpRequest::isChunked() const { return m_chunked; }
+inline size_t HttpRequest::getContentLength() const { return m_contentLength; }
+inline size_t HttpRequest::getBodyOffset() const { return m_bodyOffset; }
+inline bool HttpRequest::hasHeaders() const { return m_state == ParseState::Body || m_state == ParseState::Complete; }
+inline size_t HttpRequest::getConsumedBytes() const { return m_bodyStreamed ? m_bodyOffset : m_bodyOffset + m_contentLength; }
+inline void HttpRequest::rebase(size_t requestStart) { m_requestStart = requestStart; m_data = nullptr; }
+inline std::string_view HttpRequest::view(Token token) const { return m_data ? std::string_view(m_data + token.offset, token.length) : std::string_view(); }
@@ -2,12 +2,27 @@
 
 #include <string>
 #include <map>
-#include <chrono>
-#include <iomanip>
-#include <sstream>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstdint>
 #include "HttpStatusCodes.h"
+#include "FileBody.h"
+#include "IBodySource.h"
 
 
+// A piece of a response body: bytes in a shared string, or a range of an open file.
+struct BodyPart {
+    std::shared_ptr<const std::string> data;
+    std::shared_ptr<const FileBody> file;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+// The body is held as shared parts: strings are moved in once and files are
+// referenced by range, and the connection's send queue shares the same parts,
+// so a body is never copied on its way out.
 class HttpResponse
 {
 public:
@@ -19,12 +34,16 @@ public:
         : m_statusCode(code) {}
 
     // 3. Constructor for responses with a status code and a body
-    HttpResponse(HttpStatusCode code, const std::string& body)
-        : m_statusCode(code), m_body(body) {}
+    HttpResponse(HttpStatusCode code, std::string body)
+        : m_statusCode(code) {
+        appendBody(std::move(body));
+    }
 
     // 4. Constructor for full control over the response
-    HttpResponse(HttpStatusCode code, const std::string& body, const std::map<std::string, std::string>& headers)
-        : m_statusCode(code), m_body(body), m_headers(headers) {}
+    HttpResponse(HttpStatusCode code, std::string body, const std::map<std::string, std::string>& headers)
+        : m_statusCode(code), m_headers(headers) {
+        appendBody(std::move(body));
+    }
 
 
     // --- Public Methods to modify the response ---
@@ -36,8 +55,65 @@ public:
         m_headers[key] = value;
     }
 
-    void setBody(const std::string& body) {
-        m_body = body;
+    // Header lines rendered ahead of time ("Name: value\r\n" each), appended
+    // as they are. They must include Content-Type and must not repeat headers
+    // set with addHeader() or the defaults.
+    void setPrerenderedHeaders(std::shared_ptr<const std::string> headers) {
+        m_prerenderedHeaders = std::move(headers);
+    }
+
+    void setBody(std::string body) {
+        clearBody();
+        appendBody(std::move(body));
+    }
+
+    // Shares a body that outlives this response, e.g. one kept in a cache.
+    void setBody(std::shared_ptr<const std::string> body) {
+        clearBody();
+        appendBody(std::move(body));
+    }
+
+    // Streams length bytes of the file from offset; nothing is read until the response is sent.
+    void setFileBody(std::shared_ptr<const FileBody> file, uint64_t offset, uint64_t length) {
+        clearBody();
+        appendFileRange(std::move(file), offset, length);
+    }
+
+    // A body of unknown length, pulled from source as the connection drains
+    // and sent with Transfer-Encoding: chunked instead of a Content-Length.
+    void setBodySource(std::shared_ptr<IBodySource> source) {
+        clearBody();
+        m_bodySource = std::move(source);
+    }
+
+    // Building blocks for bodies made of several parts, e.g. multipart/byteranges.
+    void appendBody(std::string data) {
+        if (!data.empty()) {
+            appendBody(std::make_shared<const std::string>(std::move(data)));
+        }
+    }
+
+    void appendBody(std::shared_ptr<const std::string> data) {
+        if (data && !data->empty()) {
+            uint64_t length = data->length();
+            m_bodyLength += length;
+            m_bodyParts.push_back({ std::move(data), nullptr, 0, length });
+        }
+    }
+
+    // A slice of a shared buffer, e.g. one range of a cached file.
+    void appendBody(std::shared_ptr<const std::string> data, uint64_t offset, uint64_t length) {
+        if (length > 0) {
+            m_bodyLength += length;
+            m_bodyParts.push_back({ std::move(data), nullptr, offset, length });
+        }
+    }
+
+    void appendFileRange(std::shared_ptr<const FileBody> file, uint64_t offset, uint64_t length) {
+        if (length > 0) {
+            m_bodyLength += length;
+            m_bodyParts.push_back({ nullptr, std::move(file), offset, length });
+        }
     }
 
     // --- Accessor methods ---
@@ -45,55 +121,112 @@ public:
         return m_statusCode;
     }
 
-    std::string getBody() const {
-        return m_body;
+    // A header set with addHeader(); empty if there is none.
+    std::string_view getHeader(const std::string& key) const {
+        auto header = m_headers.find(key);
+        return header != m_headers.end() ? std::string_view(header->second) : std::string_view();
+    }
+
+    // The body if it is a single in-memory string; empty for file-backed or multipart bodies.
+    const std::string& getBody() const {
+        static const std::string empty;
+        return m_bodyParts.size() == 1 && m_bodyParts[0].data ? *m_bodyParts[0].data : empty;
     }
 
-    // --- The main method to serialize the object into a string ---
-    std::string toString() const {
-        std::string response;
+    const std::vector<BodyPart>& getBodyParts() const {
+        return m_bodyParts;
+    }
 
-        // Status Line
-        response = "HTTP/1.1 " + std::to_string(static_cast<int>(m_statusCode)) + " " + getReasonPhrase(m_statusCode) + "\r\n";
+    uint64_t getBodyLength() const {
+        return m_bodyLength;
+    }
 
-        // Create a copy of headers to add/overwrite mandatory and default ones
-        std::map<std::string, std::string> responseHeaders = m_headers;
+    const std::shared_ptr<IBodySource>& getBodySource() const {
+        return m_bodySource;
+    }
 
-        // --- Add default headers if they are not already set ---
-        if (responseHeaders.find("Date") == responseHeaders.end()) {
-            auto now = std::chrono::system_clock::now();
-            auto time_t_now = std::chrono::system_clock::to_time_t(now);
-            std::tm tm_buf;
-            gmtime_s(&tm_buf, &time_t_now);
-            std::stringstream ss;
-            ss << std::put_time(&tm_buf, "%a, %d %b %Y %H:%M:%S GMT");
-            responseHeaders["Date"] = ss.str();
+    // Appends the status line and headers, up to and including the blank line.
+    // The body is sent from its own buffer. dateLine is the event loop's cached
+    // "Date: ...\r\n" line (see HttpDateCache).
+    void serializeHeaders(std::string& out, std::string_view dateLine) const {
+        std::string_view statusLine = getStatusLine(m_statusCode);
+        if (!statusLine.empty()) {
+            out.append(statusLine);
+        } else {
+            out.append("HTTP/1.1 ").append(std::to_string(static_cast<int>(m_statusCode))).append(" ")
+               .append(getReasonPhrase(m_statusCode)).append("\r\n");
         }
-        if (responseHeaders.find("Server") == responseHeaders.end()) {
-            responseHeaders["Server"] = "MySimpleWebServer";
+
+        bool hasDate = false;
+        bool hasServer = false;
+        bool hasConnection = false;
+        bool hasContentType = false;
+        for (const auto& header : m_headers) {
+            if (header.first == "Content-Length") {
+                continue;
+            }
+            hasDate = hasDate || header.first == "Date";
+            hasServer = hasServer || header.first == "Server";
+            hasConnection = hasConnection || header.first == "Connection";
+            hasContentType = hasContentType || header.first == "Content-Type";
+            out.append(header.first).append(": ").append(header.second).append("\r\n");
+        }
+
+        if (m_prerenderedHeaders) {
+            out.append(*m_prerenderedHeaders);
+            hasContentType = true;
+        }
+
+        // --- Add default headers if they are not already set ---
+        if (!hasDate) {
+            out.append(dateLine);
         }
-        if (responseHeaders.find("Connection") == responseHeaders.end()) {
-            responseHeaders["Connection"] = "keep-alive";
+        if (!hasServer && !hasConnection) {
+            out.append(DEFAULT_HEADERS);
+        } else if (!hasServer) {
+            out.append(DEFAULT_SERVER_HEADER);
+        } else if (!hasConnection) {
+            out.append(DEFAULT_CONNECTION_HEADER);
         }
-        if (!m_body.empty() && responseHeaders.find("Content-Type") == responseHeaders.end()) {
-            responseHeaders["Content-Type"] = "application/octet-stream";
+        if ((getBodyLength() > 0 || m_bodySource) && !hasContentType) {
+            out.append(DEFAULT_CONTENT_TYPE_HEADER);
         }
 
-        responseHeaders["Content-Length"] = std::to_string(m_body.length());
+        if (m_bodySource) {
+            out.append(CHUNKED_ENCODING_HEADER);
+            return;
+        }
 
-        for (const auto& header : responseHeaders) {
-            response += header.first + ": " + header.second + "\r\n";
+        // A 304 stands for the representation the client already holds, so it
+        // carries no length of its own (RFC 9110, section 8.6).
+        if (m_statusCode == HttpStatusCode::NotModified) {
+            out.append("\r\n");
+            return;
         }
 
-        response += "\r\n";
-        response += m_body;
-        
-        return response;
+        char length[24];
+        auto end = std::to_chars(length, length + sizeof(length), getBodyLength()).ptr;
+        out.append("Content-Length: ").append(length, end - length).append("\r\n\r\n");
     }
 
 private:
+    // Static header lines, appended with one copy each.
+    static constexpr std::string_view DEFAULT_SERVER_HEADER = "Server: MySimpleWebServer\r\n";
+    static constexpr std::string_view DEFAULT_CONNECTION_HEADER = "Connection: keep-alive\r\n";
+    static constexpr std::string_view DEFAULT_HEADERS = "Server: MySimpleWebServer\r\nConnection: keep-alive\r\n";
+    static constexpr std::string_view DEFAULT_CONTENT_TYPE_HEADER = "Content-Type: application/octet-stream\r\n";
+    static constexpr std::string_view CHUNKED_ENCODING_HEADER = "Transfer-Encoding: chunked\r\n\r\n";
+
+    void clearBody() {
+        m_bodyParts.clear();
+        m_bodyLength = 0;
+        m_bodySource = nullptr;
+    }
+
     HttpStatusCode m_statusCode = HttpStatusCode::Ok;
     std::map<std::string, std::string> m_headers;
-    std::string m_body;
+    std::shared_ptr<const std::string> m_prerenderedHeaders;
+    std::vector<BodyPart> m_bodyParts;
+    uint64_t m_bodyLength = 0;
+    std::shared_ptr<IBodySource> m_bodySource;
 };
-
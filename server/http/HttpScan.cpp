@@ -0,0 +1,291 @@
+#include "HttpScan.h"
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HTTP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// --- Scalar kernels ---
+
+// True for RFC 9110 tchar.
+static bool isTokenChar(unsigned char c) {
+    static const bool table[256] = {
+        // 0x00-0x1F: controls
+        0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,
+        // 0x20-0x3F: !#$%&'*+-. 0-9
+        0,1,0,1,1,1,1,1, 0,0,1,1,0,1,1,0, 1,1,1,1,1,1,1,1, 1,1,0,0,0,0,0,0,
+        // 0x40-0x5F: A-Z ^ _
+        0,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1, 1,1,1,0,0,0,1,1,
+        // 0x60-0x7F: ` a-z | ~
+        1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1, 1,1,1,0,1,0,1,0
+        // 0x80-0xFF: not tokens
+    };
+    return table[c];
+}
+
+static bool isInvalidValueChar(unsigned char c) {
+    return (c < 0x20 && c != '\t') || c == 0x7F;
+}
+
+static size_t findLineFeedScalar(const char* data, size_t length) {
+    const void* found = std::memchr(data, '\n', length);
+    return found ? (const char*)found - data : length;
+}
+
+static size_t findNonTokenCharScalar(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (!isTokenChar((unsigned char)data[i])) {
+            return i;
+        }
+    }
+    return length;
+}
+
+static size_t findInvalidValueCharScalar(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (isInvalidValueChar((unsigned char)data[i])) {
+            return i;
+        }
+    }
+    return length;
+}
+
+#ifdef HTTP_SCAN_X86
+
+// --- SSE4.2 kernels: PCMPESTRI range matching, 16 bytes per step ---
+
+__attribute__((target("sse4.2")))
+static size_t findLineFeedSse42(const char* data, size_t length) {
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, lineFeed));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + findLineFeedScalar(data + i, length - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t findNonTokenCharSse42(const char* data, size_t length) {
+    // PCMPESTRI takes at most eight ranges, so '~' is left out and re-checked
+    // with the scalar table when it is reported.
+    static const char ranges[16] = {
+        '!', '!', '#', '\'', '*', '+', '-', '.', '0', '9', 'A', 'Z', '^', 'z', '|', '|'
+    };
+    const __m128i rangeSet = _mm_loadu_si128((const __m128i*)ranges);
+    size_t i = 0;
+    while (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        int index = _mm_cmpestri(rangeSet, 16, block, 16,
+            _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+        if (index == 16) {
+            i += 16;
+        } else if (data[i + index] == '~') {
+            i += index + 1;
+        } else {
+            return i + index;
+        }
+    }
+    return i + findNonTokenCharScalar(data + i, length - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t findInvalidValueCharSse42(const char* data, size_t length) {
+    static const char ranges[16] = { 0x00, 0x08, 0x0A, 0x1F, 0x7F, 0x7F };
+    const __m128i rangeSet = _mm_loadu_si128((const __m128i*)ranges);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        int index = _mm_cmpestri(rangeSet, 6, block, 16,
+            _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (index != 16) {
+            return i + index;
+        }
+    }
+    return i + findInvalidValueCharScalar(data + i, length - i);
+}
+
+// --- AVX2 kernels: 32 bytes per step, then one 16-byte step ---
+// The 16-byte step stays in this function, where it is VEX-encoded: calling the
+// legacy-SSE kernels with dirty upper YMM halves costs a state transition.
+
+__attribute__((target("avx2")))
+static size_t findLineFeedAvx2(const char* data, size_t length) {
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lineFeed));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    if (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm256_castsi256_si128(lineFeed)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    return i + findLineFeedScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t findNonTokenCharAvx2(const char* data, size_t length) {
+    // Nibble lookup: for each low nibble, a bit per high nibble (0-7) whose
+    // combination is a token character. Bytes >= 0x80 have no bit and fail.
+    static const unsigned char lowNibbleTable[32] = {
+        0xE8, 0xFC, 0xF8, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xF8, 0xF8, 0xF4, 0x54, 0xD0, 0x54, 0xF4, 0x70,
+        0xE8, 0xFC, 0xF8, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xF8, 0xF8, 0xF4, 0x54, 0xD0, 0x54, 0xF4, 0x70
+    };
+    static const unsigned char highNibbleBits[32] = {
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    const __m256i lowTable = _mm256_loadu_si256((const __m256i*)lowNibbleTable);
+    const __m256i highTable = _mm256_loadu_si256((const __m256i*)highNibbleBits);
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i low = _mm256_and_si256(block, nibbleMask);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibbleMask);
+        __m256i matches = _mm256_and_si256(_mm256_shuffle_epi8(lowTable, low), _mm256_shuffle_epi8(highTable, high));
+        unsigned invalid = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(matches, zero));
+        if (invalid) {
+            return i + __builtin_ctz(invalid);
+        }
+    }
+    if (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i low = _mm_and_si128(block, _mm256_castsi256_si128(nibbleMask));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(block, 4), _mm256_castsi256_si128(nibbleMask));
+        __m128i matches = _mm_and_si128(_mm_shuffle_epi8(_mm256_castsi256_si128(lowTable), low),
+            _mm_shuffle_epi8(_mm256_castsi256_si128(highTable), high));
+        int invalid = _mm_movemask_epi8(_mm_cmpeq_epi8(matches, _mm_setzero_si128()));
+        if (invalid) {
+            return i + __builtin_ctz(invalid);
+        }
+        i += 16;
+    }
+    return i + findNonTokenCharScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t findInvalidValueCharAvx2(const char* data, size_t length) {
+    const __m256i lastControl = _mm256_set1_epi8(0x1F);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7F);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(block, lastControl), block);
+        __m256i invalid = _mm256_or_si256(
+            _mm256_andnot_si256(_mm256_cmpeq_epi8(block, tab), control),
+            _mm256_cmpeq_epi8(block, del));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(invalid);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    if (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(block, _mm256_castsi256_si128(lastControl)), block);
+        __m128i invalid = _mm_or_si128(
+            _mm_andnot_si128(_mm_cmpeq_epi8(block, _mm256_castsi256_si128(tab)), control),
+            _mm_cmpeq_epi8(block, _mm256_castsi256_si128(del)));
+        int mask = _mm_movemask_epi8(invalid);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    return i + findInvalidValueCharScalar(data + i, length - i);
+}
+
+#endif // HTTP_SCAN_X86
+
+// --- Dispatch ---
+
+struct ScanKernels {
+    size_t (*findLineFeed)(const char*, size_t);
+    size_t (*findNonTokenChar)(const char*, size_t);
+    size_t (*findInvalidValueChar)(const char*, size_t);
+};
+
+static const ScanKernels SCALAR_KERNELS = { findLineFeedScalar, findNonTokenCharScalar, findInvalidValueCharScalar };
+#ifdef HTTP_SCAN_X86
+static const ScanKernels SSE42_KERNELS = { findLineFeedSse42, findNonTokenCharSse42, findInvalidValueCharSse42 };
+static const ScanKernels AVX2_KERNELS = { findLineFeedAvx2, findNonTokenCharAvx2, findInvalidValueCharAvx2 };
+#endif
+
+static bool isSupported(ScanLevel level) {
+#ifdef HTTP_SCAN_X86
+    switch (level) {
+        case ScanLevel::Avx2:  return __builtin_cpu_supports("avx2");
+        case ScanLevel::Sse42: return __builtin_cpu_supports("sse4.2");
+        default:               return true;
+    }
+#else
+    return level == ScanLevel::Scalar;
+#endif
+}
+
+static const ScanKernels& kernelsFor(ScanLevel level) {
+#ifdef HTTP_SCAN_X86
+    if (level == ScanLevel::Avx2) return AVX2_KERNELS;
+    if (level == ScanLevel::Sse42) return SSE42_KERNELS;
+#endif
+    return SCALAR_KERNELS;
+}
+
+static ScanLevel detectScanLevel() {
+    if (isSupported(ScanLevel::Avx2)) return ScanLevel::Avx2;
+    if (isSupported(ScanLevel::Sse42)) return ScanLevel::Sse42;
+    return ScanLevel::Scalar;
+}
+
+// Chosen once during static initialisation, before any reactor thread starts.
+static ScanLevel s_level = detectScanLevel();
+static const ScanKernels* s_kernels = &kernelsFor(s_level);
+
+size_t findLineFeed(const char* data, size_t length) {
+    return s_kernels->findLineFeed(data, length);
+}
+
+size_t findNonTokenChar(const char* data, size_t length) {
+    return s_kernels->findNonTokenChar(data, length);
+}
+
+size_t findInvalidValueChar(const char* data, size_t length) {
+    return s_kernels->findInvalidValueChar(data, length);
+}
+
+ScanLevel getScanLevel() {
+    return s_level;
+}
+
+bool setScanLevel(ScanLevel level) {
+    if (!isSupported(level)) {
+        return false;
+    }
+    s_level = level;
+    s_kernels = &kernelsFor(level);
+    return true;
+}
+
+const char* scanLevelToString(ScanLevel level) {
+    switch (level) {
+        case ScanLevel::Avx2:  return "avx2";
+        case ScanLevel::Sse42: return "sse4.2";
+        default:               return "scalar";
+    }
+}
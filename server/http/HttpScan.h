@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+// Byte-scanning kernels used by the request parser. Each has a scalar, an
+// SSE4.2 and an AVX2 version; the fastest one the CPU supports is picked
+// once, at startup. Every function returns the offset of the first matching
+// byte, or length if there is none.
+
+// The first '\n'.
+size_t findLineFeed(const char* data, size_t length);
+
+// The first byte that is not a header-name token character (RFC 9110, section 5.6.2).
+size_t findNonTokenChar(const char* data, size_t length);
+
+// The first byte that may not appear in a header value: a control character other than HTAB, or DEL.
+size_t findInvalidValueChar(const char* data, size_t length);
+
+
+enum class ScanLevel {
+    Scalar,
+    Sse42,
+    Avx2
+};
+
+ScanLevel getScanLevel();
+
+// Switches kernels, e.g. to benchmark one against another. Returns false if the CPU lacks the instructions.
+bool setScanLevel(ScanLevel level);
+
+const char* scanLevelToString(ScanLevel level);
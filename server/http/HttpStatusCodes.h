@@ -1,16 +1,26 @@
 #pragma once
-#include <string>
+#include <string_view>
 
 // Enum class for type-safe HTTP status codes
 enum class HttpStatusCode {
+    // 1xx Informational
+    Continue = 100,
+
     // 2xx Success
     Ok = 200,
     Created = 201,
     NoContent = 204,
+    PartialContent = 206,
+
+    // 3xx Redirection
+    NotModified = 304,
 
     // 4xx Client Error
     BadRequest = 400,
     NotFound = 404,
+    ContentTooLarge = 413,
+    RangeNotSatisfiable = 416,
+    ExpectationFailed = 417,
 
     // 5xx Server Error
     InternalServerError = 500,
@@ -18,15 +28,42 @@ enum class HttpStatusCode {
 };
 
 // Helper function to get the standard reason phrase for a status code.
-inline std::string getReasonPhrase(HttpStatusCode code) {
+constexpr std::string_view getReasonPhrase(HttpStatusCode code) {
     switch (code) {
+        case HttpStatusCode::Continue:              return "Continue";
         case HttpStatusCode::Ok:                    return "OK";
         case HttpStatusCode::NoContent:             return "No Content";
         case HttpStatusCode::Created:               return "Created";
+        case HttpStatusCode::PartialContent:        return "Partial Content";
+        case HttpStatusCode::NotModified:           return "Not Modified";
         case HttpStatusCode::BadRequest:            return "Bad Request";
         case HttpStatusCode::NotFound:              return "Not Found";
+        case HttpStatusCode::ContentTooLarge:       return "Content Too Large";
+        case HttpStatusCode::RangeNotSatisfiable:   return "Range Not Satisfiable";
+        case HttpStatusCode::ExpectationFailed:     return "Expectation Failed";
         case HttpStatusCode::InternalServerError:   return "Internal Server Error";
         case HttpStatusCode::NotImplemented:        return "Not Implemented";
         default:                                    return "Unknown Status";
     }
 }
+
+// The full status line, CRLF included, pre-rendered so a response starts with
+// a single append. Empty for codes missing from the table.
+constexpr std::string_view getStatusLine(HttpStatusCode code) {
+    switch (code) {
+        case HttpStatusCode::Continue:              return "HTTP/1.1 100 Continue\r\n";
+        case HttpStatusCode::Ok:                    return "HTTP/1.1 200 OK\r\n";
+        case HttpStatusCode::NoContent:             return "HTTP/1.1 204 No Content\r\n";
+        case HttpStatusCode::Created:               return "HTTP/1.1 201 Created\r\n";
+        case HttpStatusCode::PartialContent:        return "HTTP/1.1 206 Partial Content\r\n";
+        case HttpStatusCode::NotModified:           return "HTTP/1.1 304 Not Modified\r\n";
+        case HttpStatusCode::BadRequest:            return "HTTP/1.1 400 Bad Request\r\n";
+        case HttpStatusCode::NotFound:              return "HTTP/1.1 404 Not Found\r\n";
+        case HttpStatusCode::ContentTooLarge:       return "HTTP/1.1 413 Content Too Large\r\n";
+        case HttpStatusCode::RangeNotSatisfiable:   return "HTTP/1.1 416 Range Not Satisfiable\r\n";
+        case HttpStatusCode::ExpectationFailed:     return "HTTP/1.1 417 Expectation Failed\r\n";
+        case HttpStatusCode::InternalServerError:   return "HTTP/1.1 500 Internal Server Error\r\n";
+        case HttpStatusCode::NotImplemented:        return "HTTP/1.1 501 Not Implemented\r\n";
+        default:                                    return {};
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include <string_view>
+
+// Receives a request body piece by piece as it arrives, so an endpoint can
+// accept uploads larger than it would want to hold in memory.
+class IBodySink {
+public:
+    // Consumes the next piece of the body. Returning false aborts the request
+    // with 500 Internal Server Error.
+    virtual bool write(std::string_view data) = 0;
+
+    // Called once the whole body has been written; produces the response in
+    // place of IEndpoint::handle().
+    virtual HttpResponse finish(const HttpRequest& request) = 0;
+
+    // A sink destroyed before finish() (the connection closed, or the body was
+    // rejected) discards whatever it has written.
+    virtual ~IBodySink() = default;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+enum class BodySourceResult {
+    More,  // Data was appended and more will follow
+    Done,  // The body is complete; data may have been appended
+    Error  // The body cannot be finished; the connection is closed
+};
+
+// Produces a response body on demand, for bodies too large or too slow to
+// build before sending. The connection pulls the next piece only once the
+// previous one has been written to the socket, so a client that reads slowly
+// holds at most one piece in memory. Pieces are pulled on the reactor
+// thread, also for blocking endpoints run on a worker, so read() must not
+// block.
+class IBodySource {
+public:
+    // Appends up to maxBytes of the body to out. Must append at least one
+    // byte unless it returns Done or Error.
+    virtual BodySourceResult read(std::string& out, size_t maxBytes) = 0;
+
+    virtual ~IBodySource() = default;
+};
@@ -2,7 +2,10 @@
 
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "IBodySink.h"
+#include <memory>
 #include <string>
+#include <vector>
 
 class IEndpoint {
 public:
@@ -12,6 +15,34 @@ public:
     // Provides a short, human-readable description of what the endpoint does.
     virtual std::string getDescription() const = 0;
 
+    // Endpoints that stream return true and receive the body through
+    // openBodySink() instead of in the request; the others get it buffered,
+    // up to a smaller limit.
+    virtual bool streamsBody() const { return false; }
+
+    // Endpoints that block (disk I/O) return true and, when the server runs
+    // with worker threads, are handled on one of those instead of on the
+    // event loop. handle() and the body sink's finish() may then run on
+    // several threads at once, so such an endpoint must be thread-safe.
+    virtual bool isBlocking() const { return false; }
+
+    // Endpoints whose response depends only on the path and the query
+    // parameters named by getCacheKeyParams() return true; the server then
+    // serializes the response once per distinct key and replays the bytes.
+    virtual bool isCacheable() const { return false; }
+    virtual const std::vector<std::string>& getCacheKeyParams() const {
+        static const std::vector<std::string> none;
+        return none;
+    }
+
+    // Called once the headers are in, before any of the body is read. Returns
+    // null to refuse the request, with the reason filled in to response.
+    virtual std::unique_ptr<IBodySink> openBodySink(const HttpRequest& request, HttpResponse& response) {
+        (void)request;
+        response = HttpResponse(HttpStatusCode::InternalServerError);
+        return nullptr;
+    }
+
     virtual ~IEndpoint() = default;
 };
 
@@ -0,0 +1,150 @@
+#include "ResponseCache.h"
+#include "HttpConditional.h"
+#include "HttpDate.h"
+#include <cstring>
+
+ResponseCache::ResponseCache()
+    : m_created(time(nullptr)), m_createdText(formatHttpDate(m_created)) {}
+
+// endpoint, then "path\0", then per declared parameter "\1value\0" if present or "\2" if not.
+void ResponseCache::buildKey(const IEndpoint* endpoint, const HttpRequest& request) {
+    m_key.assign(reinterpret_cast<const char*>(&endpoint), sizeof(endpoint));
+    m_key.append(request.getPath()).push_back('\0');
+    for (const std::string& name : endpoint->getCacheKeyParams()) {
+        if (request.hasQueryParam(name)) {
+            m_key.append(1, '\1').append(request.getQueryParam(name)).push_back('\0');
+        } else {
+            m_key.push_back('\2');
+        }
+    }
+}
+
+static void patchDate(SerializedResponse& response, std::string_view dateLine) {
+    char* date = &(*response.bytes)[response.dateOffset];
+    if (std::memcmp(date, dateLine.data(), dateLine.length()) == 0) {
+        return;
+    }
+    // Queued sends may still point into the old bytes (io_uring reads them
+    // asynchronously), so those are left alone.
+    if (response.bytes.use_count() > 1) {
+        response.bytes = std::make_shared<std::string>(*response.bytes);
+        date = &(*response.bytes)[response.dateOffset];
+    }
+    std::memcpy(date, dateLine.data(), dateLine.length());
+}
+
+// Serializes the headers and finds the Date line in them. False if the
+// response sets its own Date, which then could not be patched.
+static bool serializeWithDate(const HttpResponse& response, std::string_view dateLine, SerializedResponse& out) {
+    out.bytes = std::make_shared<std::string>();
+    response.serializeHeaders(*out.bytes, dateLine);
+    out.dateOffset = out.bytes->find(dateLine);
+    return out.dateOffset != std::string::npos;
+}
+
+static std::string_view getSingleBody(const HttpResponse& response) {
+    const std::vector<BodyPart>& parts = response.getBodyParts();
+    if (parts.empty()) {
+        return {};
+    }
+    return std::string_view(*parts[0].data).substr((size_t)parts[0].offset, (size_t)parts[0].length);
+}
+
+const CachedResponse* ResponseCache::find(const IEndpoint* endpoint, const HttpRequest& request, std::string_view dateLine) {
+    buildKey(endpoint, request);
+    auto position = m_entries.find(m_key);
+    if (position == m_entries.end()) {
+        return nullptr;
+    }
+    return selectVariant(position->second, request, dateLine);
+}
+
+const CachedResponse* ResponseCache::insert(const IEndpoint* endpoint, const HttpRequest& request, const HttpResponse& response,
+                                            std::string_view dateLine) {
+    const std::vector<BodyPart>& parts = response.getBodyParts();
+    if (response.getBodySource() || parts.size() > 1 || (!parts.empty() && !parts[0].data)) {
+        return nullptr;
+    }
+
+    Entry entry;
+    entry.response = response;
+    HttpMethod method = request.getMethod();
+    entry.hasValidators = response.getStatusCode() == HttpStatusCode::Ok && (method == HttpMethod::GET || method == HttpMethod::HEAD);
+    entry.encodable = isEncodable(response);
+    if (!buildVariant(entry, ContentCoding::Identity, dateLine)) {
+        return nullptr;
+    }
+
+    // Bounded by a count rather than an LRU: the working set is a few
+    // variants, and anything larger is a client cycling query values.
+    if (m_entries.size() >= MAX_CACHED_RESPONSES) {
+        m_entries.clear();
+    }
+    buildKey(endpoint, request);
+    Entry& stored = m_entries[m_key] = std::move(entry);
+    return selectVariant(stored, request, dateLine);
+}
+
+// The variant for the request's Accept-Encoding, compressed now if this is
+// the first request for it; the identity variant if compression did not pay.
+const CachedResponse* ResponseCache::selectVariant(Entry& entry, const HttpRequest& request, std::string_view dateLine) {
+    CachedResponse* variant = &entry.variants[(int)ContentCoding::Identity];
+    if (entry.encodable) {
+        ContentCoding coding = negotiateContentCoding(request.getHeader(HttpHeader::AcceptEncoding));
+        const uint8_t bit = (uint8_t)(1u << (int)coding);
+        if (coding != ContentCoding::Identity && !(entry.triedCodings & bit)) {
+            entry.triedCodings |= bit;
+            buildVariant(entry, coding, dateLine);
+        }
+        if (entry.variants[(int)coding].full.bytes) {
+            variant = &entry.variants[(int)coding];
+        }
+    }
+
+    patchDate(variant->full, dateLine);
+    if (variant->notModified.bytes) {
+        patchDate(variant->notModified, dateLine);
+    }
+    return variant;
+}
+
+bool ResponseCache::buildVariant(Entry& entry, ContentCoding coding, std::string_view dateLine) {
+    HttpResponse response = entry.response; // Shares the body
+    if (coding != ContentCoding::Identity && !encodeResponse(response, coding, CompressionEffort::Variant)) {
+        return false;
+    }
+    std::string_view body = getSingleBody(response);
+
+    CachedResponse variant;
+    variant.statusCode = response.getStatusCode();
+    variant.bodyLength = response.getBodyLength();
+
+    if (entry.encodable) {
+        response.addHeader("Vary", "Accept-Encoding");
+    }
+    if (entry.hasValidators) {
+        variant.etag = formatContentETag(body);
+        variant.lastModified = m_created;
+        response.addHeader("ETag", variant.etag);
+        response.addHeader("Last-Modified", m_createdText);
+
+        HttpResponse notModified(HttpStatusCode::NotModified);
+        notModified.addHeader("ETag", variant.etag);
+        notModified.addHeader("Last-Modified", m_createdText);
+        if (entry.encodable) {
+            notModified.addHeader("Vary", "Accept-Encoding");
+        }
+        if (!serializeWithDate(notModified, dateLine, variant.notModified)) {
+            return false;
+        }
+    }
+
+    if (!serializeWithDate(response, dateLine, variant.full)) {
+        return false;
+    }
+    variant.headerLength = variant.full.bytes->length();
+    variant.full.bytes->append(body);
+
+    entry.variants[(int)coding] = std::move(variant);
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Compression.h"
+#include "IEndpoint.h"
+
+// Distinct responses kept per reactor before the cache starts over.
+const size_t MAX_CACHED_RESPONSES = 256;
+
+// Status line, headers and body back to back, sent as a single buffer.
+struct SerializedResponse {
+    std::shared_ptr<std::string> bytes;
+    size_t dateOffset = 0; // Where the Date line starts
+};
+
+// One variant (content coding) of a response of a cacheable endpoint,
+// serialized once. A successful GET also carries validators, with the 304
+// answering them serialized alongside.
+struct CachedResponse {
+    SerializedResponse full;
+    size_t headerLength = 0; // Up to and including the blank line; all HEAD sends
+    HttpStatusCode statusCode = HttpStatusCode::Ok;
+    uint64_t bodyLength = 0;
+
+    std::string etag; // Empty if the response has no validators
+    time_t lastModified = 0;
+    SerializedResponse notModified;
+};
+
+// Serialized responses of the endpoints that declare themselves cacheable
+// (IEndpoint::isCacheable), keyed by endpoint, path and the query parameters
+// the endpoint names. Each reactor owns one, so nothing is locked, and a
+// lookup builds its key in a reused buffer. The Date line is patched in place
+// when the second changes; a copy is made instead while a connection still
+// has the previous bytes queued.
+//
+// Compressible responses are kept with a variant per content coding, each
+// compressed once, the first time a client asks for it, and sent with
+// Vary: Accept-Encoding. Each variant's ETag is a hash of its own body.
+// Such an endpoint can only change its output with a new build, so the
+// Last-Modified date is when the cache was created.
+class ResponseCache
+{
+public:
+    ResponseCache();
+
+    // Null on a miss. A hit is the variant for the request's Accept-Encoding,
+    // carrying the current Date line.
+    const CachedResponse* find(const IEndpoint* endpoint, const HttpRequest& request, std::string_view dateLine);
+
+    // Serializes and stores the endpoint's response to request. Returns null,
+    // storing nothing, if the response is not a plain in-memory one.
+    const CachedResponse* insert(const IEndpoint* endpoint, const HttpRequest& request, const HttpResponse& response,
+                                 std::string_view dateLine);
+
+private:
+    // Every variant of one response. The response itself is kept, sharing its
+    // body, to build the missing variants from.
+    struct Entry {
+        HttpResponse response;
+        bool hasValidators = false;
+        bool encodable = false;
+        uint8_t triedCodings = 0; // Bit per ContentCoding, so a body that does not shrink is tried once
+        CachedResponse variants[(int)ContentCoding::Count];
+    };
+
+    void buildKey(const IEndpoint* endpoint, const HttpRequest& request);
+    const CachedResponse* selectVariant(Entry& entry, const HttpRequest& request, std::string_view dateLine);
+    bool buildVariant(Entry& entry, ContentCoding coding, std::string_view dateLine);
+
+    std::unordered_map<std::string, Entry> m_entries;
+    std::string m_key;
+    time_t m_created;
+    std::string m_createdText; // As an HTTP date
+};
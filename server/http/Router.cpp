@@ -0,0 +1,157 @@
+#include "Router.h"
+#include <cstring>
+
+// Route segments are short, so a plain loop beats a call to memcmp().
+static bool equalBytes(const char* a, const char* b, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Router::add(std::string_view pattern, HttpMethod method, IEndpoint* endpoint) {
+    if (pattern.empty() || pattern[0] != '/' || (int)method >= METHOD_COUNT || !endpoint) {
+        return false;
+    }
+    if (m_nodes.empty()) {
+        m_nodes.emplace_back();
+        m_pending.emplace_back();
+    }
+
+    uint32_t node = 0;
+    size_t position = 1;
+    while (true) {
+        size_t end = pattern.find('/', position);
+        if (end == std::string_view::npos) {
+            end = pattern.length();
+        }
+        std::string_view segment = pattern.substr(position, end - position);
+
+        bool isParam = false;
+        std::string_view text = segment;
+        if (!segment.empty() && segment[0] == '{') {
+            size_t close = segment.find('}');
+            if (close == std::string_view::npos || close == 1) {
+                return false;
+            }
+            isParam = true;
+            text = segment.substr(close + 1);
+        }
+        if (text.find_first_of("{}") != std::string_view::npos) {
+            return false;
+        }
+
+        uint32_t next = NO_NODE;
+        for (const PendingEdge& edge : m_pending[node]) {
+            if (edge.isParam == isParam && edge.text == text) {
+                next = edge.target;
+                break;
+            }
+        }
+        if (next == NO_NODE) {
+            next = (uint32_t)m_nodes.size();
+            m_nodes.emplace_back();
+            m_pending.emplace_back();
+            m_pending[node].push_back({ isParam, std::string(text), next });
+        }
+        node = next;
+
+        if (end == pattern.length()) {
+            break;
+        }
+        position = end + 1;
+    }
+
+    Node& target = m_nodes[node];
+    if (!(target.methods & (1u << (int)method))) {
+        target.routes[(int)method] = (uint16_t)m_routes.size();
+        m_routes.push_back({ std::string(pattern), method });
+    }
+    target.methods |= 1u << (int)method;
+    target.endpoints[(int)method] = endpoint;
+    return true;
+}
+
+void Router::compile() {
+    m_edges.clear();
+    m_text.clear();
+
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        Node& node = m_nodes[i];
+        node.firstEdge = (uint32_t)m_edges.size();
+        node.literalCount = 0;
+        node.paramCount = 0;
+
+        // Literals first, so find() can stop at the first literal that matches.
+        for (bool params : { false, true }) {
+            for (const PendingEdge& pending : m_pending[i]) {
+                if (pending.isParam != params) {
+                    continue;
+                }
+                m_edges.push_back({ (uint32_t)m_text.length(), (uint32_t)pending.text.length(), pending.target });
+                m_text += pending.text;
+                (params ? node.paramCount : node.literalCount)++;
+            }
+        }
+    }
+
+    std::vector<std::vector<PendingEdge>>().swap(m_pending);
+}
+
+IEndpoint* Router::find(HttpMethod method, std::string_view path, int* route) const {
+    if ((int)method >= METHOD_COUNT) {
+        return nullptr;
+    }
+    uint32_t node = findNode(path);
+    if (node == NO_NODE || !(m_nodes[node].methods & (1u << (int)method))) {
+        return nullptr;
+    }
+    if (route) {
+        *route = m_nodes[node].routes[(int)method];
+    }
+    return m_nodes[node].endpoints[(int)method];
+}
+
+// Walks the trie one segment at a time; the node the whole path leads to, or NO_NODE.
+uint32_t Router::findNode(std::string_view path) const {
+    if (m_nodes.empty() || path.empty() || path[0] != '/') {
+        return NO_NODE;
+    }
+
+    const char* data = path.data();
+    const size_t length = path.length();
+    const char* text = m_text.data();
+    uint32_t node = 0;
+    size_t position = 1;
+    while (true) {
+        const char* slash = (const char*)std::memchr(data + position, '/', length - position);
+        const size_t end = slash ? slash - data : length;
+        const char* segment = data + position;
+        const size_t segmentLength = end - position;
+
+        const Node& current = m_nodes[node];
+        const Edge* edge = m_edges.data() + current.firstEdge;
+        const Edge* literalsEnd = edge + current.literalCount;
+        const Edge* paramsEnd = literalsEnd + current.paramCount;
+        node = NO_NODE;
+        for (; edge != literalsEnd; edge++) {
+            if (edge->textLength == segmentLength && equalBytes(text + edge->textOffset, segment, segmentLength)) {
+                node = edge->target;
+                break;
+            }
+        }
+        for (edge = literalsEnd; node == NO_NODE && edge != paramsEnd; edge++) {
+            if (segmentLength > edge->textLength &&
+                equalBytes(text + edge->textOffset, segment + segmentLength - edge->textLength, edge->textLength)) {
+                node = edge->target;
+            }
+        }
+
+        if (node == NO_NODE || end == length) {
+            return node;
+        }
+        position = end + 1;
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "HttpRequest.h"
+#include "IEndpoint.h"
+
+// Maps a method and a path to an endpoint. Routes are added at startup and
+// compiled into a trie over path segments stored in flat arrays, so a lookup
+// walks the path once, compares each segment against a node's few outgoing
+// edges, and allocates and copies nothing.
+//
+// A pattern is a sequence of "/"-separated segments. A segment is either a
+// literal ("home") or a parameter ("{name}"), optionally constrained by a
+// literal suffix: "{name}.txt" matches any non-empty name followed by ".txt".
+// Empty segments are significant, so "/home/" does not match "/home".
+// Literal edges are tried before parameters, without backtracking.
+class Router
+{
+public:
+    // Only valid before compile(). Returns false for a malformed pattern.
+    bool add(std::string_view pattern, HttpMethod method, IEndpoint* endpoint);
+
+    // Lays the routes out for lookup; call once, after the last add().
+    void compile();
+
+    // Null if no route matches the path or none of them takes the method.
+    // On a match, route (if given) is set to the route's id.
+    IEndpoint* find(HttpMethod method, std::string_view path, int* route = nullptr) const;
+
+    // Routes are numbered from 0 in the order they were first added, e.g. for
+    // per-route counters.
+    int getRouteCount() const { return (int)m_routes.size(); }
+    std::string_view getRoutePattern(int route) const { return m_routes[route].pattern; }
+    HttpMethod getRouteMethod(int route) const { return m_routes[route].method; }
+
+private:
+    static constexpr int METHOD_COUNT = (int)HttpMethod::UNKNOWN;
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+    // A node reached through a path: which methods it answers and with what.
+    struct Node
+    {
+        uint32_t firstEdge = 0; // Into m_edges: literal edges first, then parameters
+        uint16_t literalCount = 0;
+        uint16_t paramCount = 0;
+        uint32_t methods = 0;   // Bit per HttpMethod
+        IEndpoint* endpoints[METHOD_COUNT] = {};
+        uint16_t routes[METHOD_COUNT] = {};
+    };
+
+    struct Route
+    {
+        std::string pattern;
+        HttpMethod method;
+    };
+
+    // A segment leading to another node. text is the literal, or the
+    // suffix a parameter must end with, as a range of m_text.
+    struct Edge
+    {
+        uint32_t textOffset;
+        uint32_t textLength;
+        uint32_t target;
+    };
+
+    // Routes as added, before compile() flattens the edges.
+    struct PendingEdge
+    {
+        bool isParam;
+        std::string text;
+        uint32_t target;
+    };
+
+    uint32_t findNode(std::string_view path) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<Edge> m_edges;
+    std::string m_text; // Every edge's text, back to back
+    std::vector<std::vector<PendingEdge>> m_pending;
+    std::vector<Route> m_routes;
+};
@@ -1,192 +1,189 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <iostream>
+#include <memory>
 #include <string>
-#include <map>
-#include <chrono>
-#include <iomanip>
-#include <ctime>
+#include <thread>
+#include <vector>
 
-#include "SocketManager.h"
-#include "SocketData.h"
-#include "http/HttpStatusCodes.h"
-#include "http/HttpRequest.h"
-#include "http/HttpResponse.h"
-#include "http/IEndpoint.h"
-#include "http/Endpoints.h"
+#include "ServerConfig.h"
+#include "Reactor.h"
+#include "WorkerPool.h"
 
 
-IEndpoint* findEndpoint(const std::map<std::string, std::map<HttpMethod, IEndpoint*>>& routes, const HttpRequest& request)
+static void printUsage()
 {
-    const std::string& path = request.getPath();
-    const HttpMethod method = request.getMethod();
-    const std::string fileRoutePrefix = "/file/";
-
-    if (path.rfind(fileRoutePrefix, 0) == 0) {
-        if (path.find('/', fileRoutePrefix.length()) != std::string::npos ||
-            (path.length() < 5 || path.substr(path.length() - 4) != ".txt")) {
-            return nullptr; // Invalid file path format.
-        }
+    std::cout << "Usage: server [--backend=select|epoll|io_uring] [--port=N] [--reactors=N] [--workers=N] [--pin] [--max-connections=N] [--file-cache-mb=N] [--max-upload-mb=N]" << std::endl
+              << "              [--access-log=PATH] [--access-log-sample=N] [--access-log-max-mb=N] [--slow-request-ms=N] [--slow-log=PATH]" << std::endl
+              << "  --reactors=0 starts one reactor per CPU." << std::endl
+              << "  --workers=N runs file endpoints on N threads shared by the reactors (default 0: on the reactors)." << std::endl
+              << "  --max-connections limits the connections per reactor (default " << DEFAULT_MAX_CONNECTIONS << ")." << std::endl
+              << "  --file-cache-mb sets the memory budget of the file cache (default " << DEFAULT_FILE_CACHE_BYTES / (1024 * 1024) << ", 0 disables it)." << std::endl
+              << "  --max-upload-mb sets the largest request body accepted by PUT (default " << DEFAULT_MAX_UPLOAD_BYTES / (1024 * 1024) << ")." << std::endl
+              << "  --access-log sets the access log file (default access.log, empty disables it); --access-log-sample=N" << std::endl
+              << "  keeps one record in N, and the file is rotated every --access-log-max-mb (default " << DEFAULT_ACCESS_LOG_MAX_BYTES / (1024 * 1024) << ")." << std::endl
+              << "  --slow-request-ms=N traces every request and writes those taking N ms or more to the slow log" << std::endl
+              << "  (default slow.log), phase by phase; 0, the default, turns tracing off." << std::endl;
+}
 
-        if (routes.count(fileRoutePrefix)) {
-            const std::map<HttpMethod, IEndpoint*>& methodMap = routes.at(fileRoutePrefix);
-            if (methodMap.count(method)) {
-                return methodMap.at(method);
+static bool parseArguments(int argc, char* argv[], ServerConfig& config)
+{
+    const std::string backendOption = "--backend=";
+    const std::string portOption = "--port=";
+    const std::string reactorsOption = "--reactors=";
+    const std::string workersOption = "--workers=";
+    const std::string maxConnectionsOption = "--max-connections=";
+    const std::string fileCacheOption = "--file-cache-mb=";
+    const std::string maxUploadOption = "--max-upload-mb=";
+    const std::string accessLogOption = "--access-log=";
+    const std::string accessLogSampleOption = "--access-log-sample=";
+    const std::string accessLogMaxOption = "--access-log-max-mb=";
+    const std::string slowRequestOption = "--slow-request-ms=";
+    const std::string slowLogOption = "--slow-log=";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        try {
+            if (arg.rfind(backendOption, 0) == 0) {
+                if (!eventBackendFromString(arg.substr(backendOption.length()), config.backendType)) {
+                    return false;
+                }
+            } else if (arg.rfind(portOption, 0) == 0) {
+                config.port = std::stoi(arg.substr(portOption.length()));
+            } else if (arg.rfind(reactorsOption, 0) == 0) {
+                config.reactorCount = std::stoi(arg.substr(reactorsOption.length()));
+                if (config.reactorCount == 0) {
+                    config.reactorCount = (int)std::thread::hardware_concurrency();
+                }
+                if (config.reactorCount < 1) {
+                    config.reactorCount = 1;
+                }
+            } else if (arg.rfind(workersOption, 0) == 0) {
+                config.workerThreads = std::stoi(arg.substr(workersOption.length()));
+                if (config.workerThreads < 0) {
+                    return false;
+                }
+            } else if (arg.rfind(maxConnectionsOption, 0) == 0) {
+                config.maxConnections = std::stoi(arg.substr(maxConnectionsOption.length()));
+                if (config.maxConnections < 1) {
+                    return false;
+                }
+            } else if (arg.rfind(fileCacheOption, 0) == 0) {
+                int megabytes = std::stoi(arg.substr(fileCacheOption.length()));
+                if (megabytes < 0) {
+                    return false;
+                }
+                config.fileCacheBytes = (size_t)megabytes * 1024 * 1024;
+            } else if (arg.rfind(maxUploadOption, 0) == 0) {
+                long long megabytes = std::stoll(arg.substr(maxUploadOption.length()));
+                if (megabytes < 0) {
+                    return false;
+                }
+                config.maxUploadBytes = (uint64_t)megabytes * 1024 * 1024;
+            } else if (arg.rfind(accessLogOption, 0) == 0) {
+                config.accessLogPath = arg.substr(accessLogOption.length());
+            } else if (arg.rfind(accessLogSampleOption, 0) == 0) {
+                config.accessLogSampleEvery = std::stoi(arg.substr(accessLogSampleOption.length()));
+                if (config.accessLogSampleEvery < 1) {
+                    return false;
+                }
+            } else if (arg.rfind(accessLogMaxOption, 0) == 0) {
+                int megabytes = std::stoi(arg.substr(accessLogMaxOption.length()));
+                if (megabytes < 1) {
+                    return false;
+                }
+                config.accessLogMaxBytes = (uint64_t)megabytes * 1024 * 1024;
+            } else if (arg.rfind(slowRequestOption, 0) == 0) {
+                config.slowRequestMs = std::stoi(arg.substr(slowRequestOption.length()));
+                if (config.slowRequestMs < 0) {
+                    return false;
+                }
+            } else if (arg.rfind(slowLogOption, 0) == 0) {
+                config.slowLogPath = arg.substr(slowLogOption.length());
+            } else if (arg == "--pin") {
+                config.pinReactors = true;
+            } else {
+                return false;
             }
+        } catch (const std::exception&) {
+            return false;
         }
     }
+    return true;
+}
 
-    if (routes.count(path)) {
-        const std::map<HttpMethod, IEndpoint*>& methodMap = routes.at(path);
-        if (methodMap.count(method)) {
-            return methodMap.at(method);
+// Builds and runs one reactor on the calling thread. The Reactor is created
+// here rather than handed in so its memory is first touched by its own thread.
+static bool runReactor(const ServerConfig& config, int reactorIndex, FileCache& fileCache, AccessLog& accessLog, AccessLog& slowLog,
+                       Metrics& metrics, WorkerPool* workers)
+{
+    if (config.pinReactors) {
+        int cpuCount = (int)std::thread::hardware_concurrency();
+        int cpu = reactorIndex % (cpuCount > 0 ? cpuCount : 1);
+        if (!pinCurrentThreadToCpu(cpu)) {
+            std::cout << "Server: Could not pin reactor " << reactorIndex << " to CPU " << cpu << std::endl;
         }
     }
 
-    return nullptr;
+    Reactor reactor(config, reactorIndex, fileCache, accessLog, slowLog, metrics, workers);
+    if (!reactor.init()) {
+        return false;
+    }
+    reactor.run();
+    return true;
 }
 
 
-int main()
+int main(int argc, char* argv[])
 {
-    SocketManager manager;
-    if (!manager.init()) {
+    ServerConfig config;
+    if (!parseArguments(argc, argv, config)) {
+        printUsage();
         return 1;
     }
 
-    // --- Controller Setup ---
-    HomeEndpoint homeEndpoint;
-    PostMessageEndpoint postMessageEndpoint;
-    PutFileEndpoint putFileEndpoint;
-    GetFileEndpoint getFileEndpoint;
-    DeleteFileEndpoint deleteFileEndpoint;
-    TraceEndpoint traceEndpoint;
-
-    OptionsEndpoint homeOptions({{HttpMethod::GET, homeEndpoint.getDescription()}});
-    OptionsEndpoint postMessageOptions({{HttpMethod::POST, postMessageEndpoint.getDescription()}});
-    OptionsEndpoint traceOptions({{HttpMethod::TRACE, traceEndpoint.getDescription()}});
-    OptionsEndpoint fileOptions({
-        {HttpMethod::GET, getFileEndpoint.getDescription()},
-        {HttpMethod::PUT, putFileEndpoint.getDescription()},
-        {HttpMethod::DELETE_0, deleteFileEndpoint.getDescription()}
-    });
-
-    std::map<std::string, std::map<HttpMethod, IEndpoint*>> routes;
-
-    routes["/home"][HttpMethod::GET] = &homeEndpoint;
-    routes["/home"][HttpMethod::OPTIONS] = &homeOptions;
-    routes["/postmessage"][HttpMethod::POST] = &postMessageEndpoint;
-    routes["/postmessage"][HttpMethod::OPTIONS] = &postMessageOptions;
-    routes["/trace"][HttpMethod::TRACE] = &traceEndpoint;
-    routes["/trace"][HttpMethod::OPTIONS] = &traceOptions;
-
-    routes["/file/"][HttpMethod::GET] = &getFileEndpoint;
-    routes["/file/"][HttpMethod::PUT] = &putFileEndpoint;
-    routes["/file/"][HttpMethod::DELETE_0] = &deleteFileEndpoint;
-    routes["/file/"][HttpMethod::OPTIONS] = &fileOptions;
-
-
-    while (true)
-    {
-        fd_set waitRecv, waitSend;
-        manager.buildFdSets(waitRecv, waitSend);
-
-        timeval timeout;
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
-
-        int nfd = select(0, &waitRecv, &waitSend, NULL, &timeout);
-        if (nfd == SOCKET_ERROR) {
-            std::cout << "Server: Error at select(): " << WSAGetLastError() << std::endl;
-            break;
-        }
-
-        // Handle incoming data and parse requests
-        for (int i = 0; i < SocketManager::MAX_SOCKETS; i++) {
-            SocketState& socket = manager.getSocketState(i);
-            if (socket.status == SocketStatus::LISTENING && FD_ISSET(socket.id, &waitRecv)) {
-                manager.acceptNewConnection(i);
-            }
-            else if (socket.status == SocketStatus::RECEIVING && FD_ISSET(socket.id, &waitRecv)) {
-                if (manager.receiveData(i) != SOCKET_ERROR) {
-                    ParseResult result = socket.request.parse(socket.messageData);
-                    if (result == ParseResult::Success) {
-                        socket.messageData.clear();
-                        socket.status = SocketStatus::PROCESSING;
-                    } else if (result == ParseResult::Error) {
-                        HttpResponse response(HttpStatusCode::BadRequest);
-                        socket.messageData = response.toString();
-                        socket.bytesToSend = socket.messageData.length();
-                        socket.status = SocketStatus::SENDING;
-                    }
-                }
-            }
-        }
-
-        // Process complete requests
-        for (int i = 0; i < SocketManager::MAX_SOCKETS; i++) {
-            SocketState& socket = manager.getSocketState(i);
-            if (socket.status == SocketStatus::PROCESSING) {
-                const HttpRequest& originalRequest = socket.request;
-
-                bool isHeadRequest = (originalRequest.getMethod() == HttpMethod::HEAD);
+#ifndef SO_REUSEPORT
+    if (config.reactorCount > 1) {
+        std::cout << "Server: SO_REUSEPORT is not available on this platform, running a single reactor." << std::endl;
+        config.reactorCount = 1;
+    }
+#endif
 
-                HttpRequest routingRequest = originalRequest;
-                if (isHeadRequest) {
-                    routingRequest.setMethod(HttpMethod::GET);
-                }
+    FileCache fileCache(config.fileCacheBytes);
 
-                IEndpoint* handler = findEndpoint(routes, routingRequest);
-                HttpResponse response;
+    AccessLog accessLog(config.accessLogPath, config.reactorCount, config.accessLogSampleEvery, config.accessLogMaxBytes);
+    if (!accessLog.start()) {
+        return 1;
+    }
 
-                if (handler) {
-                    response = handler->handle(originalRequest);
-                } else {
-                    response = HttpResponse(HttpStatusCode::NotFound);
-                }
+    // Only traced requests are written here, so every one is kept.
+    AccessLog slowLog(config.slowRequestMs > 0 ? config.slowLogPath : "", config.reactorCount, 1, config.accessLogMaxBytes);
+    if (!slowLog.start()) {
+        return 1;
+    }
+    if (config.slowRequestMs > 0) {
+        calibrateTraceClock();
+    }
 
-                // Single-line logging
-                auto now = std::chrono::system_clock::now();
-                auto time_t_now = std::chrono::system_clock::to_time_t(now);
-                std::tm tm_buf;
-                localtime_s(&tm_buf, &time_t_now);
-
-                std::cout << "[" << std::put_time(&tm_buf, "%Y-%m-%d %H:%M:%S") << "] "
-                          << httpMethodToString(originalRequest.getMethod()) << " " << originalRequest.getRawUrl()
-                          << " -> " << static_cast<int>(response.getStatusCode()) << " "
-                          << getReasonPhrase(response.getStatusCode()) << std::endl;
-
-                // HEAD response generation
-                std::string fullResponseStr = response.toString();
-                if (isHeadRequest) {
-                    size_t headersEnd = fullResponseStr.find("\r\n\r\n");
-                    if (headersEnd != std::string::npos) {
-                        socket.messageData = fullResponseStr.substr(0, headersEnd + 4);
-                    } else {
-                        socket.messageData = fullResponseStr;
-                    }
-                } else {
-                    socket.messageData = fullResponseStr;
-                }
+    Metrics metrics(config.reactorCount, fileCache, accessLog);
 
-                // Prepare socket for sending
-                socket.bytesToSend = socket.messageData.length();
-                socket.bytesSent = 0;
-                socket.status = SocketStatus::SENDING;
-            }
-        }
+    std::unique_ptr<WorkerPool> workers;
+    if (config.workerThreads > 0) {
+        workers = std::make_unique<WorkerPool>(config.workerThreads);
+    }
 
-        // Send responses
-        for (int i = 0; i < SocketManager::MAX_SOCKETS; i++) {
-            SocketState& socket = manager.getSocketState(i);
-            if (socket.status == SocketStatus::SENDING && FD_ISSET(socket.id, &waitSend)) {
-                manager.sendData(i);
-            }
-        }
+    if (config.reactorCount == 1) {
+        return runReactor(config, 0, fileCache, accessLog, slowLog, metrics, workers.get()) ? 0 : 1;
+    }
 
-        manager.checkTimeouts();
+    std::vector<std::thread> reactors;
+    for (int i = 0; i < config.reactorCount; i++) {
+        reactors.emplace_back(runReactor, std::cref(config), i, std::ref(fileCache), std::ref(accessLog), std::ref(slowLog),
+                              std::ref(metrics), workers.get());
+    }
+    for (std::thread& reactor : reactors) {
+        reactor.join();
     }
 
     return 0;
 }
-